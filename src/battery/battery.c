@@ -0,0 +1,228 @@
+#include "battery.h"
+#include "store.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+uint64_t batteryQueries = 0;
+uint64_t batteryWakeups = 0;
+
+bool sampleBatteryQueryRate(BatteryQueryRate* rate, uint64_t now)
+{
+	uint64_t elapsed = now - rate->lastTime;
+	if (elapsed < 1000000000ull)
+		return false;
+
+	rate->perSec = (batteryQueries - rate->lastQueries) * 1000000000.f / elapsed;
+	rate->lastQueries = batteryQueries;
+	rate->lastTime = now;
+	return true;
+}
+
+bool sampleBatteryWakeupRate(BatteryWakeupRate* rate, uint64_t now)
+{
+	uint64_t elapsed = now - rate->lastTime;
+	if (elapsed < 60000000000ull)
+		return false;
+
+	rate->perHour = (batteryWakeups - rate->lastWakeups) * 3600000000000.f / elapsed;
+	rate->lastWakeups = batteryWakeups;
+	rate->lastTime = now;
+	return true;
+}
+
+const BatteryProvider* defaultBatteryProvider()
+{
+#ifdef _WIN32
+	return &win32BatteryProvider;
+#else
+	return &sysfsBatteryProvider;
+#endif
+}
+
+static bool reserve(void** data, uint64_t* max, uint64_t length, uint64_t size)
+{
+	if (length < *max)
+		return true;
+
+	uint64_t newMax = *max ? *max * 2 : 4;
+	void* ptr = realloc(*data, newMax * size);
+	if (!ptr)
+		return false;
+
+	*data = ptr;
+	*max = newMax;
+	return true;
+}
+
+bool pushBatteryPath(BatteryPath_array* paths, const char* path)
+{
+	if (!reserve((void**)&paths->data, &paths->_max, paths->length, sizeof(*paths->data)))
+		return false;
+
+	uint64_t len = strlen(path);
+	char* copy = malloc(len + 1);
+	if (!copy)
+		return false;
+	memcpy(copy, path, len + 1);
+
+	paths->data[paths->length++] = copy;
+	return true;
+}
+
+void freeBatteryPaths(BatteryPath_array* paths)
+{
+	for (uint64_t i = 0; i < paths->length; i++)
+		free(paths->data[i]);
+
+	free(paths->data);
+	memset(paths, 0, sizeof(*paths));
+}
+
+static void releaseBattery(BatteryInfo* battery)
+{
+	char* path = battery->path;
+	battery->provider->release(battery);
+	free(path);
+}
+
+BatteryInfo_array getBatteries(const BatteryProvider* provider)
+{
+	BatteryInfo_array batteries = { 0 };
+	rescanBatteries(&batteries, provider);
+	return batteries;
+}
+
+bool rescanBatteries(BatteryInfo_array* batteries, const BatteryProvider* provider)
+{
+	BatteryPath_array paths = { 0 };
+	if (!provider || !provider->enumerate(&paths))
+	{
+		freeBatteryPaths(&paths);
+		return false;
+	}
+
+	bool change = false;
+
+	// Keep batteries that are still listed, claiming their path
+	uint64_t kept = 0;
+	for (uint64_t i = 0; i < batteries->length; i++)
+	{
+		BatteryInfo* battery = &batteries->data[i];
+
+		bool found = battery->provider != provider;
+		for (uint64_t j = 0; j < paths.length && !found; j++)
+			if (paths.data[j] && strcmp(paths.data[j], battery->path) == 0)
+			{
+				free(paths.data[j]);
+				paths.data[j] = NULL;
+				found = true;
+			}
+
+		if (found)
+			batteries->data[kept++] = *battery;
+		else
+		{
+			releaseBattery(battery);
+			change = true;
+		}
+	}
+	batteries->length = kept;
+
+	// Open the paths nobody claimed
+	for (uint64_t i = 0; i < paths.length; i++)
+	{
+		if (!paths.data[i])
+			continue;
+
+		if (!reserve((void**)&batteries->data, &batteries->_max,
+			batteries->length, sizeof(*batteries->data)))
+			break;
+
+		BatteryInfo* battery = &batteries->data[batteries->length];
+		memset(battery, 0, sizeof(*battery));
+		if (!provider->open(battery, paths.data[i]))
+			continue;
+
+		battery->provider = provider;
+		battery->path = paths.data[i];
+		paths.data[i] = NULL;
+
+		provider->readDynamic(battery);
+		provider->readStatic(battery);
+
+		batteries->length++;
+		change = true;
+	}
+
+	freeBatteryPaths(&paths);
+
+	return change;
+}
+
+// The batch op is only used when one provider opened every battery
+static const BatteryProvider* batchProvider(const BatteryInfo_array* batteries)
+{
+	if (!batteries->length || !batteries->data[0].provider->readDynamicBatch)
+		return NULL;
+
+	for (uint64_t i = 1; i < batteries->length; i++)
+		if (batteries->data[i].provider != batteries->data[0].provider)
+			return NULL;
+	return batteries->data[0].provider;
+}
+
+bool updateBatteries(BatteryInfo_array* batteries, BatteryStore* store)
+{
+	bool change = false;
+
+	if (store && store->count != batteries->length)
+		store = NULL;
+
+	const BatteryProvider* provider = batchProvider(batteries);
+	if (provider)
+	{
+		for (uint64_t i = 0; i < batteries->length; i++)
+		{
+			BatteryInfo* battery = &batteries->data[i];
+			battery->shown = (BatteryShown){ .tag = battery->tag, .charge = battery->charge, .isCharging = battery->isCharging };
+		}
+		provider->readDynamicBatch(batteries->data, batteries->length);
+	}
+
+	for (uint32_t i = 0; i < batteries->length; i++)
+	{
+		BatteryInfo* battery = &batteries->data[i];
+		BatteryShown last = { .tag = battery->tag, .charge = battery->charge, .isCharging = battery->isCharging };
+
+		if (provider)
+			last = battery->shown;
+		else
+			battery->provider->readDynamic(battery);
+
+		if (battery->tag != last.tag)
+		{
+			battery->provider->readStatic(battery);
+			resetEstimator(&battery->estimator);
+		}
+
+		if (battery->tag != last.tag ||
+			battery->charge != last.charge ||
+			battery->isCharging != last.isCharging)
+			change = true;
+
+		if (store)
+			setStoredBattery(store, i, battery);
+	}
+
+	return change;
+}
+
+void releaseBatteries(BatteryInfo_array* batteries)
+{
+	for (uint32_t i = 0; i < batteries->length; i++)
+		releaseBattery(&batteries->data[i]);
+
+	free(batteries->data);
+	memset(batteries, 0, sizeof(*batteries));
+}
\ No newline at end of file
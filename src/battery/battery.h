@@ -0,0 +1,278 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "estimator.h"
+
+#define ARRAY(type) typedef struct {type* data; uint64_t length; uint64_t _max; } type##_array;
+
+struct BatteryProvider;
+struct BatteryStore;
+
+/**
+* \brief The fields a change is told by
+*/
+typedef struct BatteryShown
+{
+	uint32_t tag;
+	uint32_t charge;
+	uint8_t isCharging;
+} BatteryShown;
+
+typedef struct BatteryInfo
+{
+	/**
+	* \brief The provider that opened this battery
+	*/
+	const struct BatteryProvider* provider;
+	/**
+	* \brief Provider owned device state
+	*/
+	void* handle;
+	/**
+	* \brief Device path the battery was opened from, used to diff rescans
+	*/
+	char* path;
+	/**
+	* \brief Changes when the physical battery changes, 0 if none is present
+	*/
+	uint32_t tag;
+
+	/**
+	* \brief Designed capacity minus full charged capacity in mWh
+	*/
+	uint32_t wear;
+	/**
+	* \brief Full charged capacity in mWh
+	*/
+	uint32_t capacity;
+	/**
+	* \brief Remaining capacity in mWh
+	*/
+	uint32_t charge;
+	/**
+	* \brief If the battery is on external power
+	*/
+	uint8_t isCharging;
+	/**
+	* \brief Rate reported by the device in mW, negative while discharging, 0 if unknown
+	*/
+	int32_t rate;
+	/**
+	* \brief Terminal voltage in mV, 0 if unknown
+	*/
+	uint32_t voltage;
+
+	/**
+	* \brief Time to empty or full, reset when the tag changes
+	*/
+	BatteryEstimator estimator;
+
+	/**
+	* \brief Shown fields from before a batch read, kept here so a refresh allocates nothing
+	*/
+	BatteryShown shown;
+} BatteryInfo;
+
+ARRAY(BatteryInfo);
+
+typedef char* BatteryPath;
+ARRAY(BatteryPath);
+
+typedef struct BatteryQueryRate
+{
+	/**
+	* \brief Query count when the rate was last sampled
+	*/
+	uint64_t lastQueries;
+	/**
+	* \brief Tick count in nanoseconds when the rate was last sampled
+	*/
+	uint64_t lastTime;
+	/**
+	* \brief Queries per second over the last sample period
+	*/
+	float perSec;
+} BatteryQueryRate;
+
+typedef struct BatteryWakeupRate
+{
+	/**
+	* \brief Wakeup count when the rate was last sampled
+	*/
+	uint64_t lastWakeups;
+	/**
+	* \brief Tick count in nanoseconds when the rate was last sampled
+	*/
+	uint64_t lastTime;
+	/**
+	* \brief Wakeups per hour over the last sample period
+	*/
+	float perHour;
+} BatteryWakeupRate;
+
+typedef struct BatteryProvider
+{
+	/**
+	* \brief Name of the backend
+	*/
+	const char* name;
+
+	/**
+	* \brief Lists the device path of every present battery in a single pass
+	* \param paths [out] Paths added with pushBatteryPath
+	*/
+	bool (*enumerate)(BatteryPath_array* paths);
+	/**
+	* \brief Opens the handles of a battery
+	* \param battery The battery to set the handle of
+	* \param path A path returned by enumerate
+	*/
+	bool (*open)(BatteryInfo* battery, const char* path);
+	/**
+	* \brief Reads fields that only change with the tag (capacity, wear).
+	Only called when enumerated or when readDynamic returns a new tag
+	* \param battery The battery to read
+	*/
+	void (*readStatic)(BatteryInfo* battery);
+	/**
+	* \brief Reads the tag and fields that change while running (charge, power state, rate)
+	* \param battery The battery to read
+	*/
+	void (*readDynamic)(BatteryInfo* battery);
+	/**
+	* \brief Closes the handles opened by open
+	* \param battery The battery to release
+	*/
+	void (*release)(BatteryInfo* battery);
+
+	/**
+	* \brief [optional] Starts waiting for the battery to change
+	* \param battery The battery to watch
+	* \return An OS event to wait on, NULL if the battery has to be polled
+	*/
+	void* (*arm)(BatteryInfo* battery);
+	/**
+	* \brief [optional] Completes a wait after its event was signaled
+	* \param battery The battery that was watched
+	*/
+	void (*disarm)(BatteryInfo* battery);
+	/**
+	* \brief [optional] readDynamic for many batteries at once, every query is in flight together
+	so a refresh waits about as long as the slowest device instead of the sum of them
+	* \param batteries Batteries all opened by this provider
+	* \param count Number of batteries
+	*/
+	void (*readDynamicBatch)(BatteryInfo* batteries, uint64_t count);
+} BatteryProvider;
+
+/**
+* \brief SetupDi and IOCTL_BATTERY_* backend
+*/
+extern const BatteryProvider win32BatteryProvider;
+
+/**
+* \brief /sys/class/power_supply backend
+*/
+extern const BatteryProvider sysfsBatteryProvider;
+
+/**
+* \brief Directory the sysfs backend enumerates, point it at a fake tree to test hot-plugging
+*/
+extern const char* sysfsBatteryRoot;
+
+/**
+* \brief Device queries (IOCTLs, preads) issued by every provider so far
+*/
+extern uint64_t batteryQueries;
+
+/**
+* \brief Times the battery thread woke up so far, for a status change, a poll or a request
+*/
+extern uint64_t batteryWakeups;
+
+/**
+* \brief Updates rate->perSec once a second has passed since the last sample
+* \param rate The previous sample, zero initialized before the first call
+* \param now The current tick count in nanoseconds
+* \return true if perSec was updated
+*/
+bool sampleBatteryQueryRate(BatteryQueryRate* rate, uint64_t now);
+
+/**
+* \brief Updates rate->perHour once a minute has passed since the last sample
+* \param rate The previous sample, zero initialized before the first call
+* \param now The current tick count in nanoseconds
+* \return true if perHour was updated
+*/
+bool sampleBatteryWakeupRate(BatteryWakeupRate* rate, uint64_t now);
+
+/**
+* \brief Returns the provider for the platform being built
+*/
+const BatteryProvider* defaultBatteryProvider();
+
+/**
+* \brief Copies a path onto the end of a growable path array
+* \param paths The array to add to
+* \param path The path to copy
+*/
+bool pushBatteryPath(BatteryPath_array* paths, const char* path);
+
+/**
+* \brief Frees every path and the array
+* \param paths The paths to free
+*/
+void freeBatteryPaths(BatteryPath_array* paths);
+
+/**
+* \brief Opens and reads every present battery
+* \param provider The backend to enumerate with
+* \warning Must be released with releaseBatteries
+*/
+BatteryInfo_array getBatteries(const BatteryProvider* provider);
+
+/**
+* \brief Enumerates again, opening batteries that arrived and releasing ones that left.
+Batteries still present keep their handles and cached fields
+* \param batteries The batteries to update
+* \param provider The backend to enumerate with
+* \return true if a battery was added or removed
+*/
+bool rescanBatteries(BatteryInfo_array* batteries, const BatteryProvider* provider);
+
+/**
+* \brief Re-reads every battery, returns true if anything shown changed.
+Static fields are only re-read for batteries whose tag changed
+* \param batteries The batteries to update
+* \param store [optional] Store mirroring the batteries, updated while each battery is still in cache.
+Skipped if it does not hold as many batteries, storeBatteries after a rescan
+*/
+bool updateBatteries(BatteryInfo_array* batteries, struct BatteryStore* store);
+
+/**
+* \brief Feeds the fields updateBatteries just read into every battery's estimator
+* \param batteries The batteries to sample
+* \param time Sample time in milliseconds
+*/
+void feedBatteryEstimators(BatteryInfo_array* batteries, uint64_t time);
+
+/**
+* \brief Combines every battery's rate into the time until the whole system is empty or full
+* \param batteries The batteries to estimate
+*/
+BatteryEstimate estimateBatteries(const BatteryInfo_array* batteries);
+
+/**
+* \brief Releases every battery and frees the array
+* \param batteries The batteries to release
+*/
+void releaseBatteries(BatteryInfo_array* batteries);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "estimator.h"
+#include "battery.h"
+
+#include <math.h>
+#include <string.h>
+
+// Relative times are rebased onto the oldest sample past this, keeping the sums small
+#define ESTIMATE_REBASE_MS 3600000
+
+void resetEstimator(BatteryEstimator* estimator)
+{
+	memset(estimator, 0, sizeof(*estimator));
+}
+
+static void addPoint(BatteryEstimator* estimator, uint64_t time, uint32_t charge)
+{
+	// Drop the oldest sample once the ring is full
+	if (estimator->count == ESTIMATE_WINDOW)
+	{
+		double t = (estimator->times[estimator->head] - estimator->baseTime) / 1000.0;
+		double c = estimator->charges[estimator->head];
+		estimator->sumT -= t;
+		estimator->sumC -= c;
+		estimator->sumTT -= t * t;
+		estimator->sumTC -= t * c;
+		estimator->sumCC -= c * c;
+		estimator->head = (estimator->head + 1) % ESTIMATE_WINDOW;
+		estimator->count--;
+	}
+
+	if (!estimator->count)
+	{
+		// Start the sums over instead of carrying rounding error
+		estimator->baseTime = time;
+		estimator->sumT = estimator->sumC = 0;
+		estimator->sumTT = estimator->sumTC = estimator->sumCC = 0;
+	}
+	else if (time - estimator->baseTime > ESTIMATE_REBASE_MS)
+	{
+		// Shift every time by d without visiting the ring
+		uint64_t base = estimator->times[estimator->head];
+		double d = (base - estimator->baseTime) / 1000.0;
+		double n = estimator->count;
+		estimator->sumTT += n * d * d - 2 * d * estimator->sumT;
+		estimator->sumTC -= d * estimator->sumC;
+		estimator->sumT -= n * d;
+		estimator->baseTime = base;
+	}
+
+	uint32_t index = (estimator->head + estimator->count) % ESTIMATE_WINDOW;
+	estimator->times[index] = time;
+	estimator->charges[index] = charge;
+	estimator->count++;
+
+	double t = (time - estimator->baseTime) / 1000.0;
+	double c = charge;
+	estimator->sumT += t;
+	estimator->sumC += c;
+	estimator->sumTT += t * t;
+	estimator->sumTC += t * c;
+	estimator->sumCC += c * c;
+}
+
+static void addRate(BatteryEstimator* estimator, uint64_t time, float rate, uint64_t period)
+{
+	estimator->rateTime = time;
+
+	if (!estimator->averaged)
+	{
+		estimator->rate = rate;
+		estimator->variance = 0;
+		estimator->averaged = true;
+		return;
+	}
+
+	// Samples arrive irregularly, weight each by how long it covers
+	float alpha = 1.0f - expf(-(float)period / ESTIMATE_TAU_MS);
+	float diff = rate - estimator->rate;
+	estimator->rate += alpha * diff;
+	estimator->variance = (1.0f - alpha) * (estimator->variance + alpha * diff * diff);
+}
+
+void feedEstimator(BatteryEstimator* estimator, uint64_t time, uint32_t charge, int32_t rate, bool charging)
+{
+	if ((estimator->changes || estimator->count) && estimator->charging != charging)
+		resetEstimator(estimator);
+	estimator->charging = charging;
+
+	if (!estimator->count ||
+		time - estimator->times[(estimator->head + estimator->count - 1) % ESTIMATE_WINDOW] >= ESTIMATE_SPACING_MS)
+		addPoint(estimator, time, charge);
+
+	if (rate)
+	{
+		// The device measured it, no need to wait for the charge to step
+		addRate(estimator, time, (float)rate, estimator->averaged ? time - estimator->rateTime : 0);
+		return;
+	}
+
+	if (!estimator->changes)
+	{
+		estimator->changeTime = time;
+		estimator->changeCharge = charge;
+		estimator->changes = 1;
+		return;
+	}
+
+	if (charge == estimator->changeCharge || time <= estimator->changeTime)
+		return;
+
+	if (estimator->changes > 1)
+	{
+		uint64_t period = time - estimator->changeTime;
+		// mWh per ms to mW
+		float measured = (float)(((double)charge - estimator->changeCharge) * 3600000.0 / period);
+		addRate(estimator, time, measured, period);
+	}
+	else
+		estimator->changes = 2;
+
+	estimator->changeTime = time;
+	estimator->changeCharge = charge;
+}
+
+bool estimatorRate(const BatteryEstimator* estimator, float* rate, float* sigma)
+{
+	bool fitted = false;
+	double fitRate = 0;
+	double fitVariance = 0;
+
+	uint64_t first = estimator->times[estimator->head];
+	uint64_t last = estimator->times[(estimator->head + estimator->count - 1) % ESTIMATE_WINDOW];
+	if (estimator->count >= 3 && last - first >= 2 * ESTIMATE_SPACING_MS)
+	{
+		double n = estimator->count;
+		double stt = estimator->sumTT - estimator->sumT * estimator->sumT / n;
+		double stc = estimator->sumTC - estimator->sumT * estimator->sumC / n;
+		double scc = estimator->sumCC - estimator->sumC * estimator->sumC / n;
+		if (stt > 0)
+		{
+			// Slope in mWh per second and its standard error
+			double slope = stc / stt;
+			double residual = scc - slope * stc;
+			if (residual < 0)
+				residual = 0;
+
+			fitRate = slope * 3600.0;
+			fitVariance = residual / (n - 2) / stt * 3600.0 * 3600.0;
+			fitted = true;
+		}
+	}
+
+	if (fitted && estimator->averaged)
+	{
+		// Disagreement between the two widens the band
+		*rate = (float)((estimator->rate + fitRate) / 2);
+		*sigma = (float)(sqrt((estimator->variance + fitVariance) / 2) + fabs(estimator->rate - fitRate) / 2);
+	}
+	else if (estimator->averaged)
+	{
+		*rate = estimator->rate;
+		*sigma = sqrtf(estimator->variance);
+	}
+	else if (fitted)
+	{
+		*rate = (float)fitRate;
+		*sigma = (float)sqrt(fitVariance);
+	}
+
+	return fitted || estimator->averaged;
+}
+
+BatteryEstimate estimateTime(uint32_t charge, uint32_t capacity, float rate, float sigma)
+{
+	BatteryEstimate estimate = { 0 };
+	estimate.rate = rate;
+	estimate.sigma = sigma;
+
+	// Under a milliwatt the battery is full or idle
+	float speed = fabsf(rate);
+	if (speed < 1.0f)
+		return estimate;
+
+	estimate.valid = true;
+	estimate.charging = rate > 0;
+
+	float energy = estimate.charging ? (capacity > charge ? (float)(capacity - charge) : 0) : (float)charge;
+	estimate.minutes = energy * 60.0f / speed;
+	estimate.low = energy * 60.0f / (speed + sigma);
+	estimate.high = speed - sigma >= 1.0f ? energy * 60.0f / (speed - sigma) : INFINITY;
+	return estimate;
+}
+
+void feedBatteryEstimators(BatteryInfo_array* batteries, uint64_t time)
+{
+	for (uint32_t i = 0; i < batteries->length; i++)
+	{
+		BatteryInfo* battery = &batteries->data[i];
+		if (battery->tag)
+			feedEstimator(&battery->estimator, time, battery->charge, battery->rate, battery->isCharging);
+	}
+}
+
+BatteryEstimate estimateBatteries(const BatteryInfo_array* batteries)
+{
+	uint32_t charge = 0;
+	uint32_t capacity = 0;
+	float rate = 0;
+	float variance = 0;
+	bool known = false;
+
+	for (uint32_t i = 0; i < batteries->length; i++)
+	{
+		const BatteryInfo* battery = &batteries->data[i];
+		if (!battery->tag)
+			continue;
+
+		charge += battery->charge;
+		capacity += battery->capacity;
+
+		float batteryRate, batterySigma;
+		if (estimatorRate(&battery->estimator, &batteryRate, &batterySigma))
+		{
+			rate += batteryRate;
+			variance += batterySigma * batterySigma;
+			known = true;
+		}
+	}
+
+	if (!known)
+		return (BatteryEstimate){ 0 };
+	return estimateTime(charge, capacity, rate, sqrtf(variance));
+}
\ No newline at end of file
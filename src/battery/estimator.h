@@ -0,0 +1,123 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Charge samples kept for the regression, spaced at least ESTIMATE_SPACING_MS apart
+#define ESTIMATE_WINDOW 16
+#define ESTIMATE_SPACING_MS 30000
+// Time constant of the rate average, a sample this old has ~37% of its weight left
+#define ESTIMATE_TAU_MS 120000
+
+typedef struct BatteryEstimator
+{
+	/**
+	* \brief Time in ms and charge in mWh of the last charge change, rates are measured between changes
+	*/
+	uint64_t changeTime;
+	uint32_t changeCharge;
+	/**
+	* \brief Time in ms of the last sample fed into the rate average
+	*/
+	uint64_t rateTime;
+	/**
+	* \brief Exponentially weighted rate in mW (negative while discharging) and its variance
+	*/
+	float rate;
+	float variance;
+	/**
+	* \brief Power state of the last sample, a change resets the estimator
+	*/
+	uint8_t charging;
+	/**
+	* \brief Charge changes seen since the reset, saturating at 2.
+	The first interval starts partway through a step so it is not measured
+	*/
+	uint8_t changes;
+	/**
+	* \brief If the rate average has a sample
+	*/
+	uint8_t averaged;
+
+	/**
+	* \brief Ring of regression samples, times in ms
+	*/
+	uint64_t times[ESTIMATE_WINDOW];
+	uint32_t charges[ESTIMATE_WINDOW];
+	uint32_t head;
+	uint32_t count;
+	/**
+	* \brief Running least squares sums over the ring, times in seconds relative to baseTime
+	*/
+	uint64_t baseTime;
+	double sumT;
+	double sumC;
+	double sumTT;
+	double sumTC;
+	double sumCC;
+} BatteryEstimator;
+
+typedef struct BatteryEstimate
+{
+	/**
+	* \brief false while there is no usable rate (not enough samples, full, idle)
+	*/
+	bool valid;
+	/**
+	* \brief true if minutes is the time to full, otherwise the time to empty
+	*/
+	bool charging;
+	/**
+	* \brief Estimated rate in mW and its standard deviation
+	*/
+	float rate;
+	float sigma;
+	/**
+	* \brief Minutes left, low and high bound one standard deviation of rate either side.
+	high is INFINITY if the rate could be zero
+	*/
+	float minutes;
+	float low;
+	float high;
+} BatteryEstimate;
+
+/**
+* \brief Clears every sample, called when the battery or its power state changes
+* \param estimator The estimator to reset
+*/
+void resetEstimator(BatteryEstimator* estimator);
+
+/**
+* \brief Adds a sample in constant time
+* \param estimator The estimator to update
+* \param time Sample time in milliseconds, must not go backwards
+* \param charge Remaining capacity in mWh
+* \param rate Rate reported by the device in mW, 0 if unknown
+* \param charging If the battery is on external power
+*/
+void feedEstimator(BatteryEstimator* estimator, uint64_t time, uint32_t charge, int32_t rate, bool charging);
+
+/**
+* \brief Blends the rate average with the regression slope
+* \param estimator The estimator to read
+* \param rate [out] Rate in mW, negative while discharging
+* \param sigma [out] Standard deviation of rate, widened when the two disagree
+* \return false if neither has enough samples
+*/
+bool estimatorRate(const BatteryEstimator* estimator, float* rate, float* sigma);
+
+/**
+* \brief Converts a rate into the time until charge reaches 0 or capacity
+* \param charge Remaining capacity in mWh
+* \param capacity Full charged capacity in mWh
+* \param rate Rate in mW, its sign picks time to full or time to empty
+* \param sigma Standard deviation of rate
+*/
+BatteryEstimate estimateTime(uint32_t charge, uint32_t capacity, float rate, float sigma);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,560 @@
+#include "battery.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Submission entries of the batch ring, larger batches are read in several rounds
+#define SYSFS_RING_ENTRIES 1024
+
+const char* sysfsBatteryRoot = "/sys/class/power_supply";
+
+// Attributes readDynamic reads, in batch order
+enum
+{
+	SYSFS_STATUS,
+	SYSFS_ENERGY_NOW,
+	SYSFS_POWER_NOW,
+	SYSFS_VOLTAGE_NOW,
+	SYSFS_DYNAMIC
+};
+
+typedef struct SysfsReading
+{
+	char text[SYSFS_DYNAMIC][32];
+	// Trimmed text lengths, -1 for attributes that could not be read
+	int64_t length[SYSFS_DYNAMIC];
+} SysfsReading;
+
+typedef struct SysfsBattery
+{
+	// Opened once by enumerate, every refresh is a pread from offset 0
+	int energyFull;
+	int energyFullDesign;
+	int energyNow;
+	int status;
+	// Optional, -1 if the driver does not report them
+	int powerNow;
+	int voltageNow;
+	// Tell packs apart, only read when a pack arrives
+	int serialNumber;
+	int modelName;
+	int manufacturer;
+
+	// Tag of the pack present, 0 while there is none
+	uint32_t packTag;
+
+	// Target of the batch reads in flight
+	SysfsReading reading;
+} SysfsBattery;
+
+typedef struct SysfsRing
+{
+	int fd;
+	uint32_t entries;
+
+	uint32_t* sqTail;
+	uint32_t* sqMask;
+	uint32_t* sqArray;
+	struct io_uring_sqe* sqes;
+
+	uint32_t* cqHead;
+	uint32_t* cqTail;
+	uint32_t* cqMask;
+	struct io_uring_cqe* cqes;
+
+	// Set when the kernel has no io_uring or no IORING_OP_READ, batches are read serially
+	bool failed;
+	// Set when reads could not be reaped after a failure, the kernel may still write into their batteries
+	bool stuck;
+} SysfsRing;
+
+// Shared by every battery and kept for the life of the process, batteries are only read from one thread
+static SysfsRing sysfsRing = { .fd = -1 };
+
+
+// Room for a directory of up to PATH_MAX and the longest attribute name, energy_full_design
+#define SYSFS_ATTR_PATH (PATH_MAX + 32)
+
+static int openAttr(const char* dir, const char* attr)
+{
+	char path[SYSFS_ATTR_PATH];
+	int length = snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	// A truncated path could name another file
+	if (length < 0 || length >= (int)sizeof(path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// Terminates len bytes read into buf without the trailing newline, returns the new length or -1
+static int64_t trimAttrText(char* buf, int64_t len)
+{
+	if (len < 0)
+		return -1;
+
+	while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+		len--;
+	buf[len] = '\0';
+	return len;
+}
+
+static int64_t readAttrText(int fd, char* buf, uint64_t size)
+{
+	if (fd < 0)
+		return -1;
+
+	batteryQueries++;
+	return trimAttrText(buf, pread(fd, buf, size - 1, 0));
+}
+
+// Returns sysfs micro units (uWh, uW, uV) as milli units to match IOCTL_BATTERY_*
+static uint32_t readAttrMilli(int fd)
+{
+	char buf[32];
+	if (readAttrText(fd, buf, sizeof(buf)) <= 0)
+		return 0;
+
+	return (uint32_t)(strtoull(buf, NULL, 10) / 1000);
+}
+
+static bool isBattery(const char* dir)
+{
+	char buf[32];
+	int fd = openAttr(dir, "type");
+	bool result = readAttrText(fd, buf, sizeof(buf)) > 0 && strcmp(buf, "Battery") == 0;
+	if (fd >= 0)
+		close(fd);
+	return result;
+}
+
+static void closeFd(int fd)
+{
+	if (fd >= 0)
+		close(fd);
+}
+
+static void closeSysfsBattery(SysfsBattery* dev)
+{
+	closeFd(dev->energyFull);
+	closeFd(dev->energyFullDesign);
+	closeFd(dev->energyNow);
+	closeFd(dev->status);
+	closeFd(dev->powerNow);
+	closeFd(dev->voltageNow);
+	closeFd(dev->serialNumber);
+	closeFd(dev->modelName);
+	closeFd(dev->manufacturer);
+
+	// A stuck ring may still finish a read into dev->reading, the memory is left to it
+	if (!sysfsRing.stuck)
+		free(dev);
+}
+
+
+static bool sysfsEnumerate(BatteryPath_array* paths)
+{
+	DIR* root = opendir(sysfsBatteryRoot);
+	if (!root)
+		return false;
+
+	struct dirent* entry;
+	while ((entry = readdir(root)))
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+
+		char dir[PATH_MAX];
+		int length = snprintf(dir, sizeof(dir), "%s/%s", sysfsBatteryRoot, entry->d_name);
+		if (length >= 0 && length < (int)sizeof(dir) && isBattery(dir))
+			pushBatteryPath(paths, dir);
+	}
+
+	closedir(root);
+
+	return true;
+}
+
+static bool sysfsOpen(BatteryInfo* battery, const char* path)
+{
+	SysfsBattery* dev = malloc(sizeof(*dev));
+	if (!dev)
+		return false;
+
+	dev->energyFull = openAttr(path, "energy_full");
+	dev->energyFullDesign = openAttr(path, "energy_full_design");
+	dev->energyNow = openAttr(path, "energy_now");
+	dev->status = openAttr(path, "status");
+	dev->powerNow = openAttr(path, "power_now");
+	dev->voltageNow = openAttr(path, "voltage_now");
+	dev->serialNumber = openAttr(path, "serial_number");
+	dev->modelName = openAttr(path, "model_name");
+	dev->manufacturer = openAttr(path, "manufacturer");
+	dev->packTag = 0;
+
+	// Batteries only reporting charge_* (uAh) cannot be compared in mWh
+	if (dev->energyNow < 0 || dev->energyFull < 0)
+	{
+		closeSysfsBattery(dev);
+		return false;
+	}
+
+	battery->handle = dev;
+	return true;
+}
+
+static void sysfsReadStatic(BatteryInfo* battery)
+{
+	SysfsBattery* dev = battery->handle;
+
+	battery->capacity = readAttrMilli(dev->energyFull);
+
+	// New packs can hold more than designed and not every driver has energy_full_design, neither is wear
+	uint32_t design = readAttrMilli(dev->energyFullDesign);
+	battery->wear = design > battery->capacity ? design - battery->capacity : 0;
+}
+
+static int dynamicAttr(const SysfsBattery* dev, uint32_t attr)
+{
+	switch (attr)
+	{
+	case SYSFS_STATUS:
+		return dev->status;
+	case SYSFS_ENERGY_NOW:
+		return dev->energyNow;
+	case SYSFS_POWER_NOW:
+		return dev->powerNow;
+	default:
+		return dev->voltageNow;
+	}
+}
+
+// FNV-1a over the identity attributes of the pack, a pack swapped in gets another tag
+static uint32_t readPackTag(const SysfsBattery* dev)
+{
+	const int attrs[] = { dev->serialNumber, dev->modelName, dev->manufacturer, dev->energyFullDesign };
+
+	uint32_t hash = 2166136261u;
+	for (uint32_t i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++)
+	{
+		char text[64];
+		int64_t length = readAttrText(attrs[i], text, sizeof(text));
+		for (int64_t c = 0; c < length; c++)
+			hash = (hash ^ (uint8_t)text[c]) * 16777619u;
+		// Keeps "ab" "c" apart from "a" "bc"
+		hash = (hash ^ 0xFF) * 16777619u;
+	}
+
+	// 0 means no battery
+	return hash ? hash : 1;
+}
+
+static void parseDynamic(BatteryInfo* battery, const SysfsReading* reading)
+{
+	SysfsBattery* dev = battery->handle;
+	const char* status = reading->length[SYSFS_STATUS] >= 0 ? reading->text[SYSFS_STATUS] : "";
+
+	// sysfs has no battery tag, energy_now stops reading once the battery is pulled.
+	// The pack is identified again each time one arrives, so a swap reads the static fields again
+	if (reading->length[SYSFS_ENERGY_NOW] <= 0)
+		dev->packTag = 0;
+	else if (!dev->packTag)
+		dev->packTag = readPackTag(dev);
+	battery->tag = dev->packTag;
+
+	battery->charge = battery->tag ? (uint32_t)(strtoull(reading->text[SYSFS_ENERGY_NOW], NULL, 10) / 1000) : 0;
+	// Anything but discharging ("Charging", "Full", "Not charging") is on external power
+	battery->isCharging = status[0] && strcmp(status, "Discharging") != 0;
+
+	// power_now is a magnitude on most drivers and signed on some, the status gives the direction
+	int32_t milliwatts = 0;
+	if (battery->tag && reading->length[SYSFS_POWER_NOW] > 0)
+		milliwatts = (int32_t)(llabs(strtoll(reading->text[SYSFS_POWER_NOW], NULL, 10)) / 1000);
+	if (strcmp(status, "Discharging") == 0)
+		battery->rate = -milliwatts;
+	else if (strcmp(status, "Charging") == 0)
+		battery->rate = milliwatts;
+	else
+		battery->rate = 0;
+	battery->voltage = battery->tag && reading->length[SYSFS_VOLTAGE_NOW] > 0 ?
+		(uint32_t)(strtoull(reading->text[SYSFS_VOLTAGE_NOW], NULL, 10) / 1000) : 0;
+}
+
+static void sysfsReadDynamic(BatteryInfo* battery)
+{
+	SysfsBattery* dev = battery->handle;
+	SysfsReading reading;
+
+	for (uint32_t attr = 0; attr < SYSFS_DYNAMIC; attr++)
+	{
+		// power_now and voltage_now are only read for a present battery
+		if (attr > SYSFS_ENERGY_NOW && reading.length[SYSFS_ENERGY_NOW] <= 0)
+			reading.length[attr] = -1;
+		else
+			reading.length[attr] = readAttrText(dynamicAttr(dev, attr), reading.text[attr], sizeof(reading.text[attr]));
+	}
+
+	parseDynamic(battery, &reading);
+}
+
+
+// IORING_OP_READ came with IORING_REGISTER_PROBE in 5.6, older kernels fail the probe
+static bool supportsRead(int fd)
+{
+	uint32_t count = IORING_OP_READ + 1;
+	struct io_uring_probe* probe = calloc(1, sizeof(*probe) + count * sizeof(struct io_uring_probe_op));
+	if (!probe)
+		return false;
+
+	bool result = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, count) == 0 &&
+		probe->last_op >= IORING_OP_READ &&
+		(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	return result;
+}
+
+static bool openSysfsRing(SysfsRing* ring)
+{
+	if (ring->failed)
+		return false;
+	if (ring->fd >= 0)
+		return true;
+
+	struct io_uring_params params = { 0 };
+	int fd = (int)syscall(__NR_io_uring_setup, SYSFS_RING_ENTRIES, &params);
+	if (fd < 0)
+	{
+		ring->failed = true;
+		return false;
+	}
+
+	if (!supportsRead(fd))
+	{
+		close(fd);
+		ring->failed = true;
+		return false;
+	}
+
+	// Mapped separately, which kernels with IORING_FEAT_SINGLE_MMAP still accept
+	uint64_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	uint64_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	uint64_t sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	uint8_t* sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	uint8_t* cq = mmap(NULL, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	void* sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		if (sq != MAP_FAILED)
+			munmap(sq, sqSize);
+		if (cq != MAP_FAILED)
+			munmap(cq, cqSize);
+		if (sqes != MAP_FAILED)
+			munmap(sqes, sqesSize);
+		close(fd);
+		ring->failed = true;
+		return false;
+	}
+
+	ring->fd = fd;
+	ring->entries = params.sq_entries;
+	ring->sqTail = (uint32_t*)(sq + params.sq_off.tail);
+	ring->sqMask = (uint32_t*)(sq + params.sq_off.ring_mask);
+	ring->sqArray = (uint32_t*)(sq + params.sq_off.array);
+	ring->sqes = sqes;
+	ring->cqHead = (uint32_t*)(cq + params.cq_off.head);
+	ring->cqTail = (uint32_t*)(cq + params.cq_off.tail);
+	ring->cqMask = (uint32_t*)(cq + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+	return true;
+}
+
+// Queues a read of every dynamic attribute, returns the number queued
+static uint32_t queueDynamic(SysfsRing* ring, SysfsBattery* dev, uint32_t tail)
+{
+	uint32_t queued = 0;
+	for (uint32_t attr = 0; attr < SYSFS_DYNAMIC; attr++)
+	{
+		dev->reading.length[attr] = -1;
+		int fd = dynamicAttr(dev, attr);
+		if (fd < 0)
+			continue;
+
+		uint32_t index = (tail + queued) & *ring->sqMask;
+		struct io_uring_sqe* sqe = &ring->sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = fd;
+		sqe->off = 0;
+		sqe->addr = (uint64_t)(uintptr_t)dev->reading.text[attr];
+		sqe->len = sizeof(dev->reading.text[attr]) - 1;
+		sqe->user_data = (uint64_t)(uintptr_t)&dev->reading.length[attr];
+		ring->sqArray[index] = index;
+
+		batteryQueries++;
+		queued++;
+	}
+	return queued;
+}
+
+static bool transientRingError()
+{
+	return errno == EINTR || errno == EAGAIN || errno == EBUSY;
+}
+
+// Stores every finished read in its battery, returns how many were reaped
+static uint32_t reapCompleted(SysfsRing* ring)
+{
+	uint32_t reaped = 0;
+	uint32_t head = *ring->cqHead;
+	uint32_t tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++)
+	{
+		// The cancel request carries no battery
+		const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cqMask];
+		if (!cqe->user_data)
+			continue;
+
+		*(int64_t*)(uintptr_t)cqe->user_data = cqe->res;
+		reaped++;
+	}
+	__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+	return reaped;
+}
+
+// The kernel writes a read into its battery until it completes, so a ring that failed with reads in flight
+// cancels and reaps all of them before a release can free the batteries
+static void cancelQueued(SysfsRing* ring, uint32_t queued, uint32_t submitted, uint32_t completed)
+{
+	uint32_t tail = *ring->sqTail;
+	uint32_t unsubmitted = queued - submitted;
+
+	// Entries the kernel has not taken yet become no-ops, they still complete so every read is accounted for
+	for (uint32_t i = tail - unsubmitted; i != tail; i++)
+	{
+		struct io_uring_sqe* sqe = &ring->sqes[i & *ring->sqMask];
+		uint64_t userData = sqe->user_data;
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_NOP;
+		sqe->user_data = userData;
+	}
+
+	// One request cancels every read, kernels before 5.19 reject it and the reads are waited for instead
+	uint32_t toSubmit = unsubmitted;
+	if (submitted > completed)
+	{
+		uint32_t index = tail & *ring->sqMask;
+		struct io_uring_sqe* sqe = &ring->sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+		ring->sqArray[index] = index;
+		__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+		toSubmit++;
+	}
+
+	while (completed < queued)
+	{
+		int result = (int)syscall(__NR_io_uring_enter, ring->fd, toSubmit,
+			queued - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (result < 0 && !transientRingError())
+		{
+			ring->stuck = true;
+			return;
+		}
+		if (result > 0)
+			toSubmit -= (uint32_t)result < toSubmit ? (uint32_t)result : toSubmit;
+
+		completed += reapCompleted(ring);
+	}
+}
+
+// Submits the queued reads and waits for all of them, returns false if the ring broke
+static bool completeQueued(SysfsRing* ring, uint32_t queued)
+{
+	uint32_t submitted = 0;
+	uint32_t completed = 0;
+
+	while (completed < queued)
+	{
+		int result = (int)syscall(__NR_io_uring_enter, ring->fd, queued - submitted,
+			queued - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (result < 0 && !transientRingError())
+		{
+			// The batch is read serially instead and the ring is not used again
+			cancelQueued(ring, queued, submitted, completed);
+			ring->failed = true;
+			return false;
+		}
+		if (result > 0)
+			submitted += result;
+
+		completed += reapCompleted(ring);
+	}
+	return true;
+}
+
+static void sysfsReadDynamicBatch(BatteryInfo* batteries, uint64_t count)
+{
+	SysfsRing* ring = &sysfsRing;
+	uint64_t done = 0;
+
+	// Every attribute of every battery is in flight at once, reads past the ring size go in the next round
+	while (done < count && openSysfsRing(ring))
+	{
+		uint32_t tail = *ring->sqTail;
+		uint32_t queued = 0;
+		uint64_t end = done;
+		for (; end < count && queued + SYSFS_DYNAMIC <= ring->entries; end++)
+			queued += queueDynamic(ring, batteries[end].handle, tail + queued);
+		__atomic_store_n(ring->sqTail, tail + queued, __ATOMIC_RELEASE);
+
+		if (!completeQueued(ring, queued))
+			break;
+
+		for (; done < end; done++)
+		{
+			SysfsReading* reading = &((SysfsBattery*)batteries[done].handle)->reading;
+			for (uint32_t attr = 0; attr < SYSFS_DYNAMIC; attr++)
+				reading->length[attr] = trimAttrText(reading->text[attr], reading->length[attr]);
+			parseDynamic(&batteries[done], reading);
+		}
+	}
+
+	for (; done < count; done++)
+		sysfsReadDynamic(&batteries[done]);
+}
+
+static void sysfsRelease(BatteryInfo* battery)
+{
+	SysfsBattery* dev = battery->handle;
+	if (dev)
+		closeSysfsBattery(dev);
+	memset(battery, 0, sizeof(*battery));
+}
+
+const BatteryProvider sysfsBatteryProvider =
+{
+	.name = "sysfs",
+	.enumerate = sysfsEnumerate,
+	.open = sysfsOpen,
+	.readStatic = sysfsReadStatic,
+	.readDynamic = sysfsReadDynamic,
+	.release = sysfsRelease,
+	// power_supply attributes do not support poll(), batteries are polled
+	.arm = NULL,
+	.disarm = NULL,
+	.readDynamicBatch = sysfsReadDynamicBatch,
+};
\ No newline at end of file
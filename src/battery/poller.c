@@ -0,0 +1,252 @@
+#include "poller.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Set in _middle while the slot in it is newer than the reader's
+#define POLLER_FRESH 4
+#define POLLER_SLOT 3
+
+#define POLLER_STOP 1
+#define POLLER_RESCAN 2
+
+// One slot of the thread's wait is reserved for requests
+#define POLLER_WAITS 63
+
+
+static inline uint32_t exchange32(uint32_t* dest, uint32_t value)
+{
+#ifdef _MSC_VER
+	return (uint32_t)_InterlockedExchange((volatile long*)dest, (long)value);
+#else
+	return __atomic_exchange_n(dest, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline uint32_t fetchOr32(uint32_t* dest, uint32_t value)
+{
+#ifdef _MSC_VER
+	return (uint32_t)_InterlockedOr((volatile long*)dest, (long)value);
+#else
+	return __atomic_fetch_or(dest, value, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline uint32_t acquire32(const uint32_t* src)
+{
+#ifdef _MSC_VER
+	return (uint32_t)_InterlockedCompareExchange((volatile long*)src, 0, 0);
+#else
+	return __atomic_load_n(src, __ATOMIC_ACQUIRE);
+#endif
+}
+
+
+bool startPoller(BatteryPoller* poller, const BatteryProvider* provider, uint32_t pollMs,
+	BatteryChangeCallback onChange, void* userData)
+{
+	memset(poller, 0, sizeof(*poller));
+	poller->provider = provider;
+	poller->pollMs = pollMs;
+	poller->onChange = onChange;
+	poller->userData = userData;
+
+	// Until the first read every slot is an empty snapshot
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		poller->_slots[i].batteries.data = poller->_slots[i].storage;
+		poller->_slots[i].batteries._max = POLLER_BATTERIES;
+	}
+	poller->_front = 0;
+	poller->_middle = 1;
+	poller->_back = 2;
+
+	if (!_openPoller(poller))
+		return false;
+
+	if (!_startPollerThread(poller))
+	{
+		_closePoller(poller);
+		return false;
+	}
+	return true;
+}
+
+void stopPoller(BatteryPoller* poller)
+{
+	fetchOr32(&poller->_requests, POLLER_STOP);
+	_wakePollerThread(poller);
+	_joinPollerThread(poller);
+	_closePoller(poller);
+}
+
+void rescanPoller(BatteryPoller* poller)
+{
+	fetchOr32(&poller->_requests, POLLER_RESCAN);
+	_wakePollerThread(poller);
+}
+
+void watchPollerSamples(BatteryPoller* poller, bool value)
+{
+	exchange32(&poller->_watchSamples, value);
+}
+
+const BatterySnapshot* acquireSnapshot(BatteryPoller* poller)
+{
+	if (acquire32(&poller->_middle) & POLLER_FRESH)
+	{
+		// Reset first, a publish after the swap signals again
+		_drainPollerReader(poller);
+		poller->_front = exchange32(&poller->_middle, poller->_front) & POLLER_SLOT;
+	}
+	return &poller->_slots[poller->_front];
+}
+
+void* pollerEvent(const BatteryPoller* poller)
+{
+	return (void*)poller->_wake;
+}
+
+static void publish(BatteryPoller* poller, const BatteryInfo_array* batteries, bool changed)
+{
+	BatterySnapshot* snapshot = &poller->_slots[poller->_back];
+
+	if (changed)
+		poller->_generation++;
+	poller->_samples++;
+
+	snapshot->generation = poller->_generation;
+	snapshot->samples = poller->_samples;
+	snapshot->maxReadNs = poller->_maxReadNs;
+	snapshot->totals = poller->_store.totals;
+
+	// Handles and paths stay with the thread, they change under rescans
+	uint64_t count = batteries->length < POLLER_BATTERIES ? batteries->length : POLLER_BATTERIES;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		snapshot->storage[i] = batteries->data[i];
+		snapshot->storage[i].handle = NULL;
+		snapshot->storage[i].path = NULL;
+	}
+	snapshot->batteries.length = count;
+
+	poller->_back = exchange32(&poller->_middle, poller->_back | POLLER_FRESH) & POLLER_SLOT;
+
+	if (changed || acquire32(&poller->_watchSamples))
+		_wakePollerReader(poller);
+}
+
+void _runPoller(BatteryPoller* poller)
+{
+	const BatteryProvider* provider = poller->provider;
+
+	BatteryInfo_array batteries = getBatteries(provider);
+	storeBatteries(&poller->_store, &batteries);
+	feedBatteryEstimators(&batteries, sft_toMILLISEC(sft_timer_now()));
+	if (poller->onChange)
+		poller->onChange(&batteries, poller->userData);
+	publish(poller, &batteries, true);
+
+	sft_schedule schedule = { 0 };
+	int32_t pollTask = sft_schedule_add(&schedule, sft_toNANOSEC(poller->pollMs), sft_timer_now());
+
+#ifdef _DEBUG
+	BatteryQueryRate queryRate = { .lastTime = sft_timer_coarse() };
+	BatteryWakeupRate wakeupRate = { .lastTime = sft_timer_coarse() };
+#endif
+
+	for (;;)
+	{
+		void* events[POLLER_WAITS];
+		uint32_t owners[POLLER_WAITS];
+		uint32_t count = 0;
+
+		for (uint32_t i = 0; i < batteries.length && count < POLLER_WAITS; i++)
+		{
+			BatteryInfo* battery = &batteries.data[i];
+			void* event = battery->provider->arm ? battery->provider->arm(battery) : NULL;
+			if (event)
+			{
+				events[count] = event;
+				owners[count] = i;
+				count++;
+			}
+		}
+
+		int32_t index = _waitPoller(poller, events, count,
+			sft_schedule_msUntil(&schedule, sft_timer_now()));
+		batteryWakeups++;
+
+		uint32_t requests = exchange32(&poller->_requests, 0);
+		if (requests & POLLER_STOP)
+			break;
+
+		bool changed = false;
+		bool read = false;
+
+		if (index >= 0)
+		{
+			BatteryInfo* battery = &batteries.data[owners[index]];
+			battery->provider->disarm(battery);
+			read = true;
+		}
+
+		// Batteries without a pending wait can only be polled
+		bool poll = (sft_schedule_due(&schedule, sft_timer_now()) >> pollTask) & 1;
+		if (poll && count < batteries.length)
+			read = true;
+
+		// Batteries move in a rescan, the store is mirrored again
+		if (requests & POLLER_RESCAN)
+		{
+			changed |= rescanBatteries(&batteries, provider);
+			storeBatteries(&poller->_store, &batteries);
+		}
+
+		if (read)
+		{
+			uint64_t start = sft_timer_now();
+			changed |= updateBatteries(&batteries, &poller->_store);
+			uint64_t elapsed = sft_timer_now() - start;
+			if (elapsed > poller->_maxReadNs)
+				poller->_maxReadNs = elapsed;
+
+			feedBatteryEstimators(&batteries, sft_toMILLISEC(sft_timer_now()));
+		}
+
+		if (changed && poller->onChange)
+			poller->onChange(&batteries, poller->userData);
+		if (changed || read)
+			publish(poller, &batteries, changed);
+
+#ifdef _DEBUG
+		// The totals only ever move by differences, a sum from scratch catches one that went wrong
+		if (read || (requests & POLLER_RESCAN))
+		{
+			BatteryTotals sum = sumBatteryStore(&poller->_store);
+			const BatteryTotals* totals = &poller->_store.totals;
+			if (memcmp(&sum, totals, sizeof(sum)) != 0)
+				printf("Battery totals drifted: %llu/%llu mWh kept, %llu/%llu mWh summed\n",
+					(unsigned long long)totals->charge, (unsigned long long)totals->capacity,
+					(unsigned long long)sum.charge, (unsigned long long)sum.capacity);
+		}
+		if (sampleBatteryQueryRate(&queryRate, sft_timer_coarse()))
+		{
+			sft_task* task = &schedule.tasks[pollTask];
+			printf("Battery queries: %.2f/s, slowest read %.3fms\n", queryRate.perSec, poller->_maxReadNs / 1000000.0);
+			printf("Battery poll: %llu runs, %llu missed, max %.3fms late\n",
+				(unsigned long long)task->runs, (unsigned long long)task->missed, task->maxLate / 1000000.0);
+		}
+		if (sampleBatteryWakeupRate(&wakeupRate, sft_timer_coarse()))
+			printf("Battery wakeups: %.0f/h, %u of %u batteries waiting\n", wakeupRate.perHour, count, (uint32_t)batteries.length);
+#endif
+	}
+
+	releaseBatteries(&batteries);
+	freeBatteryStore(&poller->_store);
+}
\ No newline at end of file
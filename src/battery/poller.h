@@ -0,0 +1,169 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "battery.h"
+#include "store.h"
+
+// Batteries a snapshot holds, any past it are left out
+#define POLLER_BATTERIES 16
+
+/*
+* The poller thread owns the battery handles and is the only one to read them.
+* Every read is published as a snapshot through a triple buffer: the thread fills
+* its back slot and swaps it with the middle one, the reader swaps the middle one
+* with its front slot when it is newer. Neither side ever waits on the other, and
+* a snapshot the reader holds is not written until the reader acquires again
+*/
+
+typedef struct BatterySnapshot
+{
+	/**
+	* \brief Increases whenever a shown field changed, starts at 0 before the first read
+	*/
+	uint64_t generation;
+	/**
+	* \brief Increases with every read, the estimate moves even when generation does not
+	*/
+	uint64_t samples;
+	/**
+	* \brief Copies without handle or path, data points into storage
+	*/
+	BatteryInfo_array batteries;
+	BatteryInfo storage[POLLER_BATTERIES];
+	/**
+	* \brief Sums over every battery, the ones past storage included
+	*/
+	BatteryTotals totals;
+
+	/**
+	* \brief Slowest read of every battery so far, in nanoseconds
+	*/
+	uint64_t maxReadNs;
+} BatterySnapshot;
+
+/**
+* \brief Called on the poller thread after a read that changed a shown field
+*/
+typedef void (*BatteryChangeCallback)(BatteryInfo_array* batteries, void* userData);
+
+typedef struct BatteryPoller
+{
+	const BatteryProvider* provider;
+	uint32_t pollMs;
+	BatteryChangeCallback onChange;
+	void* userData;
+
+	/**
+	* \brief Internal triple buffer, _middle is shared and holds a slot index and POLLER_FRESH
+	*/
+	BatterySnapshot _slots[3];
+	uint32_t _middle;
+	uint32_t _back;
+	uint32_t _front;
+
+	/**
+	* \brief Internal POLLER_* requests for the thread, and if every read wakes the reader
+	*/
+	uint32_t _requests;
+	uint32_t _watchSamples;
+
+	/**
+	* \brief Internal counters only the thread touches
+	*/
+	uint64_t _generation;
+	uint64_t _samples;
+	uint64_t _maxReadNs;
+	BatteryStore _store;
+
+	/**
+	* \brief Internal thread and the objects waking the reader and the thread
+	*/
+	intptr_t _thread;
+	intptr_t _wake;
+	intptr_t _wakeSignal;
+	intptr_t _control;
+	intptr_t _controlSignal;
+} BatteryPoller;
+
+/**
+* \brief Starts the thread, which enumerates and publishes the first snapshot
+* \param poller The poller to start
+* \param provider The backend the thread enumerates with
+* \param pollMs Period batteries without a pending wait are polled at
+* \param onChange [optional] Called on the thread after reads that changed a shown field
+* \param userData Passed to onChange
+* \warning Must be stopped with stopPoller
+*/
+bool startPoller(BatteryPoller* poller, const BatteryProvider* provider, uint32_t pollMs,
+	BatteryChangeCallback onChange, void* userData);
+
+/**
+* \brief Stops the thread and releases the batteries it opened
+* \param poller The poller to stop
+*/
+void stopPoller(BatteryPoller* poller);
+
+/**
+* \brief Asks the thread to enumerate again, for device change notifications
+* \param poller The poller to ask
+*/
+void rescanPoller(BatteryPoller* poller);
+
+/**
+* \brief Sets if the reader is woken for every read or only when a shown field changed
+* \param poller The poller to set
+* \param value True to be woken for every read
+*/
+void watchPollerSamples(BatteryPoller* poller, bool value);
+
+/**
+* \brief Returns the newest snapshot without waiting, it stays valid until the next call
+* \param poller The poller to read
+* \warning Only one thread may acquire snapshots
+*/
+const BatterySnapshot* acquireSnapshot(BatteryPoller* poller);
+
+/**
+* \brief Returns the object signaled when a new snapshot is worth acquiring, to pass to sft_window_wait
+* \param poller The poller to wait on
+*/
+void* pollerEvent(const BatteryPoller* poller);
+
+/**
+* \brief Internal functions that are OS specific
+*/
+bool _openPoller(BatteryPoller* poller);
+void _closePoller(BatteryPoller* poller);
+bool _startPollerThread(BatteryPoller* poller);
+void _joinPollerThread(BatteryPoller* poller);
+/**
+* \brief Signals the reader's event
+*/
+void _wakePollerReader(BatteryPoller* poller);
+/**
+* \brief Resets the reader's event after it woke
+*/
+void _drainPollerReader(BatteryPoller* poller);
+/**
+* \brief Interrupts _waitPoller
+*/
+void _wakePollerThread(BatteryPoller* poller);
+/**
+* \brief Waits for a battery event, a request or the timeout
+* \return The index of the signaled battery event, -1 otherwise
+*/
+int32_t _waitPoller(BatteryPoller* poller, void* const* events, uint32_t count, uint32_t ms);
+
+/**
+* \brief Internal thread body, run by the thread _startPollerThread creates
+*/
+void _runPoller(BatteryPoller* poller);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "poller.h"
+
+#ifndef _WIN32
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A pipe stands in for an event, readable while signaled
+static bool openPipe(intptr_t* readEnd, intptr_t* writeEnd)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return false;
+
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+		fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	*readEnd = fds[0];
+	*writeEnd = fds[1];
+	return true;
+}
+
+static void signalPipe(intptr_t fd)
+{
+	// A full pipe is signaled already
+	char byte = 1;
+	while (write((int)fd, &byte, 1) < 0 && errno == EINTR);
+}
+
+static void drainPipe(intptr_t fd)
+{
+	char discard[64];
+	while (read((int)fd, discard, sizeof(discard)) > 0);
+}
+
+bool _openPoller(BatteryPoller* poller)
+{
+	if (!openPipe(&poller->_wake, &poller->_wakeSignal))
+		return false;
+
+	if (!openPipe(&poller->_control, &poller->_controlSignal))
+	{
+		close((int)poller->_wake);
+		close((int)poller->_wakeSignal);
+		return false;
+	}
+	return true;
+}
+
+void _closePoller(BatteryPoller* poller)
+{
+	close((int)poller->_wake);
+	close((int)poller->_wakeSignal);
+	close((int)poller->_control);
+	close((int)poller->_controlSignal);
+}
+
+static void* pollerThread(void* arg)
+{
+	_runPoller(arg);
+	return NULL;
+}
+
+bool _startPollerThread(BatteryPoller* poller)
+{
+	// pthread_t is opaque, it is kept on the heap
+	pthread_t* thread = malloc(sizeof(*thread));
+	if (!thread)
+		return false;
+
+	if (pthread_create(thread, NULL, pollerThread, poller) != 0)
+	{
+		free(thread);
+		return false;
+	}
+
+	poller->_thread = (intptr_t)thread;
+	return true;
+}
+
+void _joinPollerThread(BatteryPoller* poller)
+{
+	pthread_t* thread = (pthread_t*)poller->_thread;
+	pthread_join(*thread, NULL);
+	free(thread);
+	poller->_thread = 0;
+}
+
+void _wakePollerReader(BatteryPoller* poller)
+{
+	signalPipe(poller->_wakeSignal);
+}
+
+void _drainPollerReader(BatteryPoller* poller)
+{
+	drainPipe(poller->_wake);
+}
+
+void _wakePollerThread(BatteryPoller* poller)
+{
+	signalPipe(poller->_controlSignal);
+}
+
+int32_t _waitPoller(BatteryPoller* poller, void* const* events, uint32_t count, uint32_t ms)
+{
+	// Battery events are file descriptors cast to pointers, the requests pipe goes last
+	struct pollfd fds[64];
+	if (count > 63)
+		count = 63;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		fds[i].fd = (int)(intptr_t)events[i];
+		fds[i].events = POLLIN | POLLPRI;
+		fds[i].revents = 0;
+	}
+	fds[count].fd = (int)poller->_control;
+	fds[count].events = POLLIN;
+	fds[count].revents = 0;
+
+	if (poll(fds, count + 1, ms > INT32_MAX ? -1 : (int)ms) <= 0)
+		return -1;
+
+	if (fds[count].revents)
+		drainPipe(poller->_control);
+
+	for (uint32_t i = 0; i < count; i++)
+		if (fds[i].revents)
+			return i;
+	return -1;
+}
+
+#endif
\ No newline at end of file
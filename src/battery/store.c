@@ -0,0 +1,175 @@
+#include "store.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// SSE2 is part of x64, so it needs no detection there
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#define STORE_SSE2
+#include <emmintrin.h>
+#endif
+
+static inline uint64_t bitWords(uint64_t count)
+{
+	return (count + 63) / 64;
+}
+
+static inline bool getBit(const uint64_t* bits, uint64_t index)
+{
+	return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+static inline void setBit(uint64_t* bits, uint64_t index, bool value)
+{
+	uint64_t mask = 1ull << (index % 64);
+	bits[index / 64] = value ? bits[index / 64] | mask : bits[index / 64] & ~mask;
+}
+
+// Bits set in a word without a popcount instruction, which x64 does not guarantee
+static inline uint64_t countBits(uint64_t x)
+{
+	x = x - ((x >> 1) & 0x5555555555555555ull);
+	x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+	return (x * 0x0101010101010101ull) >> 56;
+}
+
+static bool growArray(void** data, uint64_t oldSize, uint64_t newSize)
+{
+	uint8_t* ptr = realloc(*data, newSize);
+	if (!ptr)
+		return false;
+
+	// Slots past count stay zero, sums and bit counts run over them
+	memset(ptr + oldSize, 0, newSize - oldSize);
+	*data = ptr;
+	return true;
+}
+
+static bool reserveStore(BatteryStore* store, uint64_t count)
+{
+	if (count <= store->_max)
+		return true;
+
+	uint64_t newMax = store->_max ? store->_max * 2 : 64;
+	while (newMax < count)
+		newMax *= 2;
+
+	// An array that grew before a failure is only larger, the store stays valid
+	uint64_t oldValues = store->_max * sizeof(uint32_t);
+	uint64_t newValues = newMax * sizeof(uint32_t);
+	uint64_t oldBits = bitWords(store->_max) * sizeof(uint64_t);
+	uint64_t newBits = bitWords(newMax) * sizeof(uint64_t);
+	if (!growArray((void**)&store->charge, oldValues, newValues) ||
+		!growArray((void**)&store->capacity, oldValues, newValues) ||
+		!growArray((void**)&store->wear, oldValues, newValues) ||
+		!growArray((void**)&store->present, oldBits, newBits) ||
+		!growArray((void**)&store->charging, oldBits, newBits))
+		return false;
+
+	store->_max = newMax;
+	return true;
+}
+
+bool storeBatteries(BatteryStore* store, const BatteryInfo_array* batteries)
+{
+	if (!reserveStore(store, batteries->length))
+		return false;
+
+	// Batteries past the new count leave the totals and their slots read zero again
+	BatteryInfo removed = { 0 };
+	for (uint64_t i = batteries->length; i < store->count; i++)
+		setStoredBattery(store, i, &removed);
+	store->count = batteries->length;
+
+	for (uint64_t i = 0; i < batteries->length; i++)
+		setStoredBattery(store, i, &batteries->data[i]);
+	return true;
+}
+
+void setStoredBattery(BatteryStore* store, uint64_t index, const BatteryInfo* battery)
+{
+	BatteryTotals* totals = &store->totals;
+	bool present = battery->tag != 0;
+	bool charging = battery->isCharging != 0;
+
+	// Most batteries did not change since the last read, their slots are left untouched
+	if (store->charge[index] == battery->charge &&
+		store->capacity[index] == battery->capacity &&
+		store->wear[index] == battery->wear &&
+		getBit(store->present, index) == present &&
+		getBit(store->charging, index) == charging)
+		return;
+
+	// Unsigned wrap around makes adding the difference work both ways
+	totals->charge += (uint64_t)battery->charge - store->charge[index];
+	totals->capacity += (uint64_t)battery->capacity - store->capacity[index];
+	totals->wear += (uint64_t)battery->wear - store->wear[index];
+	totals->present += (uint64_t)present - getBit(store->present, index);
+	totals->charging += (uint64_t)charging - getBit(store->charging, index);
+
+	store->charge[index] = battery->charge;
+	store->capacity[index] = battery->capacity;
+	store->wear[index] = battery->wear;
+	setBit(store->present, index, present);
+	setBit(store->charging, index, charging);
+}
+
+static uint64_t sumValues(const uint32_t* values, uint64_t count)
+{
+	uint64_t sum = 0;
+	uint64_t i = 0;
+
+#ifdef STORE_SSE2
+	// Widened to 64 bit lanes, 32 bit lanes overflow after a few batteries
+	__m128i zero = _mm_setzero_si128();
+	__m128i low = zero;
+	__m128i high = zero;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(values + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(values + i + 4));
+		low = _mm_add_epi64(low, _mm_unpacklo_epi32(a, zero));
+		high = _mm_add_epi64(high, _mm_unpackhi_epi32(a, zero));
+		low = _mm_add_epi64(low, _mm_unpacklo_epi32(b, zero));
+		high = _mm_add_epi64(high, _mm_unpackhi_epi32(b, zero));
+	}
+
+	uint64_t lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, _mm_add_epi64(low, high));
+	sum = lanes[0] + lanes[1];
+#endif
+
+	for (; i < count; i++)
+		sum += values[i];
+	return sum;
+}
+
+static uint64_t sumBits(const uint64_t* bits, uint64_t count)
+{
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < bitWords(count); i++)
+		sum += countBits(bits[i]);
+	return sum;
+}
+
+BatteryTotals sumBatteryStore(const BatteryStore* store)
+{
+	return (BatteryTotals){
+		.charge = sumValues(store->charge, store->count),
+		.capacity = sumValues(store->capacity, store->count),
+		.wear = sumValues(store->wear, store->count),
+		.present = sumBits(store->present, store->count),
+		.charging = sumBits(store->charging, store->count),
+	};
+}
+
+void freeBatteryStore(BatteryStore* store)
+{
+	free(store->charge);
+	free(store->capacity);
+	free(store->wear);
+	free(store->present);
+	free(store->charging);
+	memset(store, 0, sizeof(*store));
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "battery.h"
+
+/*
+* The fields every redraw adds up, stored as one array per field instead of inside
+* BatteryInfo. BatteryInfo stays what providers fill, with its handle, path and
+* estimator next to the counters, the store mirrors the counters after every update
+* so aggregating only streams through the arrays it needs
+*/
+
+typedef struct BatteryTotals
+{
+	/**
+	* \brief Sums over every battery in mWh
+	*/
+	uint64_t charge;
+	uint64_t capacity;
+	uint64_t wear;
+	/**
+	* \brief Batteries with a tag, and batteries on external power
+	*/
+	uint64_t present;
+	uint64_t charging;
+} BatteryTotals;
+
+typedef struct BatteryStore
+{
+	/**
+	* \brief Fields of battery i at index i, in mWh
+	*/
+	uint32_t* charge;
+	uint32_t* capacity;
+	uint32_t* wear;
+	/**
+	* \brief Bit i % 64 of word i / 64 is set if battery i has a tag, or is on external power
+	*/
+	uint64_t* present;
+	uint64_t* charging;
+	uint64_t count;
+	uint64_t _max;
+
+	/**
+	* \brief Kept up to date by every set, sumBatteryStore recomputes the same values
+	*/
+	BatteryTotals totals;
+} BatteryStore;
+
+/**
+* \brief Mirrors every battery into the store, only the batteries that changed move the totals
+* \param store The store to update
+* \param batteries The batteries to mirror, battery i goes to index i
+* \return False when out of memory, the store is left as it was
+*/
+bool storeBatteries(BatteryStore* store, const BatteryInfo_array* batteries);
+
+/**
+* \brief Sets one battery and moves the totals by the difference
+* \param store The store to update
+* \param index The battery index, below count
+* \param battery The battery to mirror
+*/
+void setStoredBattery(BatteryStore* store, uint64_t index, const BatteryInfo* battery);
+
+/**
+* \brief Adds up the arrays from scratch, vectorized where the CPU allows
+* \param store The store to sum
+*/
+BatteryTotals sumBatteryStore(const BatteryStore* store);
+
+/**
+* \brief Frees the arrays and empties the store
+* \param store The store to free
+*/
+void freeBatteryStore(BatteryStore* store);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,722 @@
+#include "trace.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC "BTRC"
+#define TRACE_VERSION 1
+
+// Longest path a trace stores
+#define TRACE_MAX_PATH 4096
+
+enum
+{
+	// Start an enumeration or a batch read, milliseconds since the previous round. The records after one belong to it
+	TRACE_SCAN = 1,
+	TRACE_READ,
+	// id, length, path bytes. Written the first time a path is enumerated, ids count up from 0
+	TRACE_PATH,
+	// count, ids of every battery enumerated
+	TRACE_ENUMERATE,
+	// id, tag, charge, isCharging, zigzag rate, voltage
+	TRACE_DYNAMIC,
+	// id, capacity, wear
+	TRACE_STATIC
+};
+
+typedef struct TraceRecord
+{
+	uint8_t type;
+	// Milliseconds since the recording started, of the round the record belongs to
+	uint64_t time;
+	uint32_t id;
+
+	uint32_t tag;
+	uint32_t charge;
+	uint8_t isCharging;
+	int32_t rate;
+	uint32_t voltage;
+	uint32_t capacity;
+	uint32_t wear;
+
+	// TRACE_PATH bytes or TRACE_ENUMERATE ids, still encoded in the trace
+	const uint8_t* list;
+	uint64_t listLength;
+} TraceRecord;
+
+
+static void putVarint(FILE* file, uint64_t value)
+{
+	uint8_t buf[10];
+	uint32_t len = 0;
+	do
+	{
+		buf[len] = value & 0x7F;
+		value >>= 7;
+		buf[len++] |= value ? 0x80 : 0;
+	} while (value);
+
+	fwrite(buf, 1, len, file);
+}
+
+static bool getVarint(const uint8_t* data, uint64_t size, uint64_t* pos, uint64_t* value)
+{
+	*value = 0;
+	for (uint32_t shift = 0; shift < 64 && *pos < size; shift += 7)
+	{
+		uint8_t byte = data[(*pos)++];
+		*value |= (uint64_t)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
+
+static inline uint64_t zigzag(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+
+// Handle of a recorded battery, the provider's own handle is swapped in around every call
+typedef struct RecordedBattery
+{
+	void* handle;
+	uint32_t id;
+} RecordedBattery;
+
+typedef struct TraceRecorder
+{
+	const BatteryProvider* provider;
+	FILE* file;
+
+	uint64_t start;
+	uint64_t lastRound;
+
+	// Path of every id so far
+	BatteryPath_array paths;
+
+	// Recorded handles of a batch read while the provider's are swapped in. Batches never have more
+	// batteries than there are paths, so enumerate and open grow it and polls do not allocate
+	RecordedBattery** batch;
+	uint64_t batchMax;
+} TraceRecorder;
+
+static TraceRecorder recorder = { 0 };
+
+static void startRound(uint8_t type)
+{
+	// Rounds already recorded survive the process being killed, one write per poll costs nothing
+	fflush(recorder.file);
+
+	uint64_t time = sft_toMILLISEC(sft_timer_now() - recorder.start);
+	fputc(type, recorder.file);
+	putVarint(recorder.file, time - recorder.lastRound);
+	recorder.lastRound = time;
+}
+
+static void startRecord(uint8_t type)
+{
+	fputc(type, recorder.file);
+}
+
+static uint32_t recordPath(const char* path)
+{
+	for (uint64_t i = 0; i < recorder.paths.length; i++)
+		if (strcmp(recorder.paths.data[i], path) == 0)
+			return (uint32_t)i;
+
+	uint32_t id = (uint32_t)recorder.paths.length;
+	uint64_t len = strlen(path);
+	if (len > TRACE_MAX_PATH || !pushBatteryPath(&recorder.paths, path))
+		return UINT32_MAX;
+
+	startRecord(TRACE_PATH);
+	putVarint(recorder.file, id);
+	putVarint(recorder.file, len);
+	fwrite(path, 1, len, recorder.file);
+	return id;
+}
+
+static void recordDynamic(const BatteryInfo* battery, uint32_t id)
+{
+	startRecord(TRACE_DYNAMIC);
+	putVarint(recorder.file, id);
+	putVarint(recorder.file, battery->tag);
+	putVarint(recorder.file, battery->charge);
+	putVarint(recorder.file, battery->isCharging);
+	putVarint(recorder.file, zigzag(battery->rate));
+	putVarint(recorder.file, battery->voltage);
+}
+
+static void recordStatic(const BatteryInfo* battery, uint32_t id)
+{
+	startRecord(TRACE_STATIC);
+	putVarint(recorder.file, id);
+	putVarint(recorder.file, battery->capacity);
+	putVarint(recorder.file, battery->wear);
+}
+
+static void reserveBatch(uint64_t count)
+{
+	if (count <= recorder.batchMax)
+		return;
+
+	uint64_t max = recorder.batchMax * 2 > count ? recorder.batchMax * 2 : count;
+	void* ptr = realloc(recorder.batch, max * sizeof(*recorder.batch));
+	if (!ptr)
+		return;
+	recorder.batch = ptr;
+	recorder.batchMax = max;
+}
+
+static RecordedBattery* swapIn(BatteryInfo* battery)
+{
+	RecordedBattery* recorded = battery->handle;
+	battery->handle = recorded->handle;
+	return recorded;
+}
+
+static void swapOut(BatteryInfo* battery, RecordedBattery* recorded)
+{
+	recorded->handle = battery->handle;
+	battery->handle = recorded;
+}
+
+bool startBatteryRecording(const BatteryProvider* provider, const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	memset(&recorder, 0, sizeof(recorder));
+	recorder.provider = provider;
+	recorder.file = file;
+	recorder.start = sft_timer_now();
+
+	fwrite(TRACE_MAGIC, 1, 4, file);
+	putVarint(file, TRACE_VERSION);
+	return true;
+}
+
+void stopBatteryRecording()
+{
+	if (recorder.file)
+		fclose(recorder.file);
+	freeBatteryPaths(&recorder.paths);
+	free(recorder.batch);
+	memset(&recorder, 0, sizeof(recorder));
+}
+
+static bool recordEnumerate(BatteryPath_array* paths)
+{
+	if (!recorder.provider->enumerate(paths))
+		return false;
+
+	startRound(TRACE_SCAN);
+	reserveBatch(paths->length);
+
+	// Every path needs its id before the list refers to it
+	uint64_t count = 0;
+	for (uint64_t i = 0; i < paths->length; i++)
+		count += recordPath(paths->data[i]) != UINT32_MAX;
+
+	startRecord(TRACE_ENUMERATE);
+	putVarint(recorder.file, count);
+	for (uint64_t i = 0; i < paths->length; i++)
+	{
+		uint32_t id = recordPath(paths->data[i]);
+		if (id != UINT32_MAX)
+			putVarint(recorder.file, id);
+	}
+	return true;
+}
+
+static bool recordOpen(BatteryInfo* battery, const char* path)
+{
+	RecordedBattery* recorded = malloc(sizeof(*recorded));
+	if (!recorded)
+		return false;
+
+	recorded->id = recordPath(path);
+	if (recorded->id == UINT32_MAX || !recorder.provider->open(battery, path))
+	{
+		free(recorded);
+		return false;
+	}
+	reserveBatch(recorder.paths.length);
+
+	swapOut(battery, recorded);
+	return true;
+}
+
+static void recordReadStatic(BatteryInfo* battery)
+{
+	RecordedBattery* recorded = swapIn(battery);
+	recorder.provider->readStatic(battery);
+	swapOut(battery, recorded);
+
+	recordStatic(battery, recorded->id);
+}
+
+static void recordReadDynamic(BatteryInfo* battery)
+{
+	RecordedBattery* recorded = swapIn(battery);
+	recorder.provider->readDynamic(battery);
+	swapOut(battery, recorded);
+
+	recordDynamic(battery, recorded->id);
+}
+
+static void recordReadDynamicBatch(BatteryInfo* batteries, uint64_t count)
+{
+	// The provider's handles are swapped in for the whole batch, a batch the scratch array could not grow for is read one by one
+	RecordedBattery** recorded = recorder.batch;
+	if (!recorder.provider->readDynamicBatch || count > recorder.batchMax)
+	{
+		startRound(TRACE_READ);
+		for (uint64_t i = 0; i < count; i++)
+			recordReadDynamic(&batteries[i]);
+		return;
+	}
+
+	for (uint64_t i = 0; i < count; i++)
+		recorded[i] = swapIn(&batteries[i]);
+	recorder.provider->readDynamicBatch(batteries, count);
+	startRound(TRACE_READ);
+
+	for (uint64_t i = 0; i < count; i++)
+	{
+		swapOut(&batteries[i], recorded[i]);
+		recordDynamic(&batteries[i], recorded[i]->id);
+	}
+}
+
+static void recordRelease(BatteryInfo* battery)
+{
+	RecordedBattery* recorded = swapIn(battery);
+	recorder.provider->release(battery);
+	free(recorded);
+}
+
+static void* recordArm(BatteryInfo* battery)
+{
+	if (!recorder.provider->arm)
+		return NULL;
+
+	RecordedBattery* recorded = swapIn(battery);
+	void* event = recorder.provider->arm(battery);
+	swapOut(battery, recorded);
+	return event;
+}
+
+static void recordDisarm(BatteryInfo* battery)
+{
+	RecordedBattery* recorded = swapIn(battery);
+	recorder.provider->disarm(battery);
+	swapOut(battery, recorded);
+}
+
+const BatteryProvider recordingBatteryProvider =
+{
+	.name = "recording",
+	.enumerate = recordEnumerate,
+	.open = recordOpen,
+	.readStatic = recordReadStatic,
+	.readDynamic = recordReadDynamic,
+	.release = recordRelease,
+	.arm = recordArm,
+	.disarm = recordDisarm,
+	.readDynamicBatch = recordReadDynamicBatch,
+};
+
+
+typedef struct ReplayBattery
+{
+	uint32_t tag;
+	uint32_t charge;
+	uint8_t isCharging;
+	int32_t rate;
+	uint32_t voltage;
+	uint32_t capacity;
+	uint32_t wear;
+	// Listed by the last enumeration
+	bool present;
+} ReplayBattery;
+
+typedef struct TraceReplay
+{
+	uint8_t* data;
+	uint64_t size;
+	// Next record, and the time of the last one read
+	uint64_t pos;
+	uint64_t time;
+	bool ended;
+
+	float speed;
+	uint64_t start;
+	uint64_t startTime;
+
+	// Both indexed by id
+	BatteryPath_array paths;
+	ReplayBattery* batteries;
+
+	// Ids of the last enumeration, in its order
+	uint32_t* present;
+	uint64_t presentCount;
+} TraceReplay;
+
+static TraceReplay replay = { 0 };
+
+static bool getFields(uint64_t* pos, uint64_t* values, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		if (!getVarint(replay.data, replay.size, pos, &values[i]))
+			return false;
+	return true;
+}
+
+// Decodes the record at pos without applying it, false at the end or a truncated tail
+static bool readRecord(uint64_t* pos, TraceRecord* record)
+{
+	if (*pos >= replay.size)
+		return false;
+
+	memset(record, 0, sizeof(*record));
+	record->type = replay.data[(*pos)++];
+	record->time = replay.time;
+
+	uint64_t values[6];
+	switch (record->type)
+	{
+	case TRACE_SCAN:
+	case TRACE_READ:
+		if (!getFields(pos, values, 1))
+			return false;
+		record->time += values[0];
+		return true;
+
+	case TRACE_PATH:
+		if (!getFields(pos, values, 2) || values[1] > TRACE_MAX_PATH || values[1] > replay.size - *pos)
+			return false;
+		record->id = (uint32_t)values[0];
+		record->list = replay.data + *pos;
+		record->listLength = values[1];
+		*pos += values[1];
+		return true;
+
+	case TRACE_ENUMERATE:
+		if (!getFields(pos, values, 1))
+			return false;
+		record->list = replay.data + *pos;
+		record->listLength = values[0];
+		for (uint64_t i = 0; i < record->listLength; i++)
+			if (!getFields(pos, values, 1))
+				return false;
+		return true;
+
+	case TRACE_DYNAMIC:
+		if (!getFields(pos, values, 6))
+			return false;
+		record->id = (uint32_t)values[0];
+		record->tag = (uint32_t)values[1];
+		record->charge = (uint32_t)values[2];
+		record->isCharging = (uint8_t)values[3];
+		record->rate = (int32_t)unzigzag(values[4]);
+		record->voltage = (uint32_t)values[5];
+		return true;
+
+	case TRACE_STATIC:
+		if (!getFields(pos, values, 3))
+			return false;
+		record->id = (uint32_t)values[0];
+		record->capacity = (uint32_t)values[1];
+		record->wear = (uint32_t)values[2];
+		return true;
+	}
+	return false;
+}
+
+static void applyPath(const TraceRecord* record)
+{
+	// Ids count up from 0, anything else is a broken trace
+	if (record->id != replay.paths.length)
+		return;
+
+	ReplayBattery* batteries = realloc(replay.batteries, (replay.paths.length + 1) * sizeof(*batteries));
+	if (!batteries)
+		return;
+	replay.batteries = batteries;
+	memset(&batteries[replay.paths.length], 0, sizeof(*batteries));
+
+	char path[TRACE_MAX_PATH + 1];
+	memcpy(path, record->list, record->listLength);
+	path[record->listLength] = '\0';
+	pushBatteryPath(&replay.paths, path);
+}
+
+static void applyEnumerate(const TraceRecord* record)
+{
+	uint32_t* present = realloc(replay.present, (record->listLength + 1) * sizeof(*present));
+	if (!present)
+		return;
+	replay.present = present;
+	replay.presentCount = 0;
+
+	for (uint64_t i = 0; i < replay.paths.length; i++)
+		replay.batteries[i].present = false;
+
+	uint64_t pos = record->list - replay.data;
+	for (uint64_t i = 0; i < record->listLength; i++)
+	{
+		uint64_t id;
+		getFields(&pos, &id, 1);
+		if (id >= replay.paths.length)
+			continue;
+
+		replay.batteries[id].present = true;
+		present[replay.presentCount++] = (uint32_t)id;
+	}
+}
+
+static void applyRecord(const TraceRecord* record)
+{
+	replay.time = record->time;
+
+	if (record->type == TRACE_SCAN || record->type == TRACE_READ)
+		return;
+	else if (record->type == TRACE_PATH)
+		applyPath(record);
+	else if (record->type == TRACE_ENUMERATE)
+		applyEnumerate(record);
+	else if (record->id < replay.paths.length)
+	{
+		ReplayBattery* battery = &replay.batteries[record->id];
+		if (record->type == TRACE_DYNAMIC)
+		{
+			battery->tag = record->tag;
+			battery->charge = record->charge;
+			battery->isCharging = record->isCharging;
+			battery->rate = record->rate;
+			battery->voltage = record->voltage;
+		}
+		else
+		{
+			battery->capacity = record->capacity;
+			battery->wear = record->wear;
+		}
+	}
+}
+
+// Applies every record up to limit
+static void replayUntil(uint64_t limit)
+{
+	for (;;)
+	{
+		uint64_t pos = replay.pos;
+		TraceRecord record;
+		if (!readRecord(&pos, &record))
+		{
+			replay.ended = true;
+			return;
+		}
+		if (record.time > limit)
+			return;
+
+		applyRecord(&record);
+		replay.pos = pos;
+	}
+}
+
+// Type of the next round, 0 at the end
+static uint8_t nextRound()
+{
+	uint64_t pos = replay.pos;
+	TraceRecord record;
+	return readRecord(&pos, &record) ? record.type : 0;
+}
+
+// Applies every round up to and including the next one of type
+static void stepReplay(uint8_t type)
+{
+	bool found = false;
+	for (;;)
+	{
+		uint64_t pos = replay.pos;
+		TraceRecord record;
+		if (!readRecord(&pos, &record))
+		{
+			replay.ended = true;
+			return;
+		}
+
+		bool round = record.type == TRACE_SCAN || record.type == TRACE_READ;
+		if (round && found)
+			return;
+		found |= record.type == type;
+
+		applyRecord(&record);
+		replay.pos = pos;
+	}
+}
+
+static void syncReplay()
+{
+	if (replay.speed > 0)
+		replayUntil(replay.startTime + (uint64_t)(sft_toMILLISEC(sft_timer_now() - replay.start) * replay.speed));
+}
+
+bool openBatteryReplay(const char* path, float speed)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return false;
+
+	memset(&replay, 0, sizeof(replay));
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	replay.data = size > 0 ? malloc(size) : NULL;
+	if (!replay.data || fread(replay.data, 1, size, file) != (size_t)size)
+	{
+		fclose(file);
+		free(replay.data);
+		replay.data = NULL;
+		return false;
+	}
+	fclose(file);
+	replay.size = size;
+
+	uint64_t version = 0;
+	replay.pos = 4;
+	if (replay.size < 4 || memcmp(replay.data, TRACE_MAGIC, 4) != 0 ||
+		!getFields(&replay.pos, &version, 1) || version != TRACE_VERSION)
+	{
+		closeBatteryReplay();
+		return false;
+	}
+
+	// The clock starts at the first round, stepped replays step from the first enumeration
+	replay.speed = speed;
+	if (speed > 0)
+		stepReplay(TRACE_SCAN);
+	replay.start = sft_timer_now();
+	replay.startTime = replay.time;
+	return true;
+}
+
+bool batteryReplayEnded()
+{
+	return replay.ended;
+}
+
+void closeBatteryReplay()
+{
+	free(replay.data);
+	free(replay.batteries);
+	free(replay.present);
+	freeBatteryPaths(&replay.paths);
+	memset(&replay, 0, sizeof(replay));
+}
+
+static bool replayEnumerate(BatteryPath_array* paths)
+{
+	// Stepped replays only move when the trace enumerated here too
+	if (replay.speed > 0)
+		syncReplay();
+	else if (nextRound() == TRACE_SCAN)
+		stepReplay(TRACE_SCAN);
+
+	for (uint64_t i = 0; i < replay.presentCount; i++)
+		pushBatteryPath(paths, replay.paths.data[replay.present[i]]);
+	return true;
+}
+
+static bool replayOpen(BatteryInfo* battery, const char* path)
+{
+	// The handle is the id plus one
+	for (uint64_t i = 0; i < replay.paths.length; i++)
+		if (strcmp(replay.paths.data[i], path) == 0)
+		{
+			battery->handle = (void*)(uintptr_t)(i + 1);
+			return true;
+		}
+	return false;
+}
+
+static const ReplayBattery* replayedBattery(const BatteryInfo* battery)
+{
+	return &replay.batteries[(uintptr_t)battery->handle - 1];
+}
+
+static void replayReadStatic(BatteryInfo* battery)
+{
+	const ReplayBattery* replayed = replayedBattery(battery);
+	battery->capacity = replayed->capacity;
+	battery->wear = replayed->wear;
+}
+
+static void copyDynamic(BatteryInfo* battery)
+{
+	const ReplayBattery* replayed = replayedBattery(battery);
+	if (!replayed->present)
+	{
+		battery->tag = 0;
+		battery->charge = 0;
+		battery->isCharging = false;
+		battery->rate = 0;
+		battery->voltage = 0;
+		return;
+	}
+
+	battery->tag = replayed->tag;
+	battery->charge = replayed->charge;
+	battery->isCharging = replayed->isCharging;
+	battery->rate = replayed->rate;
+	battery->voltage = replayed->voltage;
+}
+
+static void replayReadDynamic(BatteryInfo* battery)
+{
+	syncReplay();
+	copyDynamic(battery);
+}
+
+static void replayReadDynamicBatch(BatteryInfo* batteries, uint64_t count)
+{
+	// Stepped replays move to the next batch read of the trace, through enumerations nobody repeated
+	if (replay.speed > 0)
+		syncReplay();
+	else
+		stepReplay(TRACE_READ);
+
+	for (uint64_t i = 0; i < count; i++)
+		copyDynamic(&batteries[i]);
+}
+
+static void replayRelease(BatteryInfo* battery)
+{
+	memset(battery, 0, sizeof(*battery));
+}
+
+const BatteryProvider replayBatteryProvider =
+{
+	.name = "replay",
+	.enumerate = replayEnumerate,
+	.open = replayOpen,
+	.readStatic = replayReadStatic,
+	.readDynamic = replayReadDynamic,
+	.release = replayRelease,
+	// Reads are driven by the poll period, or by nothing when stepping
+	.arm = NULL,
+	.disarm = NULL,
+	.readDynamicBatch = replayReadDynamicBatch,
+};
\ No newline at end of file
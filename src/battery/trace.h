@@ -0,0 +1,63 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "battery.h"
+
+/*
+* A trace holds what a provider returned, not the raw IOCTL or sysfs results, so a
+* trace recorded with either backend replays on both. After the "BTRC" magic and a
+* version every record is a type byte and varint fields. Every enumeration and batch
+* read starts a round with the milliseconds since the previous one, the reads after
+* it belong to it. Replays move by rounds, by the clock or one batch read at a time
+*/
+
+/**
+* \brief Passes every call to the provider given to startBatteryRecording and writes what it returned
+*/
+extern const BatteryProvider recordingBatteryProvider;
+
+/**
+* \brief Reads batteries from the trace given to openBatteryReplay.
+Batteries that arrive mid trace are opened by the next rescan, ones that left read as removed
+*/
+extern const BatteryProvider replayBatteryProvider;
+
+/**
+* \brief Starts writing a trace of provider, open batteries with recordingBatteryProvider afterwards
+* \param provider The backend the recording provider passes calls to
+* \param path The trace file to create
+* \warning Must be stopped with stopBatteryRecording, batteries are only recorded from one thread
+*/
+bool startBatteryRecording(const BatteryProvider* provider, const char* path);
+
+/**
+* \brief Flushes and closes the trace, release the recorded batteries first
+*/
+void stopBatteryRecording();
+
+/**
+* \brief Loads a trace for replayBatteryProvider
+* \param path The trace file to load
+* \param speed Trace time passed per real time, 0 to move one recorded batch read per batch read, as fast as it is polled
+* \warning Must be closed with closeBatteryReplay
+*/
+bool openBatteryReplay(const char* path, float speed);
+
+/**
+* \brief Returns true once the last round of the trace was read
+*/
+bool batteryReplayEnded();
+
+/**
+* \brief Frees the trace, release the replayed batteries first
+*/
+void closeBatteryReplay();
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,509 @@
+#include "battery.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <ioapiset.h>
+#include <winioctl.h>
+#include <Poclass.h>
+#include <setupapi.h>
+#include <Devguid.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Charge change that wakes a battery status wait as a fraction of capacity, a hundredth of a percent
+// is the finest step the widget shows, smaller changes would wake it for nothing
+#define BATTERY_WAIT_RESOLUTION 10000
+// Longest a battery status wait is left pending before re-reading anyway
+#define BATTERY_WAIT_TIMEOUT 300000
+
+typedef struct BatteryWait
+{
+	// Separate overlapped handle, so synchronous queries never race the wait
+	HANDLE handle;
+	OVERLAPPED overlapped;
+	BATTERY_WAIT_STATUS request;
+	BATTERY_STATUS status;
+	bool pending;
+	// Set when the driver rejects the wait, the battery is polled until its tag changes
+	bool failed;
+} BatteryWait;
+
+typedef struct BatteryQuery
+{
+	OVERLAPPED overlapped;
+	bool ok;
+	// A completion is still to be dequeued for it
+	bool pending;
+} BatteryQuery;
+
+typedef struct Win32Battery
+{
+	HANDLE handle;
+	BatteryWait* wait;
+	uint32_t powerState;
+
+	// Overlapped handle on the shared completion port, INVALID_HANDLE_VALUE if the battery is read serially
+	HANDLE query;
+	BatteryQuery tagQuery;
+	uint32_t tagWait;
+	uint32_t queriedTag;
+	BatteryQuery statusQuery;
+	BATTERY_WAIT_STATUS statusRequest;
+	BATTERY_STATUS queriedStatus;
+} Win32Battery;
+
+// Shared by every battery and kept for the life of the process, batteries are only read from one thread
+static HANDLE queryPort = NULL;
+// Set when dequeuing from the port failed, batches are read serially from then on
+static bool queryPortFailed = false;
+
+
+static void winErr(const char* label)
+{
+	DWORD err = GetLastError();
+	if (err)
+	{
+		char* buf = NULL;
+		FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM,
+			NULL, err, 0, &buf, 0, NULL);
+
+		printf("\"%s\" ERROR:(%u) %s\n", label, err, buf);
+
+		LocalFree(buf);
+	}
+}
+
+static HANDLE openDevice(const char* name, uint32_t flags)
+{
+	return CreateFileA(name,
+		GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE,
+		NULL, OPEN_EXISTING, flags, NULL);
+}
+
+
+static uint32_t getBatteryTag(HANDLE hDev)
+{
+	uint32_t wait = 0;
+	uint32_t tag = 0;
+	uint32_t numBytes = 0;
+
+	batteryQueries++;
+	DeviceIoControl(hDev, IOCTL_BATTERY_QUERY_TAG,
+		&wait, sizeof(wait),
+		&tag, sizeof(tag),
+		&numBytes, NULL);
+
+	return tag;
+}
+
+static BATTERY_INFORMATION getBatteryInfo(HANDLE hDev, uint32_t tag)
+{
+
+	BATTERY_QUERY_INFORMATION batteryQInfo = { 0 };
+	batteryQInfo.InformationLevel = BatteryInformation;
+	batteryQInfo.BatteryTag = tag;
+
+	BATTERY_INFORMATION batteryInfo = { 0 };
+
+	uint32_t numBytes = 0;
+	batteryQueries++;
+	BOOL foundDev = DeviceIoControl(hDev, IOCTL_BATTERY_QUERY_INFORMATION,
+		&batteryQInfo, sizeof(batteryQInfo),
+		&batteryInfo, sizeof(batteryInfo),
+		&numBytes, NULL);
+
+	return batteryInfo;
+}
+
+static BATTERY_STATUS getBatteryStatus(HANDLE hDev, uint32_t tag)
+{
+	BATTERY_WAIT_STATUS wait = { 0 };
+	wait.BatteryTag = tag;
+
+	BATTERY_STATUS batteryStatus = { 0 };
+
+	uint32_t numBytes = 0;
+	batteryQueries++;
+	BOOL foundDev = DeviceIoControl(hDev, IOCTL_BATTERY_QUERY_STATUS,
+		&wait, sizeof(wait),
+		&batteryStatus, sizeof(batteryStatus),
+		&numBytes, NULL);
+
+	return batteryStatus;
+}
+
+
+static BatteryWait* openBatteryWait(const char* name)
+{
+	BatteryWait* wait = malloc(sizeof(*wait));
+	if (!wait)
+		return NULL;
+
+	memset(wait, 0, sizeof(*wait));
+	wait->handle = openDevice(name, FILE_FLAG_OVERLAPPED);
+	wait->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+	if (wait->handle == INVALID_HANDLE_VALUE || !wait->overlapped.hEvent)
+	{
+		winErr("Battery wait");
+		if (wait->handle != INVALID_HANDLE_VALUE)
+			CloseHandle(wait->handle);
+		if (wait->overlapped.hEvent)
+			CloseHandle(wait->overlapped.hEvent);
+		free(wait);
+		wait = NULL;
+	}
+
+	return wait;
+}
+
+static void closeBatteryWait(BatteryWait* wait)
+{
+	if (!wait)
+		return;
+
+	if (wait->pending)
+	{
+		uint32_t numBytes = 0;
+		CancelIoEx(wait->handle, &wait->overlapped);
+		GetOverlappedResult(wait->handle, &wait->overlapped,
+			&numBytes, TRUE);
+	}
+	CloseHandle(wait->overlapped.hEvent);
+	CloseHandle(wait->handle);
+	free(wait);
+}
+
+// Completions carry the battery as their key
+static HANDLE openQueryHandle(const char* name, Win32Battery* dev)
+{
+	if (!queryPort)
+		queryPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	if (!queryPort)
+		return INVALID_HANDLE_VALUE;
+
+	HANDLE handle = openDevice(name, FILE_FLAG_OVERLAPPED);
+	if (handle != INVALID_HANDLE_VALUE && !CreateIoCompletionPort(handle, queryPort, (ULONG_PTR)dev, 0))
+	{
+		winErr("Battery query");
+		CloseHandle(handle);
+		handle = INVALID_HANDLE_VALUE;
+	}
+	return handle;
+}
+
+static bool win32Open(BatteryInfo* battery, const char* path)
+{
+	Win32Battery* dev = malloc(sizeof(*dev));
+	if (!dev)
+		return false;
+
+	memset(dev, 0, sizeof(*dev));
+	dev->handle = openDevice(path, 0);
+	if (dev->handle == INVALID_HANDLE_VALUE)
+	{
+		winErr("Battery open");
+		free(dev);
+		return false;
+	}
+	dev->wait = openBatteryWait(path);
+	dev->query = openQueryHandle(path, dev);
+
+	battery->handle = dev;
+	return true;
+}
+
+
+static bool win32Enumerate(BatteryPath_array* paths)
+{
+	HDEVINFO devInfo = SetupDiGetClassDevsA(&GUID_DEVCLASS_BATTERY,
+		NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+	if (devInfo == INVALID_HANDLE_VALUE)
+		return false;
+
+	for (uint32_t i = 0; ; i++)
+	{
+		SP_DEVICE_INTERFACE_DATA did = { 0 };
+		did.cbSize = sizeof(did);
+
+		if (!SetupDiEnumDeviceInterfaces(devInfo, NULL,
+			&GUID_DEVCLASS_BATTERY, i, &did))
+			break;
+
+		uint32_t devInfoSize = 0;
+		SetupDiGetDeviceInterfaceDetailA(devInfo, &did, NULL, NULL,
+			&devInfoSize, NULL);
+
+		SP_INTERFACE_DEVICE_DETAIL_DATA_A* iddd = malloc(devInfoSize);
+		if (iddd)
+		{
+			iddd->cbSize = sizeof(*iddd);
+			if (SetupDiGetDeviceInterfaceDetailA(devInfo, &did, iddd,
+				devInfoSize, &devInfoSize, NULL))
+				pushBatteryPath(paths, iddd->DevicePath);
+
+			free(iddd);
+		}
+	}
+
+	SetupDiDestroyDeviceInfoList(devInfo);
+
+	return true;
+}
+
+static void win32ReadStatic(BatteryInfo* battery)
+{
+	Win32Battery* dev = battery->handle;
+
+	BATTERY_INFORMATION batteryInfo = getBatteryInfo(dev->handle, battery->tag);
+	battery->capacity = batteryInfo.FullChargedCapacity;
+
+	// New packs can hold more than designed, that is no wear
+	battery->wear = batteryInfo.DesignedCapacity > battery->capacity ? batteryInfo.DesignedCapacity - battery->capacity : 0;
+}
+
+static void setTag(BatteryInfo* battery, Win32Battery* dev, uint32_t tag)
+{
+	if (battery->tag != tag && dev->wait)
+		dev->wait->failed = false;
+	battery->tag = tag;
+}
+
+static void setStatus(BatteryInfo* battery, Win32Battery* dev, const BATTERY_STATUS* batteryStatus)
+{
+	battery->charge = batteryStatus->Capacity;
+	battery->isCharging = (batteryStatus->PowerState & BATTERY_POWER_ON_LINE) != 0;
+	// Already signed, negative while discharging
+	battery->rate = batteryStatus->Rate != (LONG)BATTERY_UNKNOWN_RATE ? batteryStatus->Rate : 0;
+	battery->voltage = batteryStatus->Voltage != BATTERY_UNKNOWN_VOLTAGE ? batteryStatus->Voltage : 0;
+	dev->powerState = batteryStatus->PowerState;
+}
+
+static void win32ReadDynamic(BatteryInfo* battery)
+{
+	Win32Battery* dev = battery->handle;
+
+	setTag(battery, dev, getBatteryTag(dev->handle));
+
+	BATTERY_STATUS batteryStatus = getBatteryStatus(dev->handle, battery->tag);
+	setStatus(battery, dev, &batteryStatus);
+}
+
+
+// Returns true if a completion will be queued for the query
+static bool issueQuery(Win32Battery* dev, BatteryQuery* query, uint32_t code,
+	void* in, uint32_t inSize, void* out, uint32_t outSize)
+{
+	memset(&query->overlapped, 0, sizeof(query->overlapped));
+	query->ok = false;
+
+	batteryQueries++;
+	query->pending = DeviceIoControl(dev->query, code, in, inSize, out, outSize,
+		NULL, &query->overlapped) || GetLastError() == ERROR_IO_PENDING;
+	return query->pending;
+}
+
+// The driver writes a query's output until it completes, so every query still in flight is cancelled
+// and waited for before the buffers and overlappeds can be reused or freed
+static void cancelQuery(Win32Battery* dev, BatteryQuery* query)
+{
+	if (!query->pending)
+		return;
+
+	CancelIoEx(dev->query, &query->overlapped);
+	// Waiting on the handle would return for any of its queries, the overlapped itself is polled
+	while (!HasOverlappedIoCompleted(&query->overlapped))
+		Sleep(1);
+	query->ok = false;
+	query->pending = false;
+}
+
+static bool issueStatus(Win32Battery* dev, uint32_t tag)
+{
+	memset(&dev->statusRequest, 0, sizeof(dev->statusRequest));
+	memset(&dev->queriedStatus, 0, sizeof(dev->queriedStatus));
+	dev->statusRequest.BatteryTag = tag;
+
+	return issueQuery(dev, &dev->statusQuery, IOCTL_BATTERY_QUERY_STATUS,
+		&dev->statusRequest, sizeof(dev->statusRequest),
+		&dev->queriedStatus, sizeof(dev->queriedStatus));
+}
+
+// Returns false if the port failed, the queries still in flight are cancelled first
+static bool drainQueries(BatteryInfo* batteries, uint64_t count, uint32_t pending)
+{
+	OVERLAPPED_ENTRY entries[64];
+	while (pending)
+	{
+		ULONG dequeued = 0;
+		if (!GetQueuedCompletionStatusEx(queryPort, entries, 64, &dequeued, INFINITE, FALSE))
+		{
+			winErr("Battery queries");
+			for (uint64_t i = 0; i < count; i++)
+			{
+				Win32Battery* dev = batteries[i].handle;
+				if (dev->query == INVALID_HANDLE_VALUE)
+					continue;
+				cancelQuery(dev, &dev->tagQuery);
+				cancelQuery(dev, &dev->statusQuery);
+			}
+			queryPortFailed = true;
+			return false;
+		}
+
+		for (ULONG i = 0; i < dequeued; i++)
+		{
+			Win32Battery* dev = (Win32Battery*)entries[i].lpCompletionKey;
+			BatteryQuery* query = (BatteryQuery*)entries[i].lpOverlapped;
+
+			uint32_t numBytes = 0;
+			query->ok = GetOverlappedResult(dev->query, &query->overlapped, &numBytes, FALSE);
+			query->pending = false;
+		}
+		pending -= dequeued < pending ? dequeued : pending;
+	}
+	return true;
+}
+
+static void readDynamicSerially(BatteryInfo* batteries, uint64_t count)
+{
+	for (uint64_t i = 0; i < count; i++)
+		win32ReadDynamic(&batteries[i]);
+}
+
+static void win32ReadDynamicBatch(BatteryInfo* batteries, uint64_t count)
+{
+	if (queryPortFailed)
+	{
+		readDynamicSerially(batteries, count);
+		return;
+	}
+
+	// The status goes out with the last tag next to the tag query, only batteries whose tag changed need a second round
+	uint32_t pending = 0;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		Win32Battery* dev = batteries[i].handle;
+		if (dev->query == INVALID_HANDLE_VALUE)
+			continue;
+
+		dev->tagWait = 0;
+		dev->queriedTag = 0;
+		pending += issueQuery(dev, &dev->tagQuery, IOCTL_BATTERY_QUERY_TAG,
+			&dev->tagWait, sizeof(dev->tagWait), &dev->queriedTag, sizeof(dev->queriedTag));
+		pending += issueStatus(dev, batteries[i].tag);
+	}
+	if (!drainQueries(batteries, count, pending))
+	{
+		readDynamicSerially(batteries, count);
+		return;
+	}
+
+	pending = 0;
+	for (uint64_t i = 0; i < count; i++)
+	{
+		Win32Battery* dev = batteries[i].handle;
+		if (dev->query != INVALID_HANDLE_VALUE && dev->tagQuery.ok && dev->queriedTag != batteries[i].tag)
+			pending += issueStatus(dev, dev->queriedTag);
+	}
+	if (!drainQueries(batteries, count, pending))
+	{
+		readDynamicSerially(batteries, count);
+		return;
+	}
+
+	for (uint64_t i = 0; i < count; i++)
+	{
+		BatteryInfo* battery = &batteries[i];
+		Win32Battery* dev = battery->handle;
+		if (dev->query == INVALID_HANDLE_VALUE)
+		{
+			win32ReadDynamic(battery);
+			continue;
+		}
+
+		// Failed queries read as zero like the synchronous ones, so does a status asked with a stale tag
+		setTag(battery, dev, dev->tagQuery.ok ? dev->queriedTag : 0);
+		if (!dev->statusQuery.ok || dev->statusRequest.BatteryTag != battery->tag)
+			memset(&dev->queriedStatus, 0, sizeof(dev->queriedStatus));
+		setStatus(battery, dev, &dev->queriedStatus);
+	}
+}
+
+static void win32Release(BatteryInfo* battery)
+{
+	Win32Battery* dev = battery->handle;
+	if (dev)
+	{
+		closeBatteryWait(dev->wait);
+		if (dev->query != INVALID_HANDLE_VALUE)
+			CloseHandle(dev->query);
+		CloseHandle(dev->handle);
+		free(dev);
+	}
+	memset(battery, 0, sizeof(*battery));
+}
+
+static void* win32Arm(BatteryInfo* battery)
+{
+	Win32Battery* dev = battery->handle;
+	BatteryWait* wait = dev->wait;
+	if (!wait || wait->failed || !battery->tag)
+		return NULL;
+
+	if (wait->pending)
+		return wait->overlapped.hEvent;
+
+	// Completes once the power state differs or the charge leaves the window
+	wait->request.BatteryTag = battery->tag;
+	wait->request.Timeout = BATTERY_WAIT_TIMEOUT;
+	wait->request.PowerState = dev->powerState;
+	uint32_t threshold = battery->capacity >= BATTERY_WAIT_RESOLUTION ? battery->capacity / BATTERY_WAIT_RESOLUTION : 1;
+	wait->request.LowCapacity = battery->charge >= threshold ? battery->charge - threshold + 1 : 0;
+	wait->request.HighCapacity = battery->charge + threshold - 1;
+
+	batteryQueries++;
+	if (DeviceIoControl(wait->handle, IOCTL_BATTERY_QUERY_STATUS,
+		&wait->request, sizeof(wait->request),
+		&wait->status, sizeof(wait->status),
+		NULL, &wait->overlapped) || GetLastError() == ERROR_IO_PENDING)
+	{
+		wait->pending = true;
+		return wait->overlapped.hEvent;
+	}
+	return NULL;
+}
+
+static void win32Disarm(BatteryInfo* battery)
+{
+	Win32Battery* dev = battery->handle;
+	BatteryWait* wait = dev->wait;
+	if (!wait || !wait->pending)
+		return;
+
+	uint32_t numBytes = 0;
+	if (!GetOverlappedResult(wait->handle, &wait->overlapped, &numBytes, FALSE))
+	{
+		DWORD err = GetLastError();
+		wait->failed = err != ERROR_TIMEOUT && err != ERROR_SEM_TIMEOUT;
+	}
+	wait->pending = false;
+}
+
+const BatteryProvider win32BatteryProvider =
+{
+	.name = "win32",
+	.enumerate = win32Enumerate,
+	.open = win32Open,
+	.readStatic = win32ReadStatic,
+	.readDynamic = win32ReadDynamic,
+	.release = win32Release,
+	.arm = win32Arm,
+	.disarm = win32Disarm,
+	.readDynamicBatch = win32ReadDynamicBatch,
+};
\ No newline at end of file
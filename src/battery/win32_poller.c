@@ -0,0 +1,93 @@
+#include "poller.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <process.h>
+
+bool _openPoller(BatteryPoller* poller)
+{
+	// Auto reset, a wait consumes the signal
+	HANDLE wake = CreateEventA(NULL, FALSE, FALSE, NULL);
+	HANDLE control = CreateEventA(NULL, FALSE, FALSE, NULL);
+	if (!wake || !control)
+	{
+		if (wake)
+			CloseHandle(wake);
+		if (control)
+			CloseHandle(control);
+		return false;
+	}
+
+	poller->_wake = poller->_wakeSignal = (intptr_t)wake;
+	poller->_control = poller->_controlSignal = (intptr_t)control;
+	return true;
+}
+
+void _closePoller(BatteryPoller* poller)
+{
+	CloseHandle((HANDLE)poller->_wake);
+	CloseHandle((HANDLE)poller->_control);
+}
+
+static unsigned __stdcall pollerThread(void* arg)
+{
+	_runPoller(arg);
+	return 0;
+}
+
+bool _startPollerThread(BatteryPoller* poller)
+{
+	// The thread uses the CRT, so it is started through it
+	uintptr_t thread = _beginthreadex(NULL, 0, pollerThread, poller, 0, NULL);
+	if (!thread)
+		return false;
+
+	poller->_thread = (intptr_t)thread;
+	return true;
+}
+
+void _joinPollerThread(BatteryPoller* poller)
+{
+	WaitForSingleObject((HANDLE)poller->_thread, INFINITE);
+	CloseHandle((HANDLE)poller->_thread);
+	poller->_thread = 0;
+}
+
+void _wakePollerReader(BatteryPoller* poller)
+{
+	SetEvent((HANDLE)poller->_wakeSignal);
+}
+
+void _drainPollerReader(BatteryPoller* poller)
+{
+	// Woken by a message instead, the signal would only wake the reader again for nothing
+	ResetEvent((HANDLE)poller->_wake);
+}
+
+void _wakePollerThread(BatteryPoller* poller)
+{
+	SetEvent((HANDLE)poller->_controlSignal);
+}
+
+int32_t _waitPoller(BatteryPoller* poller, void* const* events, uint32_t count, uint32_t ms)
+{
+	// The requests event goes last
+	HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+	if (count > MAXIMUM_WAIT_OBJECTS - 1)
+		count = MAXIMUM_WAIT_OBJECTS - 1;
+
+	for (uint32_t i = 0; i < count; i++)
+		handles[i] = events[i];
+	handles[count] = (HANDLE)poller->_control;
+
+	DWORD result = WaitForMultipleObjects(count + 1, handles, FALSE, ms);
+	if (result < WAIT_OBJECT_0 + count)
+		return result - WAIT_OBJECT_0;
+	return -1;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "bench.h"
+#include "../battery/battery.h"
+#include "../softdraw/util.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Written next to the widget and removed again
+#define BATCH_BENCH_DIR "BatteryInfo.bench.sysfs"
+// About as many battery reads are timed at every device count
+#define BATCH_BENCH_READS 20000
+#define BATCH_BENCH_MIN_POLLS 10
+#define BATCH_BENCH_CHARGE 20000
+
+static const uint32_t deviceCounts[] = { 1, 10, 100, 1000 };
+
+// Battery k of the tree holds charge + k, draws 5000 + k mW at 11000 + k mV, returns the batteries read wrong
+static uint64_t checkReadings(const BatteryInfo_array* batteries, uint32_t count, uint32_t charge)
+{
+	uint64_t wrong = batteries->length != count;
+	for (uint64_t i = 0; i < batteries->length; i++)
+	{
+		const BatteryInfo* battery = &batteries->data[i];
+		const char* name = strrchr(battery->path, '/');
+		uint32_t k = name && strncmp(name, "/BAT", 4) == 0 ? (uint32_t)strtoul(name + 4, NULL, 10) : UINT32_MAX;
+
+		wrong += k >= count || !battery->tag || battery->charge != charge + k || battery->rate != -(int32_t)(5000 + k) ||
+			battery->voltage != 11000 + k || battery->isCharging || battery->capacity != 50000 || battery->wear != 2000;
+	}
+	return wrong;
+}
+
+// Microseconds a poll of every battery takes, batched or one battery after the other
+static double timePolls(const BatteryProvider* provider, BatteryInfo_array* batteries, uint32_t polls, bool batch,
+	uint64_t* queries)
+{
+	uint64_t before = batteryQueries;
+	uint64_t start = sft_timer_now();
+	for (uint32_t p = 0; p < polls; p++)
+	{
+		if (batch)
+			provider->readDynamicBatch(batteries->data, batteries->length);
+		else
+			for (uint64_t i = 0; i < batteries->length; i++)
+				provider->readDynamic(&batteries->data[i]);
+	}
+	double us = (sft_timer_now() - start) / 1000.0 / polls;
+	*queries = (batteryQueries - before) / polls;
+	return us;
+}
+
+// Reads every battery of a fresh tree, after a rewrite with the batch and after another one by one
+static bool runDevices(uint32_t count, bool* skipped)
+{
+	const BatteryProvider* provider = _writeBenchBatteries(BATCH_BENCH_DIR, count, BATCH_BENCH_CHARGE);
+	if (!provider)
+	{
+		// Nothing at all is only fine where the backend can not read a fake tree
+		*skipped = count == deviceCounts[0];
+		if (!*skipped)
+			printf("  Could not write %u fake batteries to %s\n", count, BATCH_BENCH_DIR);
+		return *skipped;
+	}
+
+	BatteryInfo_array batteries = getBatteries(provider);
+	uint64_t wrong = checkReadings(&batteries, count, BATCH_BENCH_CHARGE);
+
+	bool written = _writeBenchBatteries(BATCH_BENCH_DIR, count, BATCH_BENCH_CHARGE + 1000) != NULL;
+	provider->readDynamicBatch(batteries.data, batteries.length);
+	wrong += checkReadings(&batteries, count, BATCH_BENCH_CHARGE + 1000);
+
+	written &= _writeBenchBatteries(BATCH_BENCH_DIR, count, BATCH_BENCH_CHARGE + 2000) != NULL;
+	for (uint64_t i = 0; i < batteries.length; i++)
+		provider->readDynamic(&batteries.data[i]);
+	wrong += checkReadings(&batteries, count, BATCH_BENCH_CHARGE + 2000);
+
+	uint32_t polls = sft_max(BATCH_BENCH_READS / count, BATCH_BENCH_MIN_POLLS);
+	uint64_t queries = 0;
+	double serialUs = timePolls(provider, &batteries, polls, false, &queries);
+	double batchUs = timePolls(provider, &batteries, polls, true, &queries);
+
+	printf("  %4u devices, %5llu reads a poll: batched %9.1f us, one by one %9.1f us, %5.2fx, %llu read wrong\n", count,
+		(unsigned long long)queries, batchUs, serialUs, batchUs ? serialUs / batchUs : 0, (unsigned long long)wrong);
+
+	releaseBatteries(&batteries);
+	return written && !wrong;
+}
+
+bool benchBatch()
+{
+	bool passed = true;
+	bool skipped = false;
+	uint32_t counts = sizeof(deviceCounts) / sizeof(deviceCounts[0]);
+	for (uint32_t c = 0; c < counts && passed && !skipped; c++)
+		passed &= runDevices(deviceCounts[c], &skipped);
+
+	if (skipped)
+		printf("  The battery backend here can not be pointed at fake devices, nothing measured\n");
+	_removeBenchBatteries(BATCH_BENCH_DIR, deviceCounts[counts - 1]);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const Bench benches[] =
+{
+	{ "image", "SIMD image kernels against the scalar ones, and their throughput", benchImage },
+	{ "history", "Appending a month of samples to the history ring and scanning it back", benchHistory },
+	{ "glyph", "Cached glyph draws against the per-pixel path at sizes 1 to 8, and the cache hit rate", benchGlyph },
+	{ "text", "The widget text formatters against printf, their speed and heap use", benchText },
+	{ "label", "Label updates against fresh renders, and a one digit redraw against a full one", benchLabel },
+	{ "ui", "Grid hit tests and dispatch over 4000 widgets against a linear scan", benchUi },
+	{ "timer", "sft_timer_mulDiv against a 128 bit reference over years of uptime, and its cost", benchTimer },
+	{ "poller", "UI frames while two batteries take 40 ms a read, inline and on the poller thread", benchPoller },
+	{ "batch", "readDynamicBatch against one read at a time over 1 to 1000 fake sysfs batteries", benchBatch },
+	{ "store", "Battery totals from the store arrays against a loop over 100k BatteryInfo", benchStore },
+	{ "replay", "Recording a synthetic 8 h day, replaying it stepped and against the clock", benchReplay },
+	{ "daemon", "1000 daemon clients, 20 of them never reading, following 1000 updates", benchDaemon },
+	{ "export", "Readers copying the shared battery state while the writer updates it", benchExport },
+};
+
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+int runBenches(const char* name)
+{
+	bool found = false;
+	bool passed = true;
+
+	for (uint32_t i = 0; i < BENCH_COUNT; i++)
+	{
+		if (name && strcmp(name, benches[i].name) != 0)
+			continue;
+		found = true;
+
+		printf("%s: %s\n", benches[i].name, benches[i].about);
+		fflush(stdout);
+		bool ok = benches[i].run();
+		printf("%s: %s\n\n", benches[i].name, ok ? "ok" : "FAILED");
+		passed &= ok;
+	}
+
+	if (!found)
+	{
+		fprintf(stderr, "No bench called %s, there are:\n", name);
+		for (uint32_t i = 0; i < BENCH_COUNT; i++)
+			fprintf(stderr, "  %-8s %s\n", benches[i].name, benches[i].about);
+		return 1;
+	}
+
+	return passed ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+* Benchmarks and self checks run with --bench [name] instead of the widget. Each one
+* prints what it measured and returns false when a check failed, so the exit code
+* tells a script whether the tree still behaves. Nothing here runs unless asked for
+*/
+
+typedef struct Bench
+{
+	const char* name;
+	/**
+	* \brief One line on what the bench measures and checks
+	*/
+	const char* about;
+	bool (*run)();
+} Bench;
+
+/**
+* \brief Runs the bench called name, or every bench
+* \param name A bench name, NULL for all of them
+* \return The process exit code, 1 if a check failed or no bench is called name
+*/
+int runBenches(const char* name);
+
+/**
+* \brief Next number of a xorshift64 sequence, the same on every platform so a failing seed replays
+* \param state The sequence, any nonzero seed to start
+*/
+static inline uint64_t benchRandom(uint64_t* state)
+{
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return *state = x;
+}
+
+/**
+* \brief Benches, in the order --bench runs them
+*/
+bool benchImage();
+bool benchHistory();
+bool benchGlyph();
+bool benchText();
+bool benchLabel();
+bool benchUi();
+bool benchTimer();
+bool benchPoller();
+bool benchBatch();
+bool benchStore();
+bool benchReplay();
+bool benchDaemon();
+bool benchExport();
+
+/**
+* \brief Internal functions that are OS specific, clients of the daemon bench on a Unix domain socket or a pipe
+*/
+/**
+* \brief Raises the descriptor limit as far as allowed, returns how many of wanted clients fit under it
+*/
+uint32_t _benchClientLimit(uint32_t wanted);
+/**
+* \brief Connects without blocking, a slow client gets a small receive buffer where the OS allows
+* \return The client, -1 if the daemon has no free instance yet or refused it
+*/
+intptr_t _connectBenchClient(const char* path, bool slow);
+/**
+* \brief Reads what already arrived without waiting
+* \return Bytes read, 0 if nothing is waiting, -1 once the daemon hung up
+*/
+int64_t _readBenchClient(intptr_t client, uint8_t* buf, uint64_t size);
+void _closeBenchClient(intptr_t client);
+
+/**
+* \brief Internal functions that are OS specific, threads and the segment of the export bench
+*/
+/**
+* \brief Runs run(user) on a new thread
+* \return The thread, 0 if it could not be started
+*/
+intptr_t _startBenchThread(void (*run)(void* user), void* user);
+void _joinBenchThread(intptr_t thread);
+/**
+* \brief Deletes a shared memory segment once its last mapping is gone, where names outlive them
+*/
+void _removeBenchExport(const char* name);
+
+struct BatteryProvider;
+
+/**
+* \brief Internal functions that are OS specific, fake batteries of the batch bench
+*/
+/**
+* \brief Writes count fake batteries under dir, or rewrites their charge, and points the backend at them
+* \param charge mWh the battery numbered 0 holds, battery k holds charge + k
+* \return The provider reading them, NULL where the backend can not be pointed at fake batteries
+*/
+const struct BatteryProvider* _writeBenchBatteries(const char* dir, uint32_t count, uint32_t charge);
+/**
+* \brief Deletes the fake batteries and points the backend back at the real ones
+*/
+void _removeBenchBatteries(const char* dir, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "bench.h"
+#include "../daemon/daemon.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Its own path, a daemon already running is left alone
+#ifdef _WIN32
+#define DAEMON_BENCH_PATH "\\\\.\\pipe\\BatteryInfo.bench"
+#else
+#define DAEMON_BENCH_PATH "BatteryInfo.bench.sock"
+#endif
+
+#define DAEMON_BENCH_CLIENTS 1000
+// Clients that never read, their frames have to coalesce instead of piling up
+#define DAEMON_BENCH_SLOW 20
+#define DAEMON_BENCH_UPDATES 1000
+// Longest a step may take before the bench gives up on it
+#define DAEMON_BENCH_TIMEOUT_MS 2000
+
+typedef struct BenchClient
+{
+	intptr_t handle;
+	uint8_t buf[2 * DAEMON_FRAME_MAX];
+	uint64_t length;
+	uint64_t seq;
+	bool failed;
+} BenchClient;
+
+typedef struct DaemonLatencies
+{
+	uint64_t* ns;
+	uint64_t count;
+	uint64_t max;
+} DaemonLatencies;
+
+static int compareNs(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+// Reads and parses every frame waiting for the client, updates add their fan-out latency
+static void drainClient(BenchClient* client, DaemonLatencies* latencies)
+{
+	for (;;)
+	{
+		int64_t got = _readBenchClient(client->handle, client->buf + client->length, sizeof(client->buf) - client->length);
+		if (got < 0)
+			client->failed = true;
+		if (got <= 0)
+			return;
+		client->length += got;
+
+		DaemonFrameHeader header;
+		int64_t used;
+		while ((used = parseDaemonFrame(client->buf, client->length, &header, NULL)) > 0)
+		{
+			if (header.type == DaemonFrame_update && latencies->count < latencies->max)
+				latencies->ns[latencies->count++] = sft_timer_now() - header.publishNs;
+			client->seq = header.seq;
+
+			memmove(client->buf, client->buf + used, client->length - used);
+			client->length -= used;
+		}
+		if (used < 0)
+		{
+			client->failed = true;
+			return;
+		}
+	}
+}
+
+// Services the daemon and drains the clients that read until all of them got seq
+static bool catchUp(Daemon* daemon, BenchClient* clients, uint32_t count, uint64_t seq, DaemonLatencies* latencies)
+{
+	uint64_t deadline = sft_timer_now() + sft_toNANOSEC(DAEMON_BENCH_TIMEOUT_MS);
+	for (;;)
+	{
+		serviceDaemon(daemon, 0);
+
+		bool behind = false;
+		for (uint32_t i = DAEMON_BENCH_SLOW; i < count; i++)
+		{
+			drainClient(&clients[i], latencies);
+			if (clients[i].failed)
+				return false;
+			behind |= clients[i].seq != seq;
+		}
+
+		if (!behind)
+			return true;
+		if (sft_timer_now() > deadline)
+			return false;
+	}
+}
+
+// Returns how many clients connected, all of them have to be accepted before the bench goes on
+static uint32_t connectClients(Daemon* daemon, BenchClient* clients, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint64_t deadline = sft_timer_now() + sft_toNANOSEC(DAEMON_BENCH_TIMEOUT_MS);
+		while ((clients[i].handle = _connectBenchClient(DAEMON_BENCH_PATH, i < DAEMON_BENCH_SLOW)) < 0)
+		{
+			// The backlog or the free pipe instances ran out, the daemon has to accept first
+			serviceDaemon(daemon, 1);
+			if (sft_timer_now() > deadline)
+			{
+				printf("  Client %u could not connect\n", i);
+				return i;
+			}
+		}
+
+		if (i % 64 == 63)
+			serviceDaemon(daemon, 0);
+	}
+
+	uint64_t deadline = sft_timer_now() + sft_toNANOSEC(DAEMON_BENCH_TIMEOUT_MS);
+	while (daemon->clientCount < count && sft_timer_now() < deadline)
+		serviceDaemon(daemon, 1);
+	return count;
+}
+
+bool benchDaemon()
+{
+	uint32_t count = _benchClientLimit(DAEMON_BENCH_CLIENTS);
+	if (count <= DAEMON_BENCH_SLOW)
+	{
+		printf("  Only %u clients fit under the descriptor limit\n", count);
+		return false;
+	}
+
+	Daemon daemon;
+	if (!openDaemon(&daemon, DAEMON_BENCH_PATH))
+	{
+		printf("  Could not listen on %s\n", DAEMON_BENCH_PATH);
+		return false;
+	}
+
+	BatteryInfo storage[2] = {
+		{ .tag = 1, .capacity = 50000, .charge = 40000, .rate = -10000 },
+		{ .tag = 2, .capacity = 30000, .charge = 20000 },
+	};
+	BatteryInfo_array batteries = { .data = storage, .length = 2 };
+	publishDaemon(&daemon, &batteries);
+
+	BenchClient* clients = calloc(count, sizeof(*clients));
+	DaemonLatencies latencies = { .max = (uint64_t)DAEMON_BENCH_UPDATES * count };
+	latencies.ns = malloc(latencies.max * sizeof(*latencies.ns));
+	uint32_t connected = clients && latencies.ns ? connectClients(&daemon, clients, count) : 0;
+	bool passed = connected == count && daemon.clientCount == count;
+
+	// The snapshot sent on connect
+	passed = passed && catchUp(&daemon, clients, count, daemon.seq, &latencies);
+	latencies.count = 0;
+
+	uint64_t start = sft_timer_now();
+	for (uint32_t u = 0; passed && u < DAEMON_BENCH_UPDATES; u++)
+	{
+		storage[0].charge -= 10;
+		storage[0].rate = -10000 - (int32_t)u;
+		publishDaemon(&daemon, &batteries);
+
+		if (!catchUp(&daemon, clients, count, daemon.seq, &latencies))
+		{
+			printf("  Clients fell behind update %u\n", u);
+			passed = false;
+		}
+	}
+	uint64_t elapsed = sft_timer_now() - start;
+
+	if (passed)
+	{
+		qsort(latencies.ns, latencies.count, sizeof(*latencies.ns), compareNs);
+		printf("  %u clients, %u never reading, %u updates in %.1f ms\n",
+			count, DAEMON_BENCH_SLOW, DAEMON_BENCH_UPDATES, elapsed / 1000000.0);
+		printf("  fan-out latency p50 %.1f us, p99 %.1f us, max %.1f us over %llu frames\n",
+			latencies.ns[latencies.count / 2] / 1000.0, latencies.ns[latencies.count * 99 / 100] / 1000.0,
+			latencies.ns[latencies.count - 1] / 1000.0, (unsigned long long)latencies.count);
+		printf("  %llu frames written in full, %llu coalesced for slow clients\n",
+			(unsigned long long)daemon.sent, (unsigned long long)daemon.coalesced);
+
+		// Frames for clients that never read are replaced, not queued
+		if (!daemon.coalesced)
+		{
+			printf("  Nothing was coalesced for the slow clients\n");
+			passed = false;
+		}
+	}
+
+	// Clients hanging up have to be reaped
+	if (passed)
+	{
+		for (uint32_t i = 0; i < DAEMON_BENCH_SLOW; i++)
+			_closeBenchClient(clients[i].handle);
+
+		uint64_t deadline = sft_timer_now() + sft_toNANOSEC(DAEMON_BENCH_TIMEOUT_MS);
+		while (daemon.clientCount > count - DAEMON_BENCH_SLOW && sft_timer_now() < deadline)
+			serviceDaemon(&daemon, 1);
+		if (daemon.clientCount != count - DAEMON_BENCH_SLOW)
+		{
+			printf("  %u clients left after the slow ones hung up, %u expected\n",
+				daemon.clientCount, count - DAEMON_BENCH_SLOW);
+			passed = false;
+		}
+
+		for (uint32_t i = DAEMON_BENCH_SLOW; i < count; i++)
+			_closeBenchClient(clients[i].handle);
+	}
+	else
+		for (uint32_t i = 0; i < connected; i++)
+			_closeBenchClient(clients[i].handle);
+	closeDaemon(&daemon);
+
+	free(clients);
+	free(latencies.ns);
+	return passed;
+}
\ No newline at end of file
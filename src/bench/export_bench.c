@@ -0,0 +1,221 @@
+#include "bench.h"
+#include "../export/export.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Its own segment, a widget already exporting is left alone
+#ifdef _WIN32
+#define EXPORT_BENCH_NAME "Local\\BatteryInfo.bench"
+#else
+#define EXPORT_BENCH_NAME "/BatteryInfo.bench"
+#endif
+
+#define EXPORT_BENCH_READERS 8
+#define EXPORT_BENCH_RUN_MS 250
+
+typedef struct ExportReaderStats
+{
+	uint64_t reads;
+	uint64_t failed;
+	uint64_t torn;
+	uint64_t retries;
+	uint64_t ns;
+	bool opened;
+} ExportReaderStats;
+
+typedef struct ExportContention
+{
+	BatteryExport writer;
+	// Nanoseconds between writes, 0 writes as fast as it can
+	uint64_t periodNs;
+	uint64_t writes;
+	uint32_t stop;
+	ExportReaderStats readers[EXPORT_BENCH_READERS];
+} ExportContention;
+
+static inline void storeStop(uint32_t* dest, uint32_t value)
+{
+#ifdef _MSC_VER
+	_InterlockedExchange((volatile long*)dest, (long)value);
+#else
+	__atomic_store_n(dest, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline uint32_t loadStop(const uint32_t* src)
+{
+#ifdef _MSC_VER
+	return (uint32_t)_InterlockedCompareExchange((volatile long*)src, 0, 0);
+#else
+	return __atomic_load_n(src, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Every field of every battery is derived from k, a copy mixing two writes can not pass
+static void publishBatteries(BatteryExport* writer, uint32_t k)
+{
+	BatteryInfo storage[EXPORT_BATTERIES];
+	BatteryInfo_array batteries = { .data = storage, .length = EXPORT_BATTERIES, ._max = EXPORT_BATTERIES };
+	memset(storage, 0, sizeof(storage));
+
+	for (uint32_t i = 0; i < EXPORT_BATTERIES; i++)
+	{
+		storage[i].tag = k;
+		storage[i].charge = k;
+		storage[i].capacity = k + 1;
+		storage[i].wear = k + 2;
+		storage[i].rate = -(int32_t)k;
+		storage[i].voltage = k + 3;
+		storage[i].isCharging = k & 1;
+	}
+	publishExport(writer, &batteries);
+}
+
+static void writeBatteries(void* user)
+{
+	ExportContention* contention = user;
+
+	uint64_t next = sft_timer_now();
+	for (uint32_t k = 1; !loadStop(&contention->stop); k++)
+	{
+		publishBatteries(&contention->writer, k);
+		contention->writes++;
+
+		if (contention->periodNs)
+		{
+			next += contention->periodNs;
+			while (sft_timer_now() < next && !loadStop(&contention->stop))
+				;
+		}
+	}
+}
+
+static bool wholeState(const ExportState* state)
+{
+	uint32_t k = state->batteries[0].tag;
+	if (state->count != EXPORT_BATTERIES)
+		return false;
+
+	for (uint32_t i = 0; i < EXPORT_BATTERIES; i++)
+	{
+		const ExportBattery* battery = &state->batteries[i];
+		if (battery->tag != k || battery->charge != k || battery->capacity != k + 1 || battery->wear != k + 2 ||
+			battery->rate != -(int32_t)k || battery->voltage != k + 3 || battery->isCharging != (k & 1))
+			return false;
+	}
+	return true;
+}
+
+typedef struct ExportReaderArgs
+{
+	ExportContention* contention;
+	ExportReaderStats* stats;
+} ExportReaderArgs;
+
+static void readBatteries(void* user)
+{
+	ExportReaderArgs* args = user;
+	ExportReaderStats* stats = args->stats;
+
+	BatteryExport reader;
+	stats->opened = openExportReader(&reader, EXPORT_BENCH_NAME);
+	if (!stats->opened)
+		return;
+
+	uint64_t start = sft_timer_now();
+	while (!loadStop(&args->contention->stop))
+	{
+		ExportState state;
+		if (!readExport(&reader, &state))
+			stats->failed++;
+		else
+		{
+			stats->reads++;
+			stats->torn += !wholeState(&state);
+		}
+	}
+	stats->ns = sft_timer_now() - start;
+	stats->retries = reader.retries;
+	closeExport(&reader);
+}
+
+// One writer at periodNs against count readers, returns false if a reader saw a torn state or gave up
+static bool runContention(ExportContention* contention, uint64_t periodNs, uint32_t count)
+{
+	contention->periodNs = periodNs;
+	contention->writes = 0;
+	storeStop(&contention->stop, 0);
+	memset(contention->readers, 0, sizeof(contention->readers));
+
+	// Readers start from a whole state, whatever a previous run left in the segment
+	publishBatteries(&contention->writer, 0);
+	intptr_t writer = _startBenchThread(writeBatteries, contention);
+	if (!writer)
+		return false;
+
+	ExportReaderArgs args[EXPORT_BENCH_READERS];
+	intptr_t readers[EXPORT_BENCH_READERS];
+	uint32_t started = 0;
+	for (; started < count; started++)
+	{
+		args[started] = (ExportReaderArgs){ contention, &contention->readers[started] };
+		readers[started] = _startBenchThread(readBatteries, &args[started]);
+		if (!readers[started])
+			break;
+	}
+
+	sft_sleep(EXPORT_BENCH_RUN_MS);
+	storeStop(&contention->stop, 1);
+	for (uint32_t i = 0; i < started; i++)
+		_joinBenchThread(readers[i]);
+	_joinBenchThread(writer);
+
+	ExportReaderStats total = { 0 };
+	double nsPerRead = 0;
+	bool opened = started == count;
+	for (uint32_t i = 0; i < started; i++)
+	{
+		const ExportReaderStats* stats = &contention->readers[i];
+		opened &= stats->opened;
+		total.reads += stats->reads;
+		total.failed += stats->failed;
+		total.torn += stats->torn;
+		total.retries += stats->retries;
+		nsPerRead += stats->reads ? (double)stats->ns / stats->reads / started : 0;
+	}
+
+	double seconds = EXPORT_BENCH_RUN_MS / 1000.0;
+	printf("  writer %-8s %u readers: %8.0f writes/s, %6.2fM reads/s, %6.1f ns/read, %5.2f%% retried, %llu failed, %llu torn\n",
+		periodNs ? (periodNs == 10000 ? "100 kHz" : "1 kHz") : "flat out", count, contention->writes / seconds,
+		total.reads / seconds / 1e6, nsPerRead, total.reads + total.retries ? 100.0 * total.retries / (total.reads + total.retries) : 0,
+		(unsigned long long)total.failed, (unsigned long long)total.torn);
+
+	return opened && total.reads && !total.failed && !total.torn;
+}
+
+bool benchExport()
+{
+	static ExportContention contention;
+	memset(&contention, 0, sizeof(contention));
+	if (!openExport(&contention.writer, EXPORT_BENCH_NAME))
+	{
+		printf("  Could not create the segment %s\n", EXPORT_BENCH_NAME);
+		return false;
+	}
+
+	bool passed = true;
+	static const uint64_t periods[] = { 0, 10000, 1000000 };
+	for (uint32_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+		for (uint32_t count = 1; count <= EXPORT_BENCH_READERS; count *= 2)
+			passed &= runContention(&contention, periods[p], count);
+
+	closeExport(&contention.writer);
+	_removeBenchExport(EXPORT_BENCH_NAME);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "bench.h"
+#include "../softdraw/image/image.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// A little bigger than the largest cached glyph, random draws hang off every edge
+#define GLYPH_BENCH_SIZE 80
+#define GLYPH_BENCH_CHECKS 20000
+// Glyph cells drawn per size, so every size takes about as long
+#define GLYPH_BENCH_CELLS (1 << 20)
+
+// What the widget's labels draw, few enough to stay cached
+static const char widgetChars[] = "0123456789.%: mWhV";
+
+static void printStats(const char* what, sft_glyphCacheStats stats)
+{
+	uint64_t draws = stats.hits + stats.misses;
+	printf("  %-8s %8llu hits, %6llu misses, %6llu evictions, %5.1f%% hit\n", what, (unsigned long long)stats.hits,
+		(unsigned long long)stats.misses, (unsigned long long)stats.evictions, draws ? 100.0 * stats.hits / draws : 0);
+}
+
+// Random characters, sizes and positions through the cache and pixel by pixel, every pixel has to match
+static bool checkGlyphs(sft_image* cached, sft_image* uncached, sft_blend blend)
+{
+	uint64_t state = 11;
+	uint64_t wrong = 0;
+	cached->blend = uncached->blend = blend;
+	sft_image_clearGlyphCache();
+
+	for (uint32_t i = 0; i < GLYPH_BENCH_CHECKS; i++)
+	{
+		sft_image_fill(cached, (sft_color)i);
+		sft_image_fill(uncached, (sft_color)i);
+
+		char ch = (char)(benchRandom(&state) % 128);
+		uint32_t size = 1 + (uint32_t)(benchRandom(&state) % sft_GLYPH_CACHE_MAX_SIZE);
+		int32_t x = (int32_t)(benchRandom(&state) % (GLYPH_BENCH_SIZE + 16 * size)) - 8 * (int32_t)size;
+		int32_t y = (int32_t)(benchRandom(&state) % (GLYPH_BENCH_SIZE + 16 * size)) - 8 * (int32_t)size;
+		sft_color color = sft_premultiply((sft_color)benchRandom(&state));
+
+		sft_image_setGlyphCache(true);
+		sft_image_drawChar(cached, ch, x, y, size, color);
+		sft_image_setGlyphCache(false);
+		sft_image_drawChar(uncached, ch, x, y, size, color);
+
+		wrong += memcmp(cached->pixels, uncached->pixels, sizeof(sft_color) * GLYPH_BENCH_SIZE * GLYPH_BENCH_SIZE) != 0;
+	}
+	sft_image_setGlyphCache(true);
+
+	const char* what = blend == sft_blend_over ? "blended" : "copied";
+	printf("  %-8s %llu of %u random glyphs differ from the per-pixel path\n", what, (unsigned long long)wrong,
+		GLYPH_BENCH_CHECKS);
+	printStats(what, sft_image_glyphCacheStats());
+	return !wrong;
+}
+
+// Glyphs a second drawing the widget's characters at size
+static double measureGlyphs(sft_image* image, uint32_t size, bool cache)
+{
+	uint32_t draws = GLYPH_BENCH_CELLS / (size * size);
+	sft_image_setGlyphCache(cache);
+
+	uint64_t start = sft_timer_now();
+	for (uint32_t i = 0; i < draws; i++)
+		sft_image_drawChar(image, widgetChars[i % (sizeof(widgetChars) - 1)], i & 7, i & 3, size, 0xFFFFFFFF);
+	uint64_t elapsed = sft_timer_now() - start;
+
+	sft_image_setGlyphCache(true);
+	return elapsed ? draws * 1e9 / elapsed : 0;
+}
+
+bool benchGlyph()
+{
+	sft_image* cached = sft_image_create(GLYPH_BENCH_SIZE, GLYPH_BENCH_SIZE);
+	sft_image* uncached = sft_image_create(GLYPH_BENCH_SIZE, GLYPH_BENCH_SIZE);
+	if (!cached || !uncached || !cached->pixels || !uncached->pixels)
+	{
+		sft_image_delete(cached);
+		sft_image_delete(uncached);
+		return false;
+	}
+
+	bool passed = checkGlyphs(cached, uncached, sft_blend_copy);
+	passed &= checkGlyphs(cached, uncached, sft_blend_over);
+
+	// The widget's characters fit the cache, each may miss once and nothing may be evicted
+	cached->blend = sft_blend_copy;
+	uint32_t distinct = 0;
+	for (uint32_t i = 0; widgetChars[i]; i++)
+		distinct += strchr(widgetChars, widgetChars[i]) == widgetChars + i;
+
+	sft_glyphCacheStats total = { 0 };
+	for (uint32_t size = 1; size <= sft_GLYPH_CACHE_MAX_SIZE; size++)
+	{
+		double perPixel = measureGlyphs(cached, size, false);
+		sft_image_clearGlyphCache();
+		double glyphs = measureGlyphs(cached, size, true);
+		sft_glyphCacheStats stats = sft_image_glyphCacheStats();
+
+		printf("  size %u  cached %7.2f M glyphs/s, per-pixel %7.2f M glyphs/s, %5.1fx, %llu misses\n", size,
+			glyphs / 1e6, perPixel / 1e6, perPixel ? glyphs / perPixel : 0, (unsigned long long)stats.misses);
+		passed &= stats.misses == distinct && !stats.evictions;
+		total.hits += stats.hits;
+		total.misses += stats.misses;
+		total.evictions += stats.evictions;
+	}
+	printStats("timed", total);
+
+	sft_image_delete(cached);
+	sft_image_delete(uncached);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "../history/history.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+
+// Written next to the real history and removed again
+#define HISTORY_BENCH_PATH "BatteryHistory.bench"
+// 30 days of 1 Hz samples from one battery
+#define HISTORY_BENCH_SAMPLES (30ull * 86400)
+#define HISTORY_BENCH_START 1700000000000ull
+
+typedef struct HistoryCheck
+{
+	uint64_t visited;
+	uint64_t wrong;
+	uint64_t lastTime;
+} HistoryCheck;
+
+// A slow discharge and a faster charge, the shape a laptop battery leaves
+static HistorySample benchSample(uint32_t key, uint64_t i)
+{
+	uint64_t cycle = i % 20000;
+	return (HistorySample){
+		.key = key,
+		.time = HISTORY_BENCH_START + i * 1000,
+		.charge = (uint32_t)(cycle < 12000 ? 50000 - cycle * 3 : 14000 + (cycle - 12000) * 4),
+		.capacity = 50000,
+		.wear = (uint32_t)(i / 864000),
+		.isCharging = cycle >= 12000,
+	};
+}
+
+// Every sample scanned has to decode to what was appended at its time, in time order
+static bool checkSample(const HistorySample* sample, void* user)
+{
+	HistoryCheck* check = user;
+	HistorySample expected = benchSample(sample->key, (sample->time - HISTORY_BENCH_START) / 1000);
+
+	if (sample->time < check->lastTime || sample->charge != expected.charge || sample->capacity != expected.capacity ||
+		sample->wear != expected.wear || sample->isCharging != expected.isCharging)
+		check->wrong++;
+	check->lastTime = sample->time;
+	check->visited++;
+	return true;
+}
+
+static bool reportScan(const char* what, const HistoryCheck* check, uint64_t visited, uint64_t elapsed)
+{
+	printf("  %-14s %8llu samples, %5.1f ns/sample, %llu wrong\n", what, (unsigned long long)visited,
+		visited ? (double)elapsed / visited : 0, (unsigned long long)check->wrong);
+	return visited && !check->wrong;
+}
+
+bool benchHistory()
+{
+	remove(HISTORY_BENCH_PATH);
+
+	History history;
+	if (!openHistory(&history, HISTORY_BENCH_PATH))
+	{
+		printf("  Could not create %s\n", HISTORY_BENCH_PATH);
+		return false;
+	}
+
+	uint32_t key = historyKey(1, "bench");
+	uint64_t start = sft_timer_now();
+	for (uint64_t i = 0; i < HISTORY_BENCH_SAMPLES; i++)
+	{
+		HistorySample sample = benchSample(key, i);
+		appendHistory(&history, &sample);
+	}
+	uint64_t elapsed = sft_timer_now() - start;
+	printf("  ingest         %8llu samples, %5.1f ns/sample\n",
+		(unsigned long long)HISTORY_BENCH_SAMPLES, (double)elapsed / HISTORY_BENCH_SAMPLES);
+
+	bool passed = true;
+
+	HistoryCheck all = { 0 };
+	start = sft_timer_now();
+	uint64_t visited = scanHistory(&history, key, 0, UINT64_MAX, checkSample, &all);
+	passed &= reportScan("scan all", &all, visited, sft_timer_now() - start);
+
+	// Blocks are indexed by time, a day out of the ring decodes only the blocks around it
+	uint64_t day = HISTORY_BENCH_START + 86400000ull * 20;
+	HistoryCheck one = { 0 };
+	start = sft_timer_now();
+	visited = scanHistory(&history, key, day, day + 86400000ull - 1, checkSample, &one);
+	passed &= reportScan("scan one day", &one, visited, sft_timer_now() - start);
+	if (visited != 86400)
+	{
+		printf("  A day holds 86400 samples, the scan found %llu\n", (unsigned long long)visited);
+		passed = false;
+	}
+
+	// Blocks started so far, the ring only drops the oldest once all of them were used
+	uint64_t blocks = history.header->seq < HISTORY_BLOCK_COUNT ? history.header->seq : HISTORY_BLOCK_COUNT;
+	printf("  %.2f bytes/sample in %llu blocks of %u bytes\n",
+		all.visited ? (double)blocks * HISTORY_BLOCK_SIZE / all.visited : 0, (unsigned long long)blocks, HISTORY_BLOCK_SIZE);
+
+	// What a reader sees after the writer closed, every sample back from the file
+	closeHistory(&history);
+	HistoryCheck reopened = { 0 };
+	if (openHistory(&history, HISTORY_BENCH_PATH))
+	{
+		start = sft_timer_now();
+		visited = scanHistory(&history, 0, 0, UINT64_MAX, checkSample, &reopened);
+		passed &= reportScan("after reopen", &reopened, visited, sft_timer_now() - start);
+		passed &= visited == all.visited;
+		closeHistory(&history);
+	}
+	else
+		passed = false;
+
+	remove(HISTORY_BENCH_PATH);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "../softdraw/image/image.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest random run, and room on both sides of it so a kernel writing past the run changes a canary
+#define IMAGE_BENCH_RUN 300
+#define IMAGE_BENCH_PAD 64
+#define IMAGE_BENCH_ROUNDS 20000
+
+// Throughput is measured over whole frames of this size
+#define IMAGE_BENCH_WIDTH 1920
+#define IMAGE_BENCH_HEIGHT 1080
+#define IMAGE_BENCH_FRAMES 20
+
+static const char* const simdNames[] = { "scalar", "sse2", "avx2" };
+
+typedef struct ImageKernel
+{
+	const char* name;
+	// src and color are each only read by the kernels that take them
+	void (*run)(sft_color* dest, const sft_color* src, uint64_t count, sft_color color);
+} ImageKernel;
+
+static void runFill(sft_color* dest, const sft_color* src, uint64_t count, sft_color color)
+{
+	_sft_image_fillRow(dest, count, color);
+}
+
+static void runBlend(sft_color* dest, const sft_color* src, uint64_t count, sft_color color)
+{
+	// Opaque colors are filled, the random colors nearly always have some alpha to blend
+	_sft_image_blendRow(dest, count, color);
+}
+
+static void runSpan(sft_color* dest, const sft_color* src, uint64_t count, sft_color color)
+{
+	_sft_image_blendSpan(dest, src, count);
+}
+
+static const ImageKernel kernels[] =
+{
+	{ "fill", runFill },
+	{ "blend", runBlend },
+	{ "span", runSpan },
+};
+
+// Runs the same random runs on the scalar kernel and on level, every pixel around them has to match
+static bool checkKernel(const ImageKernel* kernel, sft_simd level, uint64_t seed)
+{
+	sft_color expected[IMAGE_BENCH_RUN + 2 * IMAGE_BENCH_PAD];
+	sft_color actual[IMAGE_BENCH_RUN + 2 * IMAGE_BENCH_PAD];
+	sft_color src[IMAGE_BENCH_RUN + IMAGE_BENCH_PAD];
+
+	uint64_t state = seed;
+	for (uint32_t round = 0; round < IMAGE_BENCH_ROUNDS; round++)
+	{
+		// Offsets cover every alignment the vector loops care about
+		uint32_t offset = (uint32_t)(benchRandom(&state) % IMAGE_BENCH_PAD);
+		uint32_t srcOffset = (uint32_t)(benchRandom(&state) % IMAGE_BENCH_PAD);
+		uint32_t count = (uint32_t)(benchRandom(&state) % (IMAGE_BENCH_RUN + 1));
+		sft_color color = (sft_color)benchRandom(&state);
+
+		for (uint32_t i = 0; i < IMAGE_BENCH_RUN + 2 * IMAGE_BENCH_PAD; i++)
+			expected[i] = actual[i] = (sft_color)benchRandom(&state);
+		for (uint32_t i = 0; i < IMAGE_BENCH_RUN + IMAGE_BENCH_PAD; i++)
+			src[i] = (sft_color)benchRandom(&state);
+
+		sft_image_setSimd(sft_simd_none);
+		kernel->run(expected + offset, src + srcOffset, count, color);
+		sft_image_setSimd(level);
+		kernel->run(actual + offset, src + srcOffset, count, color);
+
+		if (memcmp(expected, actual, sizeof(expected)) != 0)
+		{
+			printf("  %s %s differs from scalar, seed %llu round %u: offset %u count %u color %08X\n",
+				simdNames[level], kernel->name, (unsigned long long)seed, round, offset, count, color);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Megapixels a second the kernel at the current level gets through, one frame row per call
+static double measureKernel(const ImageKernel* kernel, sft_color* frame, const sft_color* src)
+{
+	uint64_t start = sft_timer_now();
+	for (uint32_t f = 0; f < IMAGE_BENCH_FRAMES; f++)
+		for (uint32_t y = 0; y < IMAGE_BENCH_HEIGHT; y++)
+			kernel->run(frame + y * IMAGE_BENCH_WIDTH, src, IMAGE_BENCH_WIDTH, 0x80402010 + f);
+	uint64_t elapsed = sft_timer_now() - start;
+
+	double pixels = (double)IMAGE_BENCH_FRAMES * IMAGE_BENCH_WIDTH * IMAGE_BENCH_HEIGHT;
+	return elapsed ? pixels * 1000.0 / elapsed : 0;
+}
+
+bool benchImage()
+{
+	bool passed = true;
+
+	sft_image_setSimd(sft_simd_avx2);
+	sft_simd supported = sft_image_simd();
+	printf("  CPU supports %s\n", simdNames[supported]);
+
+	for (uint32_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		for (sft_simd level = sft_simd_sse2; level <= supported; level++)
+		{
+			bool ok = checkKernel(&kernels[k], level, 0x9E3779B97F4A7C15ull + k);
+			if (ok)
+				printf("  %s %s matches scalar over %u random runs\n", simdNames[level], kernels[k].name, IMAGE_BENCH_ROUNDS);
+			passed &= ok;
+		}
+	}
+
+	sft_color* frame = malloc(sizeof(sft_color) * IMAGE_BENCH_WIDTH * IMAGE_BENCH_HEIGHT);
+	sft_color* src = malloc(sizeof(sft_color) * IMAGE_BENCH_WIDTH);
+	if (frame && src)
+	{
+		uint64_t state = 1;
+		for (uint32_t i = 0; i < IMAGE_BENCH_WIDTH * IMAGE_BENCH_HEIGHT; i++)
+			frame[i] = (sft_color)benchRandom(&state);
+		for (uint32_t i = 0; i < IMAGE_BENCH_WIDTH; i++)
+			src[i] = (sft_color)benchRandom(&state);
+
+		for (uint32_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+		{
+			printf("  %-6s", kernels[k].name);
+			for (sft_simd level = sft_simd_none; level <= supported; level++)
+			{
+				sft_image_setSimd(level);
+				printf("  %s %7.0f Mpx/s", simdNames[level], measureKernel(&kernels[k], frame, src));
+			}
+			printf("\n");
+		}
+	}
+	else
+		passed = false;
+
+	free(frame);
+	free(src);
+
+	sft_image_setSimd(sft_simd_avx2);
+	return passed;
+}
\ No newline at end of file
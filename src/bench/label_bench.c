@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "../softdraw/widget/label.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// The widget's window
+#define LABEL_BENCH_WIDTH 222
+#define LABEL_BENCH_HEIGHT 32
+#define LABEL_BENCH_ROUNDS 3000
+#define LABEL_BENCH_CALLS 200000
+// Fills the windows' frames start from, near transparent on alpha windows like the widget's
+#define LABEL_BENCH_CLEAR 0
+#define LABEL_BENCH_ALPHA_CLEAR 0x01000000
+
+static bool sameFrame(const sft_window* a, const sft_window* b)
+{
+	return memcmp(a->frameBuf->pixels, b->frameBuf->pixels,
+		sizeof(sft_color) * LABEL_BENCH_WIDTH * LABEL_BENCH_HEIGHT) == 0;
+}
+
+// What a label that never drew anything puts on a cleared window
+static void drawFresh(sft_window* window, const sft_label* like, const char* text, sft_color color)
+{
+	sft_label fresh;
+	sft_window_fill(window, like->background);
+	sft_label_init(&fresh, like->x, like->y, like->fontSize, like->background);
+	fresh.lineHeight = like->lineHeight;
+	sft_label_set(window, &fresh, text, color);
+}
+
+// Updating a label in place has to leave the same pixels as drawing its text from scratch
+static bool checkLabel(sft_window* kept, sft_window* fresh, sft_color background, const char* what)
+{
+	char text[32];
+	uint64_t wrong = 0;
+	uint64_t state = 7;
+
+	sft_label label;
+	for (uint32_t mode = 0; mode < 2; mode++)
+	{
+		// The percentage line, then the two overlapping lines of the charge and capacity modes
+		sft_window_fill(kept, background);
+		sft_label_init(&label, mode ? 8 : 0, mode ? 4 : 8, mode ? 2 : 3, background);
+		if (mode)
+			label.lineHeight = 14;
+
+		for (uint32_t i = 0; i < LABEL_BENCH_ROUNDS; i++)
+		{
+			// Long runs of near values like a real battery, then anything at all
+			uint32_t range = i < LABEL_BENCH_ROUNDS / 2 ? 100000 : 1000000000;
+			if (mode)
+				snprintf(text, sizeof(text), "%10u\n%10u", (uint32_t)(benchRandom(&state) % range),
+					(uint32_t)(benchRandom(&state) % 100000));
+			else
+				snprintf(text, sizeof(text), "%6.2f%%", benchRandom(&state) % 10001 / 100.0);
+			sft_color color = benchRandom(&state) % 10 ? 0xFFFFFFFF : 0xFF00FF00;
+
+			sft_label_set(kept, &label, text, color);
+			drawFresh(fresh, &label, text, color);
+			wrong += !sameFrame(kept, fresh);
+		}
+	}
+
+	// Moving has to clear the old text
+	sft_label_set(kept, &label, "abc", 0xFFFFFFFF);
+	label.x = 40;
+	label.y = 0;
+	sft_label_set(kept, &label, "abc", 0xFFFFFFFF);
+	drawFresh(fresh, &label, "abc", 0xFFFFFFFF);
+	wrong += !sameFrame(kept, fresh);
+
+	printf("  %-6s %llu of %u updates differ from a fresh render\n", what, (unsigned long long)wrong,
+		2 * LABEL_BENCH_ROUNDS + 1);
+	return !wrong;
+}
+
+// Opens a pair of windows with flags and checks labels on them
+static bool checkWindows(sft_flags flags, sft_color background, const char* what)
+{
+	sft_window* kept = sft_window_open("", LABEL_BENCH_WIDTH, LABEL_BENCH_HEIGHT, 0, 0, flags);
+	sft_window* fresh = sft_window_open("", LABEL_BENCH_WIDTH, LABEL_BENCH_HEIGHT, 0, 0, flags);
+	bool passed = kept && fresh && checkLabel(kept, fresh, background, what);
+	if (!kept || !fresh)
+		printf("  Could not open the %s windows\n", what);
+
+	sft_window_close(kept);
+	sft_window_close(fresh);
+	return passed;
+}
+
+bool benchLabel()
+{
+	sft_window_init();
+
+	// Clears have to overwrite on alpha windows too, where draws blend
+	bool passed = checkWindows(sft_flag_hidden, LABEL_BENCH_CLEAR, "opaque");
+	passed &= checkWindows(sft_flag_hidden | sft_flag_alpha, LABEL_BENCH_ALPHA_CLEAR, "alpha");
+
+	// Timed on a window like the widget's
+	sft_window* kept = sft_window_open("", LABEL_BENCH_WIDTH, LABEL_BENCH_HEIGHT, 0, 0, sft_flag_hidden | sft_flag_alpha);
+	if (!kept)
+	{
+		sft_window_shutdown();
+		return false;
+	}
+
+	// The percentage ticking over by one hundredth, the redraw the widget does most
+	const char* ticks[2] = { " 73.45%", " 73.46%" };
+	sft_label label;
+	sft_window_fill(kept, LABEL_BENCH_ALPHA_CLEAR);
+	sft_label_init(&label, 0, 8, 3, LABEL_BENCH_ALPHA_CLEAR);
+	sft_label_set(kept, &label, ticks[0], 0xFFFFFFFF);
+
+	uint64_t touched = kept->pixelsTouched;
+	uint64_t start = sft_timer_now();
+	for (uint32_t i = 1; i <= LABEL_BENCH_CALLS; i++)
+		sft_label_set(kept, &label, ticks[i & 1], 0xFFFFFFFF);
+	double oneDigit = (double)(sft_timer_now() - start) / LABEL_BENCH_CALLS;
+	uint64_t oneDigitPx = (kept->pixelsTouched - touched) / LABEL_BENCH_CALLS;
+
+	sft_rect rects[4];
+	uint32_t rectCount = sft_label_damage(&label, rects, 4);
+	printf("  one digit     %6.0f ns, %6llu px, %u damage rect%s of %ux%u\n", oneDigit, (unsigned long long)oneDigitPx,
+		rectCount, rectCount == 1 ? "" : "s", rectCount ? rects[0].w : 0, rectCount ? rects[0].h : 0);
+
+	// A single glyph cell of 8 * fontSize, anything more means the diffing broke
+	if (rectCount != 1 || rects[0].w != 24 || rects[0].h != 24)
+		passed = false;
+
+	touched = kept->pixelsTouched;
+	start = sft_timer_now();
+	for (uint32_t i = 1; i <= LABEL_BENCH_CALLS; i++)
+	{
+		sft_window_fill(kept, LABEL_BENCH_ALPHA_CLEAR);
+		sft_window_drawText(kept, ticks[i & 1], 0, 8, 3, 0xFFFFFFFF);
+	}
+	printf("  full redraw   %6.0f ns, %6llu px\n", (double)(sft_timer_now() - start) / LABEL_BENCH_CALLS,
+		(unsigned long long)(kept->pixelsTouched - touched) / LABEL_BENCH_CALLS);
+
+	sft_window_close(kept);
+	sft_window_shutdown();
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "bench.h"
+#include "../battery/poller.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Firmware that takes this long per battery query, and how often it is polled
+#define POLLER_BENCH_BATTERIES 2
+#define POLLER_BENCH_READ_MS 40
+#define POLLER_BENCH_POLL_MS 100
+// A UI drawing a frame every millisecond for this long
+#define POLLER_BENCH_RUN_MS 3000
+#define POLLER_BENCH_FRAMES 4096
+
+// Reads of each slow battery so far, every battery of a read has the same count
+static uint32_t slowReads[POLLER_BENCH_BATTERIES];
+
+static bool slowEnumerate(BatteryPath_array* paths)
+{
+	return pushBatteryPath(paths, "bench0") && pushBatteryPath(paths, "bench1");
+}
+
+static bool slowOpen(BatteryInfo* battery, const char* path)
+{
+	// The handle is the index plus one
+	battery->handle = (void*)(uintptr_t)(path[strlen(path) - 1] - '0' + 1);
+	return true;
+}
+
+static void slowReadStatic(BatteryInfo* battery)
+{
+	battery->capacity = 50000;
+	battery->wear = 1000;
+}
+
+// Drains a little on every read so every read changes a shown field
+static void slowReadDynamic(BatteryInfo* battery)
+{
+	sft_sleep(POLLER_BENCH_READ_MS);
+
+	uint32_t index = (uint32_t)(uintptr_t)battery->handle - 1;
+	slowReads[index]++;
+	battery->tag = index + 1;
+	battery->charge = 40000 - slowReads[index];
+	battery->rate = -5000;
+}
+
+static void slowRelease(BatteryInfo* battery)
+{
+	memset(battery, 0, sizeof(*battery));
+}
+
+static const BatteryProvider slowBatteryProvider =
+{
+	.name = "slow",
+	.enumerate = slowEnumerate,
+	.open = slowOpen,
+	.readStatic = slowReadStatic,
+	.readDynamic = slowReadDynamic,
+	.release = slowRelease,
+};
+
+typedef struct FrameTimes
+{
+	uint64_t ns[POLLER_BENCH_FRAMES];
+	uint32_t count;
+} FrameTimes;
+
+static int compareNs(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+// Returns the slowest frame
+static uint64_t reportFrames(const char* what, FrameTimes* frames)
+{
+	qsort(frames->ns, frames->count, sizeof(*frames->ns), compareNs);
+	uint64_t max = frames->count ? frames->ns[frames->count - 1] : 0;
+	printf("  %-7s %4u frames, p50 %8.1f us, p99 %8.1f us, max %8.1f us\n", what, frames->count,
+		frames->count ? frames->ns[frames->count / 2] / 1000.0 : 0,
+		frames->count ? frames->ns[frames->count * 99 / 100] / 1000.0 : 0, max / 1000.0);
+	return max;
+}
+
+// The loop draw() had before the poller, the frame a poll lands in waits for every battery
+static void runSync(FrameTimes* frames)
+{
+	BatteryInfo_array batteries = getBatteries(&slowBatteryProvider);
+
+	uint64_t lastPoll = sft_timer_now();
+	uint64_t end = lastPoll + sft_toNANOSEC(POLLER_BENCH_RUN_MS);
+	while (sft_timer_now() < end && frames->count < POLLER_BENCH_FRAMES)
+	{
+		uint64_t start = sft_timer_now();
+		if (sft_timer_msPassed(&lastPoll, POLLER_BENCH_POLL_MS))
+		{
+			updateBatteries(&batteries, NULL);
+			feedBatteryEstimators(&batteries, sft_toMILLISEC(sft_timer_now()));
+		}
+		frames->ns[frames->count++] = sft_timer_now() - start;
+		sft_sleep(1);
+	}
+
+	releaseBatteries(&batteries);
+}
+
+bool benchPoller()
+{
+	static FrameTimes sync;
+	static FrameTimes polled;
+	sync.count = polled.count = 0;
+	memset(slowReads, 0, sizeof(slowReads));
+
+	runSync(&sync);
+	reportFrames("sync", &sync);
+
+	BatteryPoller poller;
+	if (!startPoller(&poller, &slowBatteryProvider, POLLER_BENCH_POLL_MS, NULL, NULL))
+	{
+		printf("  Could not start the poller\n");
+		return false;
+	}
+
+	// Every snapshot has to be one whole read, a torn one mixes batteries from different reads
+	uint64_t torn = 0;
+	uint64_t redraws = 0;
+	uint64_t generation = 0;
+	uint64_t end = sft_timer_now() + sft_toNANOSEC(POLLER_BENCH_RUN_MS);
+	while (sft_timer_now() < end && polled.count < POLLER_BENCH_FRAMES)
+	{
+		uint64_t start = sft_timer_now();
+		const BatterySnapshot* snapshot = acquireSnapshot(&poller);
+		if (snapshot->generation != generation)
+		{
+			generation = snapshot->generation;
+			redraws++;
+
+			const BatteryInfo* data = snapshot->batteries.data;
+			torn += snapshot->batteries.length != POLLER_BENCH_BATTERIES || data[0].charge != data[1].charge ||
+				snapshot->totals.charge != (uint64_t)data[0].charge + data[1].charge;
+		}
+		polled.ns[polled.count++] = sft_timer_now() - start;
+		sft_sleep(1);
+	}
+
+	uint64_t start = sft_timer_now();
+	stopPoller(&poller);
+	uint64_t stopNs = sft_timer_now() - start;
+
+	uint64_t max = reportFrames("poller", &polled);
+	printf("  %llu redraws, %llu torn snapshots, stopping waited %.1f ms for the read in flight\n",
+		(unsigned long long)redraws, (unsigned long long)torn, stopNs / 1000000.0);
+
+	// No frame may wait for a battery, and the reads have to come through at about the poll period
+	return !torn && max < sft_toNANOSEC(POLLER_BENCH_READ_MS) &&
+		redraws >= POLLER_BENCH_RUN_MS / POLLER_BENCH_POLL_MS / 2;
+}
\ No newline at end of file
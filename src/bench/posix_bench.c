@@ -0,0 +1,221 @@
+#include "bench.h"
+
+#ifndef _WIN32
+
+#include "../battery/battery.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+uint32_t _benchClientLimit(uint32_t wanted)
+{
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+		return wanted;
+
+	if (limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		getrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	// Both ends of every client are in this process, and some descriptors are already open
+	uint64_t fit = limit.rlim_cur > 64 ? (limit.rlim_cur - 64) / 2 : 0;
+	return fit < wanted ? (uint32_t)fit : wanted;
+}
+
+intptr_t _connectBenchClient(const char* path, bool slow)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return -1;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	// Set before connecting, the daemon's writes then fill it after a few frames
+	if (slow)
+	{
+		int size = 4096;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	}
+
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int64_t _readBenchClient(intptr_t client, uint8_t* buf, uint64_t size)
+{
+	ssize_t got = recv((int)client, buf, size, 0);
+	if (got > 0)
+		return got;
+	if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return 0;
+	return -1;
+}
+
+void _closeBenchClient(intptr_t client)
+{
+	close((int)client);
+}
+
+typedef struct BenchThread
+{
+	pthread_t thread;
+	void (*run)(void* user);
+	void* user;
+} BenchThread;
+
+static void* benchThread(void* arg)
+{
+	BenchThread* thread = arg;
+	thread->run(thread->user);
+	return NULL;
+}
+
+intptr_t _startBenchThread(void (*run)(void* user), void* user)
+{
+	// pthread_t is opaque, it is kept on the heap with what the thread runs
+	BenchThread* thread = malloc(sizeof(*thread));
+	if (!thread)
+		return 0;
+
+	thread->run = run;
+	thread->user = user;
+	if (pthread_create(&thread->thread, NULL, benchThread, thread) != 0)
+	{
+		free(thread);
+		return 0;
+	}
+	return (intptr_t)thread;
+}
+
+void _joinBenchThread(intptr_t thread)
+{
+	BenchThread* bench = (BenchThread*)thread;
+	pthread_join(bench->thread, NULL);
+	free(bench);
+}
+
+void _removeBenchExport(const char* name)
+{
+	shm_unlink(name);
+}
+
+// Every file of a fake power_supply battery, energy_now is the only one rewritten
+static const char* const benchAttrs[] =
+{
+	"type", "status", "energy_full", "energy_full_design", "energy_now",
+	"power_now", "voltage_now", "serial_number", "model_name", "manufacturer",
+};
+
+// Where sysfsBatteryRoot pointed before the first fake batteries
+static const char* benchRealRoot = NULL;
+
+static bool writeBenchAttr(const char* dir, const char* attr, const char* text)
+{
+	char path[PATH_MAX];
+	if (snprintf(path, sizeof(path), "%s/%s", dir, attr) >= (int)sizeof(path))
+		return false;
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+	bool ok = write(fd, text, strlen(text)) == (ssize_t)strlen(text);
+	close(fd);
+	return ok;
+}
+
+const struct BatteryProvider* _writeBenchBatteries(const char* dir, uint32_t count, uint32_t charge)
+{
+	// The backend keeps 9 attributes of every battery open
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+		return NULL;
+
+	// A charger next to the batteries, enumerate has to skip it
+	char path[PATH_MAX];
+	char text[32];
+	snprintf(path, sizeof(path), "%s/AC", dir);
+	if (mkdir(path, 0755) == 0 && !writeBenchAttr(path, "type", "Mains\n"))
+		return NULL;
+
+	for (uint32_t k = 0; k < count; k++)
+	{
+		if (snprintf(path, sizeof(path), "%s/BAT%u", dir, k) >= (int)sizeof(path))
+			return NULL;
+
+		// Only a new battery gets the attributes that never change
+		bool ok = true;
+		if (mkdir(path, 0755) == 0)
+		{
+			ok &= writeBenchAttr(path, "type", "Battery\n") && writeBenchAttr(path, "status", "Discharging\n");
+			ok &= writeBenchAttr(path, "energy_full", "50000000\n") && writeBenchAttr(path, "energy_full_design", "52000000\n");
+			snprintf(text, sizeof(text), "%u\n", (5000 + k) * 1000);
+			ok &= writeBenchAttr(path, "power_now", text);
+			snprintf(text, sizeof(text), "%u\n", (11000 + k) * 1000);
+			ok &= writeBenchAttr(path, "voltage_now", text);
+			snprintf(text, sizeof(text), "BENCH%u\n", k);
+			ok &= writeBenchAttr(path, "serial_number", text) && writeBenchAttr(path, "model_name", "Bench\n");
+			ok &= writeBenchAttr(path, "manufacturer", "BatteryInfo\n");
+		}
+		snprintf(text, sizeof(text), "%llu\n", (unsigned long long)(charge + k) * 1000);
+		if (!ok || !writeBenchAttr(path, "energy_now", text))
+			return NULL;
+	}
+
+	if (!benchRealRoot)
+		benchRealRoot = sysfsBatteryRoot;
+	sysfsBatteryRoot = dir;
+	return &sysfsBatteryProvider;
+}
+
+void _removeBenchBatteries(const char* dir, uint32_t count)
+{
+	char path[PATH_MAX];
+	for (uint32_t k = 0; k < count; k++)
+	{
+		for (uint32_t i = 0; i < sizeof(benchAttrs) / sizeof(benchAttrs[0]); i++)
+		{
+			snprintf(path, sizeof(path), "%s/BAT%u/%s", dir, k, benchAttrs[i]);
+			unlink(path);
+		}
+		snprintf(path, sizeof(path), "%s/BAT%u", dir, k);
+		rmdir(path);
+	}
+
+	snprintf(path, sizeof(path), "%s/AC/type", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/AC", dir);
+	rmdir(path);
+	rmdir(dir);
+
+	if (benchRealRoot)
+		sysfsBatteryRoot = benchRealRoot;
+}
+
+#endif
\ No newline at end of file
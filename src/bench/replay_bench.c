@@ -0,0 +1,291 @@
+#include "bench.h"
+#include "../battery/trace.h"
+#include "../battery/store.h"
+#include "../softdraw/util.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Written next to the widget and removed again
+#define REPLAY_BENCH_PATH "BatteryInfo.bench.trc"
+
+// 8 hours of 1 Hz polls, enumerating again every 10 minutes like device notifications would
+#define REPLAY_BENCH_POLLS (8 * 3600)
+#define REPLAY_BENCH_RESCAN 600
+// Plugged in for the last two hours
+#define REPLAY_BENCH_PLUG (6 * 3600)
+// The second pack is pulled, a new one goes in 10 minutes later, and a third battery arrives
+#define REPLAY_BENCH_PULL (3 * 3600)
+#define REPLAY_BENCH_SWAP (REPLAY_BENCH_PULL + 600)
+#define REPLAY_BENCH_ARRIVE (4 * 3600)
+#define REPLAY_BENCH_BATTERIES 3
+
+// A 1 s trace of 10 ms polls replayed at 10x
+#define REPLAY_BENCH_CLOCK_POLLS 100
+#define REPLAY_BENCH_CLOCK_MS 10
+#define REPLAY_BENCH_SPEED 10
+
+typedef struct ReplayFields
+{
+	uint32_t tag;
+	uint32_t charge;
+	uint32_t capacity;
+	uint32_t wear;
+	int32_t rate;
+	uint32_t voltage;
+	uint8_t isCharging;
+} ReplayFields;
+
+// What every battery read in one poll, in array order
+typedef struct ReplayPoll
+{
+	uint32_t count;
+	ReplayFields batteries[REPLAY_BENCH_BATTERIES];
+} ReplayPoll;
+
+// Seconds into the synthetic day, every read is a function of it
+static uint64_t syntheticTick;
+
+static bool syntheticPulled(uint32_t id)
+{
+	return id == 1 && syntheticTick >= REPLAY_BENCH_PULL && syntheticTick < REPLAY_BENCH_SWAP;
+}
+
+static bool syntheticEnumerate(BatteryPath_array* paths)
+{
+	bool ok = pushBatteryPath(paths, "synthetic0") && pushBatteryPath(paths, "synthetic1");
+	if (syntheticTick >= REPLAY_BENCH_ARRIVE)
+		ok &= pushBatteryPath(paths, "synthetic2");
+	return ok;
+}
+
+static bool syntheticOpen(BatteryInfo* battery, const char* path)
+{
+	// The handle is the id plus one
+	battery->handle = (void*)(uintptr_t)(path[strlen(path) - 1] - '0' + 1);
+	return true;
+}
+
+static void syntheticReadStatic(BatteryInfo* battery)
+{
+	uint32_t id = (uint32_t)(uintptr_t)battery->handle - 1;
+	battery->capacity = id == 1 && syntheticTick >= REPLAY_BENCH_SWAP ? 40000 : 50000;
+	battery->wear = 4000 + id;
+}
+
+// A noisy discharge, then charging
+static void syntheticReadDynamic(BatteryInfo* battery)
+{
+	uint32_t id = (uint32_t)(uintptr_t)battery->handle - 1;
+	if (syntheticPulled(id))
+	{
+		battery->tag = 0;
+		battery->charge = 0;
+		battery->isCharging = false;
+		battery->rate = 0;
+		battery->voltage = 0;
+		return;
+	}
+
+	bool plugged = syntheticTick > REPLAY_BENCH_PLUG;
+	battery->tag = 1 + id * 2 + (id == 1 && syntheticTick >= REPLAY_BENCH_SWAP);
+	battery->isCharging = plugged;
+	battery->charge = plugged ? (uint32_t)(20000 + (syntheticTick - REPLAY_BENCH_PLUG) * 3) :
+		(uint32_t)(48000 - syntheticTick * 13 / 10 - id * 100);
+	battery->rate = plugged ? 10000 : -(int32_t)(4700 + syntheticTick * 7919 % 600);
+	battery->voltage = 11800 + (uint32_t)(syntheticTick % 50);
+}
+
+static void syntheticRelease(BatteryInfo* battery)
+{
+	memset(battery, 0, sizeof(*battery));
+}
+
+static const BatteryProvider syntheticBatteryProvider =
+{
+	.name = "synthetic",
+	.enumerate = syntheticEnumerate,
+	.open = syntheticOpen,
+	.readStatic = syntheticReadStatic,
+	.readDynamic = syntheticReadDynamic,
+	.release = syntheticRelease,
+};
+
+static void keepPoll(ReplayPoll* poll, const BatteryInfo_array* batteries)
+{
+	memset(poll, 0, sizeof(*poll));
+	poll->count = (uint32_t)batteries->length;
+	for (uint32_t i = 0; i < batteries->length && i < REPLAY_BENCH_BATTERIES; i++)
+	{
+		const BatteryInfo* battery = &batteries->data[i];
+		poll->batteries[i] = (ReplayFields){
+			.tag = battery->tag,
+			.charge = battery->charge,
+			.capacity = battery->capacity,
+			.wear = battery->wear,
+			.rate = battery->rate,
+			.voltage = battery->voltage,
+			.isCharging = battery->isCharging,
+		};
+	}
+}
+
+// Records the synthetic day, keeping what every poll read to check the replay against
+static bool recordDay(ReplayPoll* polls)
+{
+	syntheticTick = 0;
+	if (!startBatteryRecording(&syntheticBatteryProvider, REPLAY_BENCH_PATH))
+		return false;
+
+	BatteryInfo_array batteries = getBatteries(&recordingBatteryProvider);
+	for (syntheticTick = 1; syntheticTick <= REPLAY_BENCH_POLLS; syntheticTick++)
+	{
+		if (syntheticTick % REPLAY_BENCH_RESCAN == 0)
+			rescanBatteries(&batteries, &recordingBatteryProvider);
+		updateBatteries(&batteries, NULL);
+		keepPoll(&polls[syntheticTick - 1], &batteries);
+	}
+
+	releaseBatteries(&batteries);
+	stopBatteryRecording();
+	return true;
+}
+
+// Steps through the trace making the same calls, every poll has to read back what was recorded
+static bool replayDay(const ReplayPoll* polls)
+{
+	if (!openBatteryReplay(REPLAY_BENCH_PATH, 0))
+		return false;
+
+	BatteryInfo_array batteries = getBatteries(&replayBatteryProvider);
+	uint64_t wrong = 0;
+	uint64_t count = 0;
+	for (; count < REPLAY_BENCH_POLLS && !batteryReplayEnded(); count++)
+	{
+		if ((count + 1) % REPLAY_BENCH_RESCAN == 0)
+			rescanBatteries(&batteries, &replayBatteryProvider);
+		updateBatteries(&batteries, NULL);
+
+		ReplayPoll poll;
+		keepPoll(&poll, &batteries);
+		wrong += memcmp(&poll, &polls[count], sizeof(poll)) != 0;
+	}
+
+	releaseBatteries(&batteries);
+	closeBatteryReplay();
+
+	printf("  %llu of %llu replayed polls differ from the recording\n", (unsigned long long)wrong, (unsigned long long)count);
+	return !wrong && count == REPLAY_BENCH_POLLS;
+}
+
+// The widget's work per poll, the way --replay <trace> 0 drives it as fast as it can
+static double timeReplay(uint64_t* redraws)
+{
+	if (!openBatteryReplay(REPLAY_BENCH_PATH, 0))
+		return 0;
+
+	uint64_t start = sft_timer_now();
+	BatteryStore store = { 0 };
+	BatteryInfo_array batteries = getBatteries(&replayBatteryProvider);
+	storeBatteries(&store, &batteries);
+
+	char text[32];
+	volatile uint32_t sink = 0;
+	for (uint64_t poll = 1; !batteryReplayEnded(); poll++)
+	{
+		if (poll % REPLAY_BENCH_RESCAN == 0 && rescanBatteries(&batteries, &replayBatteryProvider))
+			storeBatteries(&store, &batteries);
+		bool changed = updateBatteries(&batteries, &store);
+		feedBatteryEstimators(&batteries, poll * 1000);
+
+		if (changed && store.totals.capacity)
+		{
+			(*redraws)++;
+			BatteryEstimate estimate = estimateBatteries(&batteries);
+			sink += sft_strfFixed(text, (uint32_t)(store.totals.charge * 10000 / store.totals.capacity), 2, 6);
+			if (estimate.valid)
+				sink += sft_strfUint(text, (uint32_t)estimate.minutes, 4);
+		}
+	}
+	uint64_t elapsed = sft_timer_now() - start;
+
+	releaseBatteries(&batteries);
+	freeBatteryStore(&store);
+	closeBatteryReplay();
+	return elapsed / 1000000.0;
+}
+
+// Replays at a speed have to follow the recorded clock, not the poll rate
+static bool checkClock()
+{
+	syntheticTick = 0;
+	if (!startBatteryRecording(&syntheticBatteryProvider, REPLAY_BENCH_PATH))
+		return false;
+	BatteryInfo_array batteries = getBatteries(&recordingBatteryProvider);
+	for (syntheticTick = 1; syntheticTick <= REPLAY_BENCH_CLOCK_POLLS; syntheticTick++)
+	{
+		sft_sleep(REPLAY_BENCH_CLOCK_MS);
+		updateBatteries(&batteries, NULL);
+	}
+	releaseBatteries(&batteries);
+	stopBatteryRecording();
+
+	if (!openBatteryReplay(REPLAY_BENCH_PATH, REPLAY_BENCH_SPEED))
+		return false;
+	uint64_t start = sft_timer_now();
+	batteries = getBatteries(&replayBatteryProvider);
+	while (!batteryReplayEnded() && sft_timer_now() - start < sft_toNANOSEC(1000))
+	{
+		updateBatteries(&batteries, NULL);
+		sft_sleep(1);
+	}
+	double elapsed = (sft_timer_now() - start) / 1000000.0;
+	releaseBatteries(&batteries);
+	closeBatteryReplay();
+
+	double expected = (double)REPLAY_BENCH_CLOCK_POLLS * REPLAY_BENCH_CLOCK_MS / REPLAY_BENCH_SPEED;
+	printf("  a %u ms trace at %ux ended after %.0f ms, %.0f ms expected\n", REPLAY_BENCH_CLOCK_POLLS * REPLAY_BENCH_CLOCK_MS,
+		REPLAY_BENCH_SPEED, elapsed, expected);
+	// Sleeps overshoot, but the trace may neither end early nor fall behind by much
+	return elapsed >= expected * 0.9 && elapsed <= expected * 2;
+}
+
+bool benchReplay()
+{
+	ReplayPoll* polls = malloc(sizeof(ReplayPoll) * REPLAY_BENCH_POLLS);
+	if (!polls || !recordDay(polls))
+	{
+		printf("  Could not record %s\n", REPLAY_BENCH_PATH);
+		free(polls);
+		return false;
+	}
+
+	uint64_t reads = 0;
+	for (uint32_t i = 0; i < REPLAY_BENCH_POLLS; i++)
+		reads += polls[i].count;
+
+	FILE* file = fopen(REPLAY_BENCH_PATH, "rb");
+	long size = 0;
+	if (file)
+	{
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		fclose(file);
+	}
+	printf("  8 h of 1 Hz polls with a pack swap and a hot-plug: %ld bytes, %.1f per battery read\n",
+		size, reads ? (double)size / reads : 0);
+
+	bool passed = replayDay(polls);
+	free(polls);
+
+	uint64_t redraws = 0;
+	double ms = timeReplay(&redraws);
+	printf("  stepped with the store, estimates and text: %.1f ms, %.2f us per poll, %llu redraws\n",
+		ms, ms * 1000 / REPLAY_BENCH_POLLS, (unsigned long long)redraws);
+
+	passed &= checkClock();
+	remove(REPLAY_BENCH_PATH);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "bench.h"
+#include "../battery/store.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A fleet far past any laptop, so a pass streams from memory instead of cache
+#define STORE_BENCH_BATTERIES 100000
+#define STORE_BENCH_UPDATES 2000
+#define STORE_BENCH_ROUNDS 301
+
+typedef struct StoreTimes
+{
+	uint64_t aos[STORE_BENCH_ROUNDS];
+	uint64_t soa[STORE_BENCH_ROUNDS];
+	uint64_t update[STORE_BENCH_ROUNDS];
+} StoreTimes;
+
+// The same five totals from the batteries themselves, the layout the store replaces
+static BatteryTotals sumBatteries(const BatteryInfo_array* batteries)
+{
+	BatteryTotals totals = { 0 };
+	for (uint64_t i = 0; i < batteries->length; i++)
+	{
+		const BatteryInfo* battery = &batteries->data[i];
+		totals.charge += battery->charge;
+		totals.capacity += battery->capacity;
+		totals.wear += battery->wear;
+		totals.present += battery->tag != 0;
+		totals.charging += battery->isCharging != 0;
+	}
+	return totals;
+}
+
+static void randomBattery(BatteryInfo* battery, uint64_t* state)
+{
+	battery->tag = benchRandom(state) % 8 ? 1 : 0;
+	battery->charge = (uint32_t)benchRandom(state);
+	battery->capacity = (uint32_t)benchRandom(state);
+	battery->wear = (uint32_t)(benchRandom(state) % 100000);
+	battery->isCharging = benchRandom(state) & 1;
+}
+
+// The running totals, a sum of the arrays and a sum of the batteries have to agree
+static bool checkTotals(const char* after, const BatteryStore* store, const BatteryInfo_array* batteries)
+{
+	BatteryTotals summed = sumBatteryStore(store);
+	BatteryTotals expected = sumBatteries(batteries);
+	if (memcmp(&store->totals, &expected, sizeof(expected)) == 0 && memcmp(&summed, &expected, sizeof(expected)) == 0)
+		return true;
+
+	printf("  Totals disagree after %s: %llu mWh kept, %llu summed, %llu from the batteries\n", after,
+		(unsigned long long)store->totals.charge, (unsigned long long)summed.charge, (unsigned long long)expected.charge);
+	return false;
+}
+
+static int compareNs(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static double medianUs(uint64_t* ns)
+{
+	qsort(ns, STORE_BENCH_ROUNDS, sizeof(*ns), compareNs);
+	return ns[STORE_BENCH_ROUNDS / 2] / 1000.0;
+}
+
+bool benchStore()
+{
+	BatteryInfo_array batteries = { .length = STORE_BENCH_BATTERIES, ._max = STORE_BENCH_BATTERIES };
+	batteries.data = calloc(STORE_BENCH_BATTERIES, sizeof(BatteryInfo));
+	StoreTimes* times = malloc(sizeof(StoreTimes));
+	BatteryStore store = { 0 };
+	if (!batteries.data || !times)
+	{
+		free(batteries.data);
+		free(times);
+		return false;
+	}
+
+	uint64_t state = 3;
+	for (uint64_t i = 0; i < STORE_BENCH_BATTERIES; i++)
+		randomBattery(&batteries.data[i], &state);
+	if (!storeBatteries(&store, &batteries))
+	{
+		free(batteries.data);
+		free(times);
+		return false;
+	}
+	bool passed = checkTotals("the first mirror", &store, &batteries);
+
+	for (uint32_t i = 0; i < STORE_BENCH_UPDATES; i++)
+	{
+		uint64_t index = benchRandom(&state) % STORE_BENCH_BATTERIES;
+		randomBattery(&batteries.data[index], &state);
+		setStoredBattery(&store, index, &batteries.data[index]);
+	}
+	passed &= checkTotals("random updates", &store, &batteries);
+
+	// Rescans shrink and grow the store, and the vector loops have tails of every length
+	batteries.length = STORE_BENCH_BATTERIES - 777;
+	passed &= storeBatteries(&store, &batteries) && checkTotals("a shrink", &store, &batteries);
+	batteries.length = STORE_BENCH_BATTERIES;
+	passed &= storeBatteries(&store, &batteries) && checkTotals("a grow", &store, &batteries);
+
+	for (uint64_t length = 0; length <= 66; length++)
+	{
+		BatteryInfo_array few = batteries;
+		few.length = length;
+		BatteryStore small = { 0 };
+		passed &= storeBatteries(&small, &few) && checkTotals("mirroring a few batteries", &small, &few);
+		freeBatteryStore(&small);
+	}
+	if (passed)
+		printf("  Kept, summed and per-battery totals agree after %u updates, a shrink, a grow and 0 to 66 batteries\n",
+			STORE_BENCH_UPDATES);
+
+	volatile uint64_t sink = 0;
+	for (uint32_t r = 0; r < STORE_BENCH_ROUNDS; r++)
+	{
+		uint64_t start = sft_timer_now();
+		sink += sumBatteries(&batteries).charge;
+		times->aos[r] = sft_timer_now() - start;
+
+		start = sft_timer_now();
+		sink += sumBatteryStore(&store).charge;
+		times->soa[r] = sft_timer_now() - start;
+
+		uint64_t index = benchRandom(&state) % STORE_BENCH_BATTERIES;
+		start = sft_timer_now();
+		batteries.data[index].charge++;
+		setStoredBattery(&store, index, &batteries.data[index]);
+		sink += store.totals.charge;
+		times->update[r] = sft_timer_now() - start;
+	}
+
+	printf("  %u batteries, %llu bytes each, median of %u:\n", STORE_BENCH_BATTERIES,
+		(unsigned long long)sizeof(BatteryInfo), STORE_BENCH_ROUNDS);
+	printf("  sum over BatteryInfo  %8.1f us\n", medianUs(times->aos));
+	printf("  sumBatteryStore       %8.1f us\n", medianUs(times->soa));
+	printf("  one setStoredBattery  %8.3f us\n", medianUs(times->update));
+
+	freeBatteryStore(&store);
+	free(batteries.data);
+	free(times);
+	return passed;
+}
\ No newline at end of file
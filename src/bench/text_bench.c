@@ -0,0 +1,135 @@
+#include "bench.h"
+#include "../softdraw/image/image.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEXT_BENCH_VALUES 2000000
+#define TEXT_BENCH_CALLS 200000
+
+// Hundredths of a percent rounded half to even, the way draw() feeds sft_strfFixed
+static uint32_t percentHundredths(uint64_t charge, uint64_t capacity)
+{
+	uint64_t scaled = charge * 10000;
+	uint32_t hundredths = (uint32_t)(scaled / capacity);
+	uint64_t twice = scaled % capacity * 2;
+	if (twice > capacity || (twice == capacity && (hundredths & 1)))
+		hundredths++;
+	return hundredths;
+}
+
+// The formatters have to write what printf does for every value and width draw() uses
+static bool checkFormatters()
+{
+	char expected[32];
+	char actual[32];
+	uint64_t wrong = 0;
+	uint64_t ties = 0;
+
+	uint64_t state = 1;
+	for (uint32_t i = 0; i < TEXT_BENCH_VALUES; i++)
+	{
+		// Shifted so every number of digits comes up
+		uint32_t value = (uint32_t)benchRandom(&state) >> (i % 32);
+		uint32_t width = i % 12;
+		snprintf(expected, sizeof(expected), "%*u", (int)width, value);
+		sft_strfUint(actual, value, width);
+		wrong += strcmp(expected, actual) != 0;
+
+		uint32_t capacity = 1 + (uint32_t)(benchRandom(&state) % 200000);
+		uint32_t charge = (uint32_t)(benchRandom(&state) % (capacity + 1));
+		uint32_t hundredths = percentHundredths(charge, capacity);
+		// printf rounds the nearest double, which lands on either side of an exact tie, those have to round to even
+		if ((uint64_t)charge * 10000 % capacity * 2 == capacity)
+		{
+			ties++;
+			wrong += hundredths & 1;
+			continue;
+		}
+		snprintf(expected, sizeof(expected), "%6.2f", charge * 100.0 / capacity);
+		sft_strfFixed(actual, hundredths, 2, 6);
+		wrong += strcmp(expected, actual) != 0;
+	}
+
+	printf("  sft_strfUint and sft_strfFixed against printf: %llu of %u values differ, %llu exact ties\n",
+		(unsigned long long)wrong, 2 * TEXT_BENCH_VALUES, (unsigned long long)ties);
+	return !wrong;
+}
+
+static double nsPerCall(uint64_t start)
+{
+	return (double)(sft_timer_now() - start) / TEXT_BENCH_CALLS;
+}
+
+bool benchText()
+{
+	bool passed = checkFormatters();
+
+	char text[32];
+	volatile uint32_t sink = 0;
+
+	uint64_t start = sft_timer_now();
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+		sink += snprintf(text, sizeof(text), "%10u", 52340 + i);
+	double printfUint = nsPerCall(start);
+
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+		sink += sft_strfUint(text, 52340 + i, 10);
+	printf("  \"%%10u\"     snprintf %6.1f ns, sft_strfUint  %6.1f ns\n", printfUint, nsPerCall(start));
+
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+		sink += snprintf(text, sizeof(text), "%6.2f%%", 73.45f + i % 7);
+	double printfFixed = nsPerCall(start);
+
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+		sink += sft_strfFixed(text, 7345 + i % 7, 2, 6);
+	printf("  \"%%6.2f%%%%\"   snprintf %6.1f ns, sft_strfFixed %6.1f ns\n", printfFixed, nsPerCall(start));
+
+	// A frame of the widget is a formatted line drawn into the framebuffer
+	sft_image* image = sft_image_create(222, 32);
+	if (!image)
+		return false;
+
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+		sft_image_drawTextF(image, 0, 8, 3, 0xFFFFFFFF, "%6.2f%%", 73.45f + i % 7);
+	double drawTextF = nsPerCall(start);
+
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+	{
+		uint32_t len = sft_strfFixed(text, 7345 + i % 7, 2, 6);
+		text[len] = '%';
+		text[len + 1] = '\0';
+		sft_image_drawText(image, text, 0, 8, 3, 0xFFFFFFFF);
+	}
+	printf("  frame line  drawTextF %6.1f ns, sft_strfFixed and drawText %6.1f ns\n", drawTextF, nsPerCall(start));
+
+	// sft_strfBuf hands back the caller buffer unless it went to the heap, which is how allocations are counted
+	uint64_t heap = 0;
+	char stack[sft_STRF_STACK];
+	for (uint32_t i = 0; i < TEXT_BENCH_CALLS; i++)
+	{
+		char* str = sft_strfBuf(stack, sizeof(stack), "%6.2f%%", 73.45f + i % 7);
+		heap += str != stack;
+		sft_strfFree(str, stack);
+	}
+
+	char oversized[sft_STRF_STACK + 64];
+	memset(oversized, 'a', sizeof(oversized) - 1);
+	oversized[sizeof(oversized) - 1] = '\0';
+	char* str = sft_strfBuf(stack, sizeof(stack), "%s", oversized);
+	bool spilled = str && str != stack && strcmp(str, oversized) == 0;
+	sft_strfFree(str, stack);
+
+	printf("  %llu heap allocations in %u frame lines, a %u byte string %s\n", (unsigned long long)heap,
+		TEXT_BENCH_CALLS, (uint32_t)sizeof(oversized) - 1, spilled ? "went to the heap whole" : "was not formatted right");
+	passed &= !heap && spilled;
+
+	sft_image_delete(image);
+	return passed;
+}
\ No newline at end of file
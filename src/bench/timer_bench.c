@@ -0,0 +1,167 @@
+#include "bench.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TIMER_BENCH_VALUES 4096
+#define TIMER_BENCH_PASSES 2000
+#define TIMER_BENCH_RANDOM 1000000
+
+// Performance counter rates seen in the wild: the ACPI PM timer, the usual 10 MHz,
+// an ARM generic timer, and TSCs exposed at 1 to 3 GHz
+static const uint64_t counterRates[] = { 3579545, 10000000, 24000000, 1000000000, 2400000000ull, 3000000000ull };
+
+// Uptimes the widget lives through, a second to ten years
+static const uint64_t uptimes[] = { 1, 3600, 86400, 7 * 86400ull, 30 * 86400ull, 365 * 86400ull, 3650 * 86400ull };
+static const char* const uptimeNames[] = { "1 s", "1 h", "1 day", "1 week", "30 days", "1 year", "10 years" };
+
+typedef struct Wide
+{
+	uint64_t hi;
+	uint64_t lo;
+} Wide;
+
+// 64 x 64 bit product in 32 bit halves, no compiler 128 bit type needed
+static Wide wideMul(uint64_t a, uint64_t b)
+{
+	uint64_t aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+	uint64_t bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+
+	uint64_t lo = aLo * bLo;
+	uint64_t mid1 = aHi * bLo;
+	uint64_t mid2 = aLo * bHi;
+	uint64_t mid = (lo >> 32) + (mid1 & 0xFFFFFFFF) + (mid2 & 0xFFFFFFFF);
+
+	Wide product;
+	product.lo = (mid << 32) | (lo & 0xFFFFFFFF);
+	product.hi = aHi * bHi + (mid1 >> 32) + (mid2 >> 32) + (mid >> 32);
+	return product;
+}
+
+// Long division a bit at a time, returns false when the quotient does not fit in 64 bits
+static bool wideDiv(Wide n, uint64_t div, uint64_t* quotient)
+{
+	if (n.hi >= div)
+		return false;
+
+	uint64_t rem = n.hi;
+	uint64_t q = 0;
+	for (int32_t bit = 63; bit >= 0; bit--)
+	{
+		uint64_t carry = rem >> 63;
+		rem = (rem << 1) | ((n.lo >> bit) & 1);
+		q <<= 1;
+		if (carry || rem >= div)
+		{
+			rem -= div;
+			q |= 1;
+		}
+	}
+	*quotient = q;
+	return true;
+}
+
+// sft_timer_mulDiv against the exact 128 bit result, returns false on the first mismatch
+static bool checkMulDiv(uint64_t value, uint64_t mul, uint64_t div)
+{
+	uint64_t expected;
+	if (!wideDiv(wideMul(value, mul), div, &expected))
+		return true;
+
+	uint64_t actual = sft_timer_mulDiv(value, mul, div);
+	if (actual == expected)
+		return true;
+
+	printf("  mulDiv(%llu, %llu, %llu) = %llu, %llu expected\n", (unsigned long long)value, (unsigned long long)mul,
+		(unsigned long long)div, (unsigned long long)actual, (unsigned long long)expected);
+	return false;
+}
+
+// Ticks of every counter rate after every uptime, give or take a tick, converted to nanoseconds
+static bool checkUptimes()
+{
+	bool passed = true;
+	for (uint32_t r = 0; r < sizeof(counterRates) / sizeof(counterRates[0]); r++)
+	{
+		uint64_t rate = counterRates[r];
+		for (uint32_t u = 0; u < sizeof(uptimes) / sizeof(uptimes[0]); u++)
+		{
+			uint64_t ticks = uptimes[u] * rate;
+			passed &= checkMulDiv(ticks - 1, 1000000000ull, rate) && checkMulDiv(ticks, 1000000000ull, rate) &&
+				checkMulDiv(ticks + 1, 1000000000ull, rate);
+		}
+
+		// How long the plain ticks * 1e9 / rate would have lasted
+		uint64_t naiveSeconds = UINT64_MAX / 1000000000ull / rate;
+		uint32_t u = 0;
+		while (u < sizeof(uptimes) / sizeof(uptimes[0]) && uptimes[u] <= naiveSeconds)
+			u++;
+		printf("  %10llu Hz: ticks * 1e9 overflows after %llu s, before %s of uptime\n", (unsigned long long)rate,
+			(unsigned long long)naiveSeconds, u < sizeof(uptimes) / sizeof(uptimes[0]) ? uptimeNames[u] : "10 years");
+	}
+
+	// Anything at all within the documented limit of (div - 1) * mul fitting in 64 bits
+	uint64_t state = 5;
+	uint64_t random = 0;
+	for (; random < TIMER_BENCH_RANDOM && passed; random++)
+	{
+		uint64_t div = 1 + benchRandom(&state) % 20000000000ull;
+		uint64_t mul = 1 + benchRandom(&state) % (UINT64_MAX / div);
+		passed &= checkMulDiv(benchRandom(&state), mul, div);
+	}
+	if (passed)
+		printf("  Exact against a 128 bit reference at every rate and uptime, and over %llu random operands\n",
+			(unsigned long long)random);
+	return passed;
+}
+
+bool benchTimer()
+{
+	bool passed = checkUptimes();
+
+	uint64_t* values = malloc(sizeof(uint64_t) * TIMER_BENCH_VALUES);
+	if (!values)
+		return false;
+
+	// Counter readings anywhere in a month of uptime at 10 MHz
+	uint64_t state = 9;
+	for (uint32_t i = 0; i < TIMER_BENCH_VALUES; i++)
+		values[i] = benchRandom(&state) % (30 * 86400ull * 10000000);
+
+	// Read back so the divisor is not a constant the compiler can turn into a multiply
+	volatile uint64_t rate = 10000000;
+	uint64_t div = rate;
+	volatile uint64_t sink = 0;
+
+	uint64_t start = sft_timer_now();
+	for (uint32_t p = 0; p < TIMER_BENCH_PASSES; p++)
+	{
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < TIMER_BENCH_VALUES; i++)
+			sum += sft_timer_mulDiv(values[i], 1000000000ull, div);
+		sink += sum;
+	}
+	double mulDivNs = (double)(sft_timer_now() - start) / ((uint64_t)TIMER_BENCH_PASSES * TIMER_BENCH_VALUES);
+
+	start = sft_timer_now();
+	for (uint32_t p = 0; p < TIMER_BENCH_PASSES; p++)
+	{
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < TIMER_BENCH_VALUES; i++)
+			sum += values[i] / div;
+		sink += sum;
+	}
+	double divideNs = (double)(sft_timer_now() - start) / ((uint64_t)TIMER_BENCH_PASSES * TIMER_BENCH_VALUES);
+
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < TIMER_BENCH_PASSES * 100; i++)
+		sink += sft_timer_now();
+	double nowNs = (double)(sft_timer_now() - start) / (TIMER_BENCH_PASSES * 100);
+
+	printf("  sft_timer_mulDiv %6.2f ns/call, a lone 64 bit divide %6.2f ns, sft_timer_now %6.2f ns/call\n",
+		mulDivNs, divideNs, nowNs);
+
+	free(values);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "bench.h"
+#include "../softdraw/widget/widget.h"
+#include "../softdraw/timer/timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// A full HD root split into 8 x 8 panels of 64 buttons, some hanging out of their panel or the root
+#define UI_BENCH_WIDTH 1920
+#define UI_BENCH_HEIGHT 1080
+#define UI_BENCH_PANELS 8
+#define UI_BENCH_BUTTONS 64
+// Large overlays added last, on top of everything under them
+#define UI_BENCH_OVERLAYS 16
+#define UI_BENCH_MOVED 500
+
+#define UI_BENCH_POINTS 100000
+#define UI_BENCH_MOVES 100000
+
+// Events the callbacks got, by sft_widgetEvent
+static uint64_t uiEvents[sft_widgetEvent_click + 1];
+
+static void countEvent(sft_ui* ui, sft_widgetId id, sft_widgetEvent event)
+{
+	uiEvents[event]++;
+}
+
+static sft_rect randomRect(uint64_t* state, uint32_t w, uint32_t h, uint32_t size)
+{
+	sft_rect rect;
+	rect.x = (int32_t)(benchRandom(state) % (w + 40)) - 20;
+	rect.y = (int32_t)(benchRandom(state) % (h + 40)) - 20;
+	rect.w = (uint32_t)(benchRandom(state) % size);
+	rect.h = (uint32_t)(benchRandom(state) % size);
+	return rect;
+}
+
+static bool buildUi(sft_ui* ui, uint64_t* state)
+{
+	uint32_t panelW = UI_BENCH_WIDTH / UI_BENCH_PANELS;
+	uint32_t panelH = UI_BENCH_HEIGHT / UI_BENCH_PANELS;
+	sft_ui_init(ui, UI_BENCH_WIDTH, UI_BENCH_HEIGHT);
+
+	bool ok = ui->count == 1;
+	for (uint32_t p = 0; p < UI_BENCH_PANELS * UI_BENCH_PANELS && ok; p++)
+	{
+		sft_rect rect = { (int32_t)(p % UI_BENCH_PANELS * panelW), (int32_t)(p / UI_BENCH_PANELS * panelH), panelW, panelH };
+		sft_widgetId panel = sft_ui_add(ui, 0, sft_widget_container, rect);
+		ok = panel != sft_widget_none;
+
+		for (uint32_t b = 0; b < UI_BENCH_BUTTONS && ok; b++)
+		{
+			// Every eighth is a label with a callback, those are hit like buttons. Plain labels are not
+			sft_widgetType type = b % 8 ? sft_widget_button : sft_widget_label;
+			sft_widgetId id = sft_ui_add(ui, panel, type, randomRect(state, panelW, panelH, 60));
+			ok = id != sft_widget_none;
+			if (ok && b % 16)
+				sft_ui_get(ui, id)->onEvent = countEvent;
+		}
+	}
+
+	for (uint32_t o = 0; o < UI_BENCH_OVERLAYS && ok; o++)
+	{
+		sft_widgetId id = sft_ui_add(ui, 0, sft_widget_button, randomRect(state, UI_BENCH_WIDTH, UI_BENCH_HEIGHT, 400));
+		ok = id != sft_widget_none;
+		if (ok)
+			sft_ui_get(ui, id)->onEvent = countEvent;
+	}
+	return ok;
+}
+
+// The topmost hit tested widget over pos by looking at every one, what the grid has to agree with
+static sft_widgetId linearHit(const sft_ui* ui, sft_point pos)
+{
+	sft_rect root = ui->widgets[0].bounds;
+	if (pos.x < root.x || pos.y < root.y || pos.x > root.x + (int64_t)root.w || pos.y > root.y + (int64_t)root.h)
+		return sft_widget_none;
+
+	for (uint32_t i = ui->count; i-- > 0;)
+	{
+		const sft_widget* widget = &ui->widgets[i];
+		sft_rect bounds = widget->bounds;
+		if ((widget->type == sft_widget_button || widget->onEvent) && pos.x >= bounds.x && pos.y >= bounds.y &&
+			pos.x <= bounds.x + (int64_t)bounds.w && pos.y <= bounds.y + (int64_t)bounds.h)
+			return (sft_widgetId)i;
+	}
+	return sft_widget_none;
+}
+
+// Anywhere on the root and a little past it
+static sft_point randomPoint(uint64_t* state)
+{
+	sft_point pos;
+	pos.x = (int32_t)(benchRandom(state) % (UI_BENCH_WIDTH + 21)) - 10;
+	pos.y = (int32_t)(benchRandom(state) % (UI_BENCH_HEIGHT + 21)) - 10;
+	return pos;
+}
+
+static uint64_t checkHits(sft_ui* ui, uint64_t* state, uint64_t* hits)
+{
+	uint64_t wrong = 0;
+	for (uint32_t i = 0; i < UI_BENCH_POINTS; i++)
+	{
+		sft_point pos = randomPoint(state);
+		sft_widgetId id = sft_ui_hitTest(ui, pos);
+		wrong += id != linearHit(ui, pos);
+		*hits += id != sft_widget_none;
+	}
+	return wrong;
+}
+
+typedef struct UiModel
+{
+	sft_widgetId hovered;
+	sft_widgetId pressed;
+	bool down;
+	uint64_t events[sft_widgetEvent_click + 1];
+} UiModel;
+
+// What dispatch has to do, from the linear hit test. Every hit tested widget here has a callback
+static sft_widgetId modelDispatch(UiModel* model, const sft_ui* ui, sft_point mouse, bool down)
+{
+	sft_widgetId hit = linearHit(ui, mouse);
+	sft_widgetId clicked = sft_widget_none;
+	bool called = hit != sft_widget_none && ui->widgets[hit].onEvent;
+	bool wasCalled = model->hovered != sft_widget_none && ui->widgets[model->hovered].onEvent;
+
+	if (hit != model->hovered)
+	{
+		model->events[sft_widgetEvent_leave] += wasCalled;
+		model->events[sft_widgetEvent_enter] += called;
+		model->hovered = hit;
+	}
+
+	if (down && !model->down)
+	{
+		model->pressed = hit;
+		model->events[sft_widgetEvent_press] += called;
+	}
+	else if (!down && model->down && model->pressed != sft_widget_none)
+	{
+		bool pressedCalled = ui->widgets[model->pressed].onEvent != NULL;
+		model->events[sft_widgetEvent_release] += pressedCalled;
+		if (hit == model->pressed)
+		{
+			clicked = hit;
+			model->events[sft_widgetEvent_click] += pressedCalled;
+		}
+		model->pressed = sft_widget_none;
+	}
+
+	model->down = down;
+	return clicked;
+}
+
+// A mouse wandering in small steps with the odd jump, pressing and releasing now and then
+static void nextMouse(uint64_t* state, sft_point* mouse, bool* down)
+{
+	uint64_t r = benchRandom(state);
+	if (r % 64 == 0)
+		*mouse = randomPoint(state);
+	else
+	{
+		mouse->x = (int32_t)sft_min(sft_max(mouse->x + (int32_t)(r >> 8 & 15) - 7, -10), UI_BENCH_WIDTH + 10);
+		mouse->y = (int32_t)sft_min(sft_max(mouse->y + (int32_t)(r >> 16 & 15) - 7, -10), UI_BENCH_HEIGHT + 10);
+	}
+	if (r % 8 == 1)
+		*down = !*down;
+}
+
+static bool checkDispatch(sft_ui* ui)
+{
+	UiModel model = { sft_widget_none, sft_widget_none, false };
+	memset(uiEvents, 0, sizeof(uiEvents));
+
+	uint64_t state = 21;
+	uint64_t wrong = 0;
+	uint64_t clicks = 0;
+	sft_point mouse = { UI_BENCH_WIDTH / 2, UI_BENCH_HEIGHT / 2 };
+	bool down = false;
+	for (uint32_t i = 0; i < UI_BENCH_MOVES; i++)
+	{
+		nextMouse(&state, &mouse, &down);
+		sft_widgetId clicked = sft_ui_dispatch(ui, mouse, down);
+		wrong += clicked != modelDispatch(&model, ui, mouse, down) || ui->hovered != model.hovered ||
+			ui->pressed != model.pressed;
+		clicks += clicked != sft_widget_none;
+	}
+
+	bool same = memcmp(uiEvents, model.events, sizeof(uiEvents)) == 0;
+	printf("  dispatch %llu of %u moves differ from the linear model, %llu clicks, %llu enters, events %s\n",
+		(unsigned long long)wrong, UI_BENCH_MOVES, (unsigned long long)clicks,
+		(unsigned long long)uiEvents[sft_widgetEvent_enter], same ? "match" : "DIFFER");
+	return !wrong && same;
+}
+
+static double timeHits(sft_ui* ui, bool grid)
+{
+	uint64_t state = 31;
+	volatile int64_t sink = 0;
+	uint64_t start = sft_timer_now();
+	for (uint32_t i = 0; i < UI_BENCH_POINTS; i++)
+	{
+		sft_point pos = randomPoint(&state);
+		sink += grid ? sft_ui_hitTest(ui, pos) : linearHit(ui, pos);
+	}
+	return (double)(sft_timer_now() - start) / UI_BENCH_POINTS;
+}
+
+bool benchUi()
+{
+	sft_ui ui;
+	uint64_t state = 17;
+	if (!buildUi(&ui, &state))
+	{
+		printf("  Could not build the ui\n");
+		sft_ui_free(&ui);
+		return false;
+	}
+
+	uint64_t start = sft_timer_now();
+	sft_ui_layout(&ui);
+	double layoutUs = (sft_timer_now() - start) / 1000.0;
+	printf("  %u widgets on a %ux%u root, %ux%u grid cells with %u entries, laid out in %.1f us\n", ui.count,
+		UI_BENCH_WIDTH, UI_BENCH_HEIGHT, ui._cols, ui._rows, ui._cellStart[ui._cols * ui._rows], layoutUs);
+
+	uint64_t hits = 0;
+	uint64_t wrong = checkHits(&ui, &state, &hits);
+
+	// Moved widgets have to leave their old cells and join new ones
+	for (uint32_t i = 0; i < UI_BENCH_MOVED; i++)
+	{
+		sft_widget* widget = sft_ui_get(&ui, 1 + (sft_widgetId)(benchRandom(&state) % (ui.count - 1)));
+		if (widget->type != sft_widget_container)
+			widget->rect = randomRect(&state, UI_BENCH_WIDTH / UI_BENCH_PANELS, UI_BENCH_HEIGHT / UI_BENCH_PANELS, 80);
+	}
+	sft_ui_relayout(&ui);
+	wrong += checkHits(&ui, &state, &hits);
+
+	printf("  hit test %llu of %u points differ from a linear scan, %llu hit a widget\n", (unsigned long long)wrong,
+		2 * UI_BENCH_POINTS, (unsigned long long)hits);
+	bool passed = !wrong && hits;
+	passed &= checkDispatch(&ui);
+
+	double gridNs = timeHits(&ui, true);
+	double linearNs = timeHits(&ui, false);
+
+	uint64_t mouseState = 41;
+	sft_point mouse = { UI_BENCH_WIDTH / 2, UI_BENCH_HEIGHT / 2 };
+	bool down = false;
+	start = sft_timer_now();
+	for (uint32_t i = 0; i < UI_BENCH_MOVES; i++)
+	{
+		nextMouse(&mouseState, &mouse, &down);
+		sft_ui_dispatch(&ui, mouse, down);
+	}
+	double dispatchNs = (double)(sft_timer_now() - start) / UI_BENCH_MOVES;
+
+	printf("  hit test %7.1f ns on the grid, %8.1f ns scanning, %5.0fx, dispatch %7.1f ns a move\n", gridNs, linearNs,
+		gridNs ? linearNs / gridNs : 0, dispatchNs);
+
+	sft_ui_free(&ui);
+	return passed;
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "bench.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <process.h>
+#include <stdlib.h>
+
+uint32_t _benchClientLimit(uint32_t wanted)
+{
+	// Handles are only limited by memory
+	return wanted;
+}
+
+intptr_t _connectBenchClient(const char* path, bool slow)
+{
+	// Fails with ERROR_PIPE_BUSY until the daemon created the next instance, the pipe sets the buffer sizes
+	HANDLE pipe = CreateFileA(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, 0, NULL);
+	return pipe == INVALID_HANDLE_VALUE ? -1 : (intptr_t)pipe;
+}
+
+int64_t _readBenchClient(intptr_t client, uint8_t* buf, uint64_t size)
+{
+	// ReadFile on a synchronous pipe would wait, only what is already there is read
+	DWORD available = 0;
+	if (!PeekNamedPipe((HANDLE)client, NULL, 0, NULL, &available, NULL))
+		return -1;
+	if (!available)
+		return 0;
+
+	DWORD got = 0;
+	DWORD want = available < size ? available : (DWORD)size;
+	if (!ReadFile((HANDLE)client, buf, want, &got, NULL))
+		return -1;
+	return got;
+}
+
+void _closeBenchClient(intptr_t client)
+{
+	CloseHandle((HANDLE)client);
+}
+
+typedef struct BenchThread
+{
+	HANDLE thread;
+	void (*run)(void* user);
+	void* user;
+} BenchThread;
+
+static unsigned __stdcall benchThread(void* arg)
+{
+	BenchThread* thread = arg;
+	thread->run(thread->user);
+	return 0;
+}
+
+intptr_t _startBenchThread(void (*run)(void* user), void* user)
+{
+	BenchThread* thread = malloc(sizeof(*thread));
+	if (!thread)
+		return 0;
+
+	thread->run = run;
+	thread->user = user;
+	// The thread uses the CRT, so it is started through it
+	thread->thread = (HANDLE)_beginthreadex(NULL, 0, benchThread, thread, 0, NULL);
+	if (!thread->thread)
+	{
+		free(thread);
+		return 0;
+	}
+	return (intptr_t)thread;
+}
+
+void _joinBenchThread(intptr_t thread)
+{
+	BenchThread* bench = (BenchThread*)thread;
+	WaitForSingleObject(bench->thread, INFINITE);
+	CloseHandle(bench->thread);
+	free(bench);
+}
+
+void _removeBenchExport(const char* name)
+{
+	// A mapping is gone once its last handle closed
+}
+
+const struct BatteryProvider* _writeBenchBatteries(const char* dir, uint32_t count, uint32_t charge)
+{
+	// SetupDi only lists real devices
+	return NULL;
+}
+
+void _removeBenchBatteries(const char* dir, uint32_t count)
+{
+}
+
+#endif
\ No newline at end of file
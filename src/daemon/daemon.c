@@ -0,0 +1,220 @@
+#include "daemon.h"
+#include "../softdraw/timer/timer.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static volatile sig_atomic_t daemonSignaled = 0;
+
+static void onDaemonSignal(int signal)
+{
+	daemonSignaled = 1;
+}
+
+bool daemonStopped()
+{
+	return daemonSignaled != 0;
+}
+
+bool openDaemon(Daemon* daemon, const char* path)
+{
+	memset(daemon, 0, sizeof(*daemon));
+
+	uint64_t len = strlen(path);
+	daemon->path = malloc(len + 1);
+	if (!daemon->path)
+		return false;
+	memcpy(daemon->path, path, len + 1);
+
+	if (!_listenDaemon(daemon))
+	{
+		free(daemon->path);
+		daemon->path = NULL;
+		return false;
+	}
+
+	signal(SIGINT, onDaemonSignal);
+	signal(SIGTERM, onDaemonSignal);
+	return true;
+}
+
+// Frees the clients the backends marked closed, returns how many are still waiting on I/O
+static uint32_t reapDaemonClients(Daemon* daemon)
+{
+	uint32_t pending = 0;
+
+	for (uint32_t i = 0; i < daemon->clientCount;)
+	{
+		DaemonClient* client = daemon->clients[i];
+		if (!client->closed)
+		{
+			i++;
+			continue;
+		}
+
+		if (!_closeDaemonClient(daemon, client))
+		{
+			pending++;
+			i++;
+			continue;
+		}
+
+		// Order does not matter, move the last one in
+		free(client);
+		daemon->clients[i] = daemon->clients[--daemon->clientCount];
+	}
+
+	return pending;
+}
+
+void closeDaemon(Daemon* daemon)
+{
+	for (uint32_t i = 0; i < daemon->clientCount; i++)
+		daemon->clients[i]->closed = true;
+
+	// Writes still in flight complete through the event loop, give them a second
+	for (uint32_t tries = 0; reapDaemonClients(daemon) && tries < 100; tries++)
+		_pollDaemon(daemon, 10);
+
+	_unlistenDaemon(daemon);
+
+	free(daemon->clients);
+	free(daemon->path);
+	memset(daemon, 0, sizeof(*daemon));
+}
+
+static void loadFrame(Daemon* daemon, DaemonClient* client, DaemonFrameType type)
+{
+	memcpy(client->frame, daemon->frame, daemon->frameLength);
+	uint16_t frameType = type;
+	memcpy(client->frame + offsetof(DaemonFrameHeader, type), &frameType, sizeof(frameType));
+	client->length = daemon->frameLength;
+	client->offset = 0;
+}
+
+void publishDaemon(Daemon* daemon, const BatteryInfo_array* batteries)
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	DaemonFrameHeader header = {
+		.type = DaemonFrame_update,
+		.seq = ++daemon->seq,
+		.time = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000,
+	};
+
+	uint8_t* record = daemon->frame + sizeof(header);
+	for (uint32_t i = 0; i < batteries->length && header.count < DAEMON_BATTERIES; i++)
+	{
+		const BatteryInfo* battery = &batteries->data[i];
+		DaemonBattery out = {
+			.tag = battery->tag,
+			.capacity = battery->capacity,
+			.charge = battery->charge,
+			.wear = battery->wear,
+			.rate = battery->rate,
+			.voltage = battery->voltage,
+			.isCharging = battery->isCharging,
+		};
+		memcpy(record, &out, sizeof(out));
+		record += sizeof(out);
+		header.count++;
+	}
+
+	daemon->frameLength = (uint32_t)(record - daemon->frame);
+	header.length = daemon->frameLength - sizeof(header.length);
+	// Stamped last so the latency includes the encode
+	header.publishNs = sft_timer_now();
+	memcpy(daemon->frame, &header, sizeof(header));
+
+	for (uint32_t i = 0; i < daemon->clientCount; i++)
+	{
+		DaemonClient* client = daemon->clients[i];
+		if (client->closed)
+			continue;
+
+		// A frame half written has to finish first, the newest one follows it
+		if (client->length)
+		{
+			// Already behind, the frame it was waiting for is replaced
+			if (client->stale)
+				daemon->coalesced++;
+			client->stale = true;
+			continue;
+		}
+
+		loadFrame(daemon, client, DaemonFrame_update);
+		_sendDaemon(daemon, client);
+	}
+}
+
+void serviceDaemon(Daemon* daemon, uint32_t ms)
+{
+	_pollDaemon(daemon, ms);
+	reapDaemonClients(daemon);
+}
+
+DaemonClient* _addDaemonClient(Daemon* daemon, intptr_t handle, void* io)
+{
+	if (daemon->clientCount >= daemon->_maxClients)
+	{
+		uint32_t max = daemon->_maxClients ? daemon->_maxClients * 2 : 16;
+		void* ptr = realloc(daemon->clients, sizeof(*daemon->clients) * max);
+		if (!ptr)
+			return NULL;
+
+		daemon->clients = ptr;
+		daemon->_maxClients = max;
+	}
+
+	DaemonClient* client = malloc(sizeof(*client));
+	if (!client)
+		return NULL;
+
+	memset(client, 0, sizeof(*client));
+	client->handle = handle;
+	client->io = io;
+	daemon->clients[daemon->clientCount++] = client;
+
+	if (daemon->frameLength)
+	{
+		loadFrame(daemon, client, DaemonFrame_snapshot);
+		_sendDaemon(daemon, client);
+	}
+	return client;
+}
+
+void _sentDaemonFrame(Daemon* daemon, DaemonClient* client)
+{
+	daemon->sent++;
+	client->length = 0;
+	client->offset = 0;
+
+	if (client->stale && !client->closed)
+	{
+		client->stale = false;
+		loadFrame(daemon, client, DaemonFrame_update);
+		_sendDaemon(daemon, client);
+	}
+}
+
+int64_t parseDaemonFrame(const uint8_t* buf, uint64_t size, DaemonFrameHeader* header, DaemonBattery* batteries)
+{
+	if (size < sizeof(*header))
+		return 0;
+
+	memcpy(header, buf, sizeof(*header));
+	uint64_t total = (uint64_t)header->length + sizeof(header->length);
+	if (total < sizeof(*header) || header->count > DAEMON_BATTERIES ||
+		total != sizeof(*header) + (uint64_t)header->count * sizeof(DaemonBattery))
+		return -1;
+	if (size < total)
+		return 0;
+
+	if (batteries)
+		memcpy(batteries, buf + sizeof(*header), (uint64_t)header->count * sizeof(DaemonBattery));
+	return (int64_t)total;
+}
\ No newline at end of file
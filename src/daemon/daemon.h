@@ -0,0 +1,194 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../battery/battery.h"
+
+// Batteries a frame holds, any past it are left out
+#define DAEMON_BATTERIES 16
+#define DAEMON_FRAME_MAX (sizeof(DaemonFrameHeader) + DAEMON_BATTERIES * sizeof(DaemonBattery))
+
+/*
+* Wire format, little endian. Every frame is a DaemonFrameHeader followed by
+* count DaemonBattery records, length counts the bytes after the length field.
+* A client is sent a snapshot when it connects and an update whenever a shown
+* battery field changes. Every frame carries the whole state, so a client that
+* reads too slowly is only sent the newest frame once it catches up and seq
+* skips the frames it missed
+*/
+
+typedef enum DaemonFrameType
+{
+	DaemonFrame_snapshot = 1,
+	DaemonFrame_update = 2,
+} DaemonFrameType;
+
+#pragma pack(push, 1)
+typedef struct DaemonFrameHeader
+{
+	uint32_t length;
+	uint16_t type;
+	uint16_t count;
+	/**
+	* \brief Increases with every update published
+	*/
+	uint64_t seq;
+	/**
+	* \brief Milliseconds since the Unix epoch the update was read at
+	*/
+	uint64_t time;
+	/**
+	* \brief Monotonic sft_timer_now in nanoseconds the update was published at, for fan-out latency
+	*/
+	uint64_t publishNs;
+} DaemonFrameHeader;
+
+typedef struct DaemonBattery
+{
+	uint32_t tag;
+	uint32_t capacity;
+	uint32_t charge;
+	uint32_t wear;
+	int32_t rate;
+	uint32_t voltage;
+	uint8_t isCharging;
+	uint8_t _pad[3];
+} DaemonBattery;
+#pragma pack(pop)
+
+typedef struct DaemonClient
+{
+	/**
+	* \brief Socket or pipe handle
+	*/
+	intptr_t handle;
+	/**
+	* \brief Backend owned I/O state
+	*/
+	void* io;
+
+	/**
+	* \brief Frame being written, length is 0 while nothing is in flight
+	*/
+	uint8_t frame[DAEMON_FRAME_MAX];
+	uint32_t length;
+	uint32_t offset;
+	/**
+	* \brief A newer frame was published while this one was in flight
+	*/
+	bool stale;
+	/**
+	* \brief Set by the backends when the client hung up or failed, freed by serviceDaemon
+	*/
+	bool closed;
+} DaemonClient;
+
+typedef struct Daemon
+{
+	/**
+	* \brief Listening socket or pipe and the epoll/IOCP handle
+	*/
+	intptr_t listener;
+	intptr_t poller;
+	/**
+	* \brief Backend owned listener state
+	*/
+	void* io;
+	char* path;
+
+	/**
+	* \brief Clients are allocated one by one so the backends can keep pointers to them
+	*/
+	DaemonClient** clients;
+	uint32_t clientCount;
+	uint32_t _maxClients;
+
+	/**
+	* \brief Newest frame, sent as is to clients that are idle
+	*/
+	uint8_t frame[DAEMON_FRAME_MAX];
+	uint32_t frameLength;
+	uint64_t seq;
+
+	/**
+	* \brief Frames written in full and frames skipped for slow clients
+	*/
+	uint64_t sent;
+	uint64_t coalesced;
+} Daemon;
+
+/**
+* \brief Starts listening, a Unix domain socket path or a \\.\pipe\ name on Windows
+* \param daemon The daemon to open
+* \param path Where clients connect
+* \warning Must be closed with closeDaemon
+*/
+bool openDaemon(Daemon* daemon, const char* path);
+
+/**
+* \brief Disconnects every client and stops listening
+* \param daemon The daemon to close
+*/
+void closeDaemon(Daemon* daemon);
+
+/**
+* \brief Encodes the batteries and sends them to every client, coalescing with frames still in flight
+* \param daemon The daemon to publish on
+* \param batteries The current state
+*/
+void publishDaemon(Daemon* daemon, const BatteryInfo_array* batteries);
+
+/**
+* \brief Accepts clients and continues writes until ms has passed
+* \param daemon The daemon to service
+* \param ms Longest time to wait for the event loop
+*/
+void serviceDaemon(Daemon* daemon, uint32_t ms);
+
+/**
+* \brief Returns true once SIGINT or SIGTERM was received after openDaemon
+*/
+bool daemonStopped();
+
+/**
+* \brief Parses a frame for a client
+* \param buf Bytes read from the stream
+* \param size Bytes available in buf
+* \param header [out] The frame header
+* \param batteries [out] Up to DAEMON_BATTERIES records, may be NULL
+* \return Bytes the frame takes, 0 if buf does not hold a whole frame yet, -1 if it is malformed
+*/
+int64_t parseDaemonFrame(const uint8_t* buf, uint64_t size, DaemonFrameHeader* header, DaemonBattery* batteries);
+
+// Backend hooks, implemented per platform
+bool _listenDaemon(Daemon* daemon);
+void _unlistenDaemon(Daemon* daemon);
+/**
+* \brief Waits on the event loop, accepting with _addDaemonClient and continuing writes
+*/
+void _pollDaemon(Daemon* daemon, uint32_t ms);
+/**
+* \brief Starts or continues writing client->frame, calls _sentDaemonFrame once it is written
+*/
+void _sendDaemon(Daemon* daemon, DaemonClient* client);
+/**
+* \brief Closes a client marked closed, returns false while I/O on it is still pending
+*/
+bool _closeDaemonClient(Daemon* daemon, DaemonClient* client);
+
+/**
+* \brief Tracks a connected client and queues the snapshot, NULL if out of memory
+*/
+DaemonClient* _addDaemonClient(Daemon* daemon, intptr_t handle, void* io);
+/**
+* \brief Called by the backends once a frame was written in full
+*/
+void _sentDaemonFrame(Daemon* daemon, DaemonClient* client);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
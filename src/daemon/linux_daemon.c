@@ -0,0 +1,214 @@
+// accept4 is a GNU extension
+#define _GNU_SOURCE
+#include "daemon.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+// Events handled per epoll_wait
+#define DAEMON_EVENTS 64
+
+typedef struct LinuxListener
+{
+	// Descriptor held back for accepting, and dropping, a client once the process ran out of them
+	int reserve;
+} LinuxListener;
+
+// Removes a socket a killed daemon left behind. Anything else at the path, or a daemon still listening, is left alone
+static bool clearStaleSocket(const struct sockaddr_un* addr)
+{
+	struct stat info;
+	if (lstat(addr->sun_path, &info) != 0)
+		return errno == ENOENT;
+	if (!S_ISSOCK(info.st_mode))
+		return false;
+
+	int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (probe < 0)
+		return false;
+	bool stale = connect(probe, (const struct sockaddr*)addr, sizeof(*addr)) != 0 && errno == ECONNREFUSED;
+	close(probe);
+
+	return stale && unlink(addr->sun_path) == 0;
+}
+
+bool _listenDaemon(Daemon* daemon)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	if (strlen(daemon->path) >= sizeof(addr.sun_path))
+		return false;
+	strcpy(addr.sun_path, daemon->path);
+
+	if (!clearStaleSocket(&addr))
+		return false;
+
+	LinuxListener* io = malloc(sizeof(*io));
+	if (!io)
+		return false;
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listener < 0)
+	{
+		free(io);
+		return false;
+	}
+
+	if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0)
+	{
+		close(listener);
+		free(io);
+		return false;
+	}
+
+	int poller = epoll_create1(EPOLL_CLOEXEC);
+	// The listener is told apart from clients by pointing at the daemon
+	struct epoll_event event = { .events = EPOLLIN, .data.ptr = daemon };
+	io->reserve = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (poller < 0 || epoll_ctl(poller, EPOLL_CTL_ADD, listener, &event) != 0 || io->reserve < 0)
+	{
+		if (poller >= 0)
+			close(poller);
+		if (io->reserve >= 0)
+			close(io->reserve);
+		close(listener);
+		unlink(daemon->path);
+		free(io);
+		return false;
+	}
+
+	daemon->listener = listener;
+	daemon->poller = poller;
+	daemon->io = io;
+	return true;
+}
+
+void _unlistenDaemon(Daemon* daemon)
+{
+	LinuxListener* io = daemon->io;
+	if (io->reserve >= 0)
+		close(io->reserve);
+	free(io);
+
+	close((int)daemon->poller);
+	close((int)daemon->listener);
+	unlink(daemon->path);
+}
+
+// The listener is level triggered, a client left in the backlog would wake every epoll_wait
+static bool dropClient(Daemon* daemon)
+{
+	LinuxListener* io = daemon->io;
+	if (io->reserve < 0)
+		return false;
+
+	close(io->reserve);
+	int fd = accept4((int)daemon->listener, NULL, NULL, SOCK_CLOEXEC);
+	if (fd >= 0)
+		close(fd);
+	io->reserve = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	return fd >= 0;
+}
+
+static void acceptClients(Daemon* daemon)
+{
+	for (;;)
+	{
+		int fd = accept4((int)daemon->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			// Out of descriptors, the client is turned away so it does not stay pending
+			if ((errno == EMFILE || errno == ENFILE) && dropClient(daemon))
+				continue;
+			return;
+		}
+
+		DaemonClient* client = _addDaemonClient(daemon, fd, NULL);
+		if (!client)
+		{
+			close(fd);
+			continue;
+		}
+
+		// Edge triggered, EPOLLOUT only reports again after a send hit EAGAIN
+		struct epoll_event event = { .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = client };
+		if (epoll_ctl((int)daemon->poller, EPOLL_CTL_ADD, fd, &event) != 0)
+			client->closed = true;
+	}
+}
+
+void _pollDaemon(Daemon* daemon, uint32_t ms)
+{
+	struct epoll_event events[DAEMON_EVENTS];
+	int count = epoll_wait((int)daemon->poller, events, DAEMON_EVENTS, ms > INT_MAX ? INT_MAX : (int)ms);
+
+	for (int i = 0; i < count; i++)
+	{
+		if (events[i].data.ptr == daemon)
+		{
+			acceptClients(daemon);
+			continue;
+		}
+
+		DaemonClient* client = events[i].data.ptr;
+		if (client->closed)
+			continue;
+
+		if (events[i].events & (EPOLLHUP | EPOLLERR | EPOLLRDHUP))
+		{
+			client->closed = true;
+			continue;
+		}
+
+		// Clients have nothing to say, drop whatever they send
+		if (events[i].events & EPOLLIN)
+		{
+			char discard[256];
+			while (recv((int)client->handle, discard, sizeof(discard), 0) > 0);
+		}
+
+		if ((events[i].events & EPOLLOUT) && client->length)
+			_sendDaemon(daemon, client);
+	}
+}
+
+void _sendDaemon(Daemon* daemon, DaemonClient* client)
+{
+	while (client->offset < client->length)
+	{
+		ssize_t sent = send((int)client->handle, client->frame + client->offset,
+			client->length - client->offset, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			// Full socket buffer, continued on the next EPOLLOUT
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				client->closed = true;
+			return;
+		}
+		client->offset += (uint32_t)sent;
+	}
+
+	_sentDaemonFrame(daemon, client);
+}
+
+bool _closeDaemonClient(Daemon* daemon, DaemonClient* client)
+{
+	// Closing also removes it from the epoll set
+	close((int)client->handle);
+	return true;
+}
+
+#endif
\ No newline at end of file
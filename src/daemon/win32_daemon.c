@@ -0,0 +1,214 @@
+#include "daemon.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bytes a pipe buffers per client before writes stay pending
+#define DAEMON_PIPE_BUFFER 4096
+// Completions handled per GetQueuedCompletionStatusEx
+#define DAEMON_EVENTS 64
+
+typedef struct Win32Pipe
+{
+	// First so a dequeued OVERLAPPED is the pipe
+	OVERLAPPED overlapped;
+	HANDLE pipe;
+	/**
+	* \brief NULL while the instance is waiting for a connection
+	*/
+	DaemonClient* client;
+	/**
+	* \brief A connect or write is in flight, its completion has not been dequeued yet
+	*/
+	bool pending;
+	bool cancelled;
+} Win32Pipe;
+
+static void connectPipe(Daemon* daemon, Win32Pipe* io)
+{
+	DaemonClient* client = _addDaemonClient(daemon, (intptr_t)io->pipe, io);
+	if (!client)
+	{
+		CloseHandle(io->pipe);
+		free(io);
+		return;
+	}
+	io->client = client;
+}
+
+// Creates the next pipe instance and starts waiting for a client on it
+static bool listenPipe(Daemon* daemon, bool first)
+{
+	for (;;)
+	{
+		// The first instance fails if another daemon already owns the name
+		HANDLE pipe = CreateNamedPipeA(daemon->path,
+			PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+			PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+			PIPE_UNLIMITED_INSTANCES, DAEMON_PIPE_BUFFER, 0, 0, NULL);
+		if (pipe == INVALID_HANDLE_VALUE)
+			return false;
+
+		Win32Pipe* io = calloc(1, sizeof(*io));
+		if (!io || !CreateIoCompletionPort(pipe, (HANDLE)daemon->poller, 0, 0))
+		{
+			free(io);
+			CloseHandle(pipe);
+			return false;
+		}
+		io->pipe = pipe;
+
+		// Success queues a completion too
+		DWORD error = ConnectNamedPipe(pipe, &io->overlapped) ? ERROR_IO_PENDING : GetLastError();
+		if (error == ERROR_IO_PENDING)
+		{
+			io->pending = true;
+			daemon->io = io;
+			daemon->listener = (intptr_t)pipe;
+			return true;
+		}
+
+		if (error != ERROR_PIPE_CONNECTED)
+		{
+			CloseHandle(pipe);
+			free(io);
+			return false;
+		}
+
+		// Connected between create and connect, nothing is queued for it
+		connectPipe(daemon, io);
+		first = false;
+	}
+}
+
+bool _listenDaemon(Daemon* daemon)
+{
+	HANDLE poller = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	if (!poller)
+		return false;
+
+	daemon->poller = (intptr_t)poller;
+	if (!listenPipe(daemon, true))
+	{
+		CloseHandle(poller);
+		daemon->poller = 0;
+		return false;
+	}
+	return true;
+}
+
+void _unlistenDaemon(Daemon* daemon)
+{
+	Win32Pipe* io = daemon->io;
+	if (io)
+	{
+		// The port is closed right after, so the queued completion is never read
+		DWORD bytes;
+		CancelIoEx(io->pipe, &io->overlapped);
+		GetOverlappedResult(io->pipe, &io->overlapped, &bytes, TRUE);
+		CloseHandle(io->pipe);
+		free(io);
+		daemon->io = NULL;
+	}
+
+	CloseHandle((HANDLE)daemon->poller);
+}
+
+void _pollDaemon(Daemon* daemon, uint32_t ms)
+{
+	// Creating the next instance failed last time, keep accepting clients
+	if (!daemon->io)
+		listenPipe(daemon, false);
+
+	OVERLAPPED_ENTRY entries[DAEMON_EVENTS];
+	ULONG count = 0;
+	if (!GetQueuedCompletionStatusEx((HANDLE)daemon->poller, entries, DAEMON_EVENTS, &count, ms, FALSE))
+		return;
+
+	for (ULONG i = 0; i < count; i++)
+	{
+		Win32Pipe* io = (Win32Pipe*)entries[i].lpOverlapped;
+		io->pending = false;
+
+		DWORD bytes = 0;
+		bool ok = GetOverlappedResult(io->pipe, &io->overlapped, &bytes, FALSE);
+
+		if (!io->client)
+		{
+			daemon->io = NULL;
+			if (ok)
+				connectPipe(daemon, io);
+			else
+			{
+				CloseHandle(io->pipe);
+				free(io);
+			}
+
+			listenPipe(daemon, false);
+			continue;
+		}
+
+		// Closed clients are freed by serviceDaemon now that nothing is pending
+		DaemonClient* client = io->client;
+		if (client->closed)
+			continue;
+
+		if (!ok)
+		{
+			client->closed = true;
+			continue;
+		}
+
+		client->offset += bytes;
+		if (client->offset < client->length)
+			_sendDaemon(daemon, client);
+		else
+			_sentDaemonFrame(daemon, client);
+	}
+}
+
+void _sendDaemon(Daemon* daemon, DaemonClient* client)
+{
+	Win32Pipe* io = client->io;
+	// The completion continues the frame
+	if (io->pending)
+		return;
+
+	memset(&io->overlapped, 0, sizeof(io->overlapped));
+	if (!WriteFile(io->pipe, client->frame + client->offset, client->length - client->offset, NULL, &io->overlapped) &&
+		GetLastError() != ERROR_IO_PENDING)
+	{
+		client->closed = true;
+		return;
+	}
+
+	// Writes completing at once still queue a completion
+	io->pending = true;
+}
+
+bool _closeDaemonClient(Daemon* daemon, DaemonClient* client)
+{
+	Win32Pipe* io = client->io;
+
+	// The OVERLAPPED has to outlive the write, wait for the cancelled completion
+	if (io->pending)
+	{
+		if (!io->cancelled)
+			CancelIoEx(io->pipe, &io->overlapped);
+		io->cancelled = true;
+		return false;
+	}
+
+	CloseHandle(io->pipe);
+	free(io);
+	return true;
+}
+
+#endif
\ No newline at end of file
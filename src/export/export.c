@@ -0,0 +1,208 @@
+#include "export.h"
+#include "../softdraw/timer/timer.h"
+
+#include <string.h>
+#include <time.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define EXPORT_PAUSE() _mm_pause()
+#else
+#define EXPORT_PAUSE()
+#endif
+
+// Attempts a read spins for before it yields to the writer, an update takes well under a microsecond
+#define EXPORT_READ_SPINS 1000
+// A writer still mid update after this long died in it
+#define EXPORT_READ_TIMEOUT_MS 100
+
+
+static inline void publish64(uint64_t* dest, uint64_t value)
+{
+#ifdef _MSC_VER
+	_InterlockedExchange64((volatile long long*)dest, (long long)value);
+#else
+	__atomic_store_n(dest, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// The odd seq has to be visible before any field of the state is
+static inline void publishOdd64(uint64_t* dest, uint64_t value)
+{
+#ifdef _MSC_VER
+	// Interlocked operations are full barriers already
+	_InterlockedExchange64((volatile long long*)dest, (long long)value);
+#else
+	__atomic_store_n(dest, value, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+#endif
+}
+
+static inline uint64_t acquire64(const uint64_t* src)
+{
+#ifdef _MSC_VER
+	// Readers map the segment read only, an interlocked compare exchange would write to it.
+	// Aligned loads are atomic and not reordered with later loads on x86 and x64
+	uint64_t value = (uint64_t)__iso_volatile_load64((const volatile long long*)src);
+	_ReadWriteBarrier();
+	return value;
+#else
+	return __atomic_load_n(src, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Keeps the state copy before seq is checked again
+static inline void fenceAcquire()
+{
+#ifdef _MSC_VER
+	_ReadWriteBarrier();
+#else
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+
+static void writeState(BatteryExport* shared, const ExportState* state)
+{
+	ExportSegment* segment = shared->segment;
+
+	// Only this process writes seq, the plain read of it is its own last store
+	uint64_t seq = segment->seq | 1;
+	publishOdd64(&segment->seq, seq);
+	memcpy(&segment->state, state, sizeof(*state));
+	publish64(&segment->seq, seq + 1);
+}
+
+bool openExport(BatteryExport* shared, const char* name)
+{
+	memset(shared, 0, sizeof(*shared));
+	if (!_mapExport(shared, name, true))
+		return false;
+	shared->writer = true;
+
+	// A segment left by an earlier writer keeps its seq, so readers still mapping it never see seq go back
+	ExportSegment* segment = shared->segment;
+	if (memcmp(segment->magic, EXPORT_MAGIC, 4) != 0 || segment->version != EXPORT_VERSION ||
+		segment->size != sizeof(ExportSegment) || segment->maxBatteries != EXPORT_BATTERIES)
+	{
+		publish64(&segment->seq, 0);
+		memcpy(segment->magic, EXPORT_MAGIC, 4);
+		segment->version = EXPORT_VERSION;
+		segment->size = sizeof(ExportSegment);
+		segment->maxBatteries = EXPORT_BATTERIES;
+	}
+
+	// Empty until the first publish, a closed state from the last writer is replaced
+	ExportState state = { .publishNs = sft_timer_now() };
+	writeState(shared, &state);
+	return true;
+}
+
+bool openExportReader(BatteryExport* shared, const char* name)
+{
+	memset(shared, 0, sizeof(*shared));
+	if (!_mapExport(shared, name, false))
+		return false;
+
+	// The writer may still be filling in a new segment, readers try again later
+	ExportSegment* segment = shared->segment;
+	if (memcmp(segment->magic, EXPORT_MAGIC, 4) != 0 || segment->version != EXPORT_VERSION ||
+		segment->size < sizeof(ExportSegment) || segment->maxBatteries != EXPORT_BATTERIES)
+	{
+		closeExport(shared);
+		return false;
+	}
+	return true;
+}
+
+void closeExport(BatteryExport* shared)
+{
+	if (!shared->segment)
+		return;
+
+	if (shared->writer)
+	{
+		ExportState state = shared->segment->state;
+		state.closed = 1;
+		state.publishNs = sft_timer_now();
+		writeState(shared, &state);
+	}
+
+	_unmapExport(shared);
+	memset(shared, 0, sizeof(*shared));
+}
+
+void publishExport(BatteryExport* shared, const BatteryInfo_array* batteries)
+{
+	if (!shared->segment || !shared->writer)
+		return;
+
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	// Encoded aside first, the segment only stays odd for the copy
+	ExportState state = {
+		.time = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000,
+		.total = (uint32_t)batteries->length,
+	};
+	for (uint32_t i = 0; i < batteries->length && state.count < EXPORT_BATTERIES; i++)
+	{
+		const BatteryInfo* battery = &batteries->data[i];
+		state.batteries[state.count++] = (ExportBattery){
+			.tag = battery->tag,
+			.capacity = battery->capacity,
+			.charge = battery->charge,
+			.wear = battery->wear,
+			.rate = battery->rate,
+			.voltage = battery->voltage,
+			.isCharging = battery->isCharging,
+		};
+	}
+
+	// Stamped last so the latency includes the encode
+	state.publishNs = sft_timer_now();
+	writeState(shared, &state);
+}
+
+bool readExport(BatteryExport* shared, ExportState* state)
+{
+	if (!shared->segment)
+		return false;
+
+	ExportSegment* segment = shared->segment;
+	uint64_t start = 0;
+	for (uint32_t i = 0;; i++)
+	{
+		uint64_t seq = acquire64(&segment->seq);
+		if (!(seq & 1))
+		{
+			// The copy may be torn, it is only kept if no update started meanwhile
+			memcpy(state, &segment->state, sizeof(*state));
+			fenceAcquire();
+			if (acquire64(&segment->seq) == seq)
+			{
+				shared->seq = seq;
+				return true;
+			}
+		}
+
+		shared->retries++;
+		if (i < EXPORT_READ_SPINS)
+		{
+			EXPORT_PAUSE();
+			continue;
+		}
+
+		// A writer preempted mid update needs the CPU back, a dead one never finishes
+		uint64_t now = sft_timer_now();
+		if (!start)
+			start = now;
+		else if (now - start > sft_toNANOSEC(EXPORT_READ_TIMEOUT_MS))
+			return false;
+		_yieldExport();
+	}
+}
\ No newline at end of file
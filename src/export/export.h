@@ -0,0 +1,160 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../battery/battery.h"
+
+// Batteries the segment holds, any past it are left out
+#define EXPORT_BATTERIES 16
+#define EXPORT_MAGIC "BEXP"
+#define EXPORT_VERSION 1
+
+// Segment the widget and --daemon publish to, Local\ names are only seen in the same session
+#ifdef _WIN32
+#define BATTERY_EXPORT_NAME "Local\\BatteryInfo"
+#else
+#define BATTERY_EXPORT_NAME "/BatteryInfo"
+#endif
+
+/*
+* Layout of the shared memory segment, native endian and fixed for a version. One
+* process writes it, any number of readers map it read only and copy the state
+* out under a sequence lock: seq is odd while the writer is in the middle of an
+* update, a copy is only kept if seq was even and did not move during it. Reading
+* takes no syscall and never blocks the writer, a reader only retries while an
+* update is being written. The segment outlives its writer, a writer started again
+* carries on from the same seq and readers that kept it mapped see its updates
+*/
+
+// Every field sits at its natural alignment without implicit padding, so compilers agree on the layout
+typedef struct ExportBattery
+{
+	uint32_t tag;
+	uint32_t capacity;
+	uint32_t charge;
+	uint32_t wear;
+	int32_t rate;
+	uint32_t voltage;
+	uint8_t isCharging;
+	uint8_t _pad[3];
+} ExportBattery;
+
+typedef struct ExportState
+{
+	/**
+	* \brief Milliseconds since the Unix epoch the state was read at
+	*/
+	uint64_t time;
+	/**
+	* \brief Monotonic sft_timer_now in nanoseconds the state was published at, for reader latency
+	*/
+	uint64_t publishNs;
+	/**
+	* \brief Records in batteries, and batteries the writer has including the ones left out
+	*/
+	uint32_t count;
+	uint32_t total;
+	/**
+	* \brief Set once the writer closed, the state is the last it published
+	*/
+	uint32_t closed;
+	uint32_t _pad;
+	ExportBattery batteries[EXPORT_BATTERIES];
+} ExportState;
+
+typedef struct ExportSegment
+{
+	char magic[4];
+	uint32_t version;
+	/**
+	* \brief sizeof(ExportSegment) of the writer
+	*/
+	uint32_t size;
+	uint32_t maxBatteries;
+	/**
+	* \brief Odd while state is being written, seq / 2 states were published
+	*/
+	uint64_t seq;
+	ExportState state;
+} ExportSegment;
+
+typedef struct BatteryExport
+{
+	/**
+	* \brief OS handles, the shared memory descriptor on POSIX, the mapping and the writer lock on Windows
+	*/
+	intptr_t file;
+	void* mapping;
+	void* lock;
+	ExportSegment* segment;
+	/**
+	* \brief Opened with openExport, readers map the segment read only
+	*/
+	bool writer;
+
+	/**
+	* \brief seq of the last state read, compare it to tell if a read is new
+	*/
+	uint64_t seq;
+	/**
+	* \brief Attempts that found the writer in the middle of an update
+	*/
+	uint64_t retries;
+} BatteryExport;
+
+/**
+* \brief Creates or reopens the segment for writing, only one writer can have it open
+* \param shared The export to open
+* \param name A shared memory name starting with / on POSIX, a mapping name on Windows
+* \warning Must be closed with closeExport
+*/
+bool openExport(BatteryExport* shared, const char* name);
+
+/**
+* \brief Maps a segment a writer created, read only
+* \param shared The export to open
+* \param name The name the writer opened
+* \return False if there is no segment or it has another layout version
+* \warning Must be closed with closeExport
+*/
+bool openExportReader(BatteryExport* shared, const char* name);
+
+/**
+* \brief Unmaps the segment, a writer marks the state closed first
+* \param shared The export to close
+*/
+void closeExport(BatteryExport* shared);
+
+/**
+* \brief Writes the batteries as the new state, does nothing if the export is not open for writing
+* \param shared The export to write
+* \param batteries The current state
+*/
+void publishExport(BatteryExport* shared, const BatteryInfo_array* batteries);
+
+/**
+* \brief Copies a consistent state out of the segment without a syscall or lock
+* \param shared The export to read
+* \param state [out] The newest state
+* \return False if the export is not open or the writer stayed mid update for too long, as when it died in one.
+Only a read that spun for a while waiting on the writer yields, which is a syscall
+*/
+bool readExport(BatteryExport* shared, ExportState* state);
+
+/**
+* \brief Internal functions that are OS specific, map sizeof(ExportSegment) read write for the writer and read only otherwise
+*/
+bool _mapExport(BatteryExport* shared, const char* name, bool writer);
+void _unmapExport(BatteryExport* shared);
+/**
+* \brief Gives the rest of the time slice away, to a writer preempted mid update
+*/
+void _yieldExport();
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "export.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool _mapExport(BatteryExport* shared, const char* name, bool writer)
+{
+	int fd = shm_open(name, writer ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	if (fd < 0)
+		return false;
+
+	// The lock goes with the descriptor, a writer that died leaves it free
+	struct stat info;
+	if ((writer && flock(fd, LOCK_EX | LOCK_NB) != 0) || fstat(fd, &info) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// Readers can not map past the end, a segment still being created is too short
+	uint64_t size = sizeof(ExportSegment);
+	bool sized = writer ? (uint64_t)info.st_size == size || ftruncate(fd, size) == 0 : (uint64_t)info.st_size >= size;
+	if (!sized)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* base = mmap(NULL, size, writer ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	shared->file = fd;
+	shared->mapping = NULL;
+	shared->lock = NULL;
+	shared->segment = base;
+	return true;
+}
+
+void _unmapExport(BatteryExport* shared)
+{
+	munmap(shared->segment, sizeof(ExportSegment));
+	close((int)shared->file);
+}
+
+void _yieldExport()
+{
+	sched_yield();
+}
+
+#endif
\ No newline at end of file
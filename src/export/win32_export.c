@@ -0,0 +1,75 @@
+#include "export.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+#include <stdio.h>
+
+bool _mapExport(BatteryExport* shared, const char* name, bool writer)
+{
+	HANDLE lock = NULL;
+	HANDLE mapping;
+	void* base;
+
+	if (writer)
+	{
+		// Mutexes and mappings share a namespace, the lock needs a name of its own.
+		// It is gone once every handle to it closed, so an existing one means a live writer
+		char lockName[256];
+		snprintf(lockName, sizeof(lockName), "%s.writer", name);
+		lock = CreateMutexA(NULL, FALSE, lockName);
+		if (!lock)
+			return false;
+		if (GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			CloseHandle(lock);
+			return false;
+		}
+
+		// Backed by the paging file, it lives as long as the writer or a reader has it open
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+			0, (DWORD)sizeof(ExportSegment), name);
+	}
+	else
+		mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+
+	if (!mapping)
+	{
+		if (lock)
+			CloseHandle(lock);
+		return false;
+	}
+
+	base = MapViewOfFile(mapping, writer ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(ExportSegment));
+	if (!base)
+	{
+		CloseHandle(mapping);
+		if (lock)
+			CloseHandle(lock);
+		return false;
+	}
+
+	shared->file = 0;
+	shared->mapping = mapping;
+	shared->lock = lock;
+	shared->segment = base;
+	return true;
+}
+
+void _unmapExport(BatteryExport* shared)
+{
+	UnmapViewOfFile(shared->segment);
+	CloseHandle(shared->mapping);
+	if (shared->lock)
+		CloseHandle(shared->lock);
+}
+
+void _yieldExport()
+{
+	SwitchToThread();
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,461 @@
+#include "history.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define HISTORY_MAGIC "BHST"
+#define HISTORY_VERSION 1
+
+// Bits a single sample can take: a 64 bit delta of delta and three full XOR values
+#define HISTORY_MAX_SAMPLE_BITS (4 + 64 + 3 * (2 + 5 + 5 + 32))
+// Leading zero count marking an XOR value without a previous bit window
+#define HISTORY_NO_WINDOW 0xFF
+// The charging flag rides in the top bit of the charge value
+#define HISTORY_CHARGING_BIT 0x80000000u
+
+
+// Counts are published to readers in other threads or processes with release stores
+static inline void publish32(uint32_t* dest, uint32_t value)
+{
+#ifdef _MSC_VER
+	_InterlockedExchange((volatile long*)dest, (long)value);
+#else
+	__atomic_store_n(dest, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline void publish64(uint64_t* dest, uint64_t value)
+{
+#ifdef _MSC_VER
+	_InterlockedExchange64((volatile long long*)dest, (long long)value);
+#else
+	__atomic_store_n(dest, value, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline uint32_t acquire32(const uint32_t* src)
+{
+#ifdef _MSC_VER
+	return (uint32_t)_InterlockedCompareExchange((volatile long*)src, 0, 0);
+#else
+	return __atomic_load_n(src, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline uint64_t acquire64(const uint64_t* src)
+{
+#ifdef _MSC_VER
+	return (uint64_t)_InterlockedCompareExchange64((volatile long long*)src, 0, 0);
+#else
+	return __atomic_load_n(src, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Keeps the block copy before the sequence number is checked again
+static inline void fenceAcquire()
+{
+#ifdef _MSC_VER
+	// The interlocked load after it is a full barrier already
+	_ReadWriteBarrier();
+#else
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline uint32_t clz32(uint32_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse(&index, value);
+	return 31 - index;
+#else
+	return __builtin_clz(value);
+#endif
+}
+
+static inline uint32_t ctz32(uint32_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, value);
+	return index;
+#else
+	return __builtin_ctz(value);
+#endif
+}
+
+
+// Bits are written most significant first into zeroed bytes
+static void putBits(uint8_t* data, uint32_t* pos, uint64_t value, uint32_t count)
+{
+	while (count)
+	{
+		uint32_t space = 8 - (*pos & 7);
+		uint32_t n = count < space ? count : space;
+		uint8_t chunk = (uint8_t)((value >> (count - n)) & ((1u << n) - 1));
+
+		data[*pos >> 3] |= chunk << (space - n);
+		*pos += n;
+		count -= n;
+	}
+}
+
+static uint64_t getBits(const uint8_t* data, uint32_t* pos, uint32_t count)
+{
+	uint64_t value = 0;
+	while (count)
+	{
+		uint32_t space = 8 - (*pos & 7);
+		uint32_t n = count < space ? count : space;
+		uint8_t chunk = (data[*pos >> 3] >> (space - n)) & ((1u << n) - 1);
+
+		value = (value << n) | chunk;
+		*pos += n;
+		count -= n;
+	}
+	return value;
+}
+
+static int64_t signExtend(uint64_t value, uint32_t bits)
+{
+	uint64_t sign = 1ull << (bits - 1);
+	return (int64_t)((value ^ sign) - sign);
+}
+
+
+static void putDelta(uint8_t* data, uint32_t* pos, int64_t dod)
+{
+	if (dod == 0)
+		putBits(data, pos, 0, 1);
+	else if (dod >= -64 && dod <= 63)
+	{
+		putBits(data, pos, 0b10, 2);
+		putBits(data, pos, (uint64_t)dod, 7);
+	}
+	else if (dod >= -256 && dod <= 255)
+	{
+		putBits(data, pos, 0b110, 3);
+		putBits(data, pos, (uint64_t)dod, 9);
+	}
+	else if (dod >= -2048 && dod <= 2047)
+	{
+		putBits(data, pos, 0b1110, 4);
+		putBits(data, pos, (uint64_t)dod, 12);
+	}
+	else
+	{
+		putBits(data, pos, 0b1111, 4);
+		putBits(data, pos, (uint64_t)dod, 64);
+	}
+}
+
+static int64_t getDelta(const uint8_t* data, uint32_t* pos)
+{
+	if (!getBits(data, pos, 1))
+		return 0;
+	if (!getBits(data, pos, 1))
+		return signExtend(getBits(data, pos, 7), 7);
+	if (!getBits(data, pos, 1))
+		return signExtend(getBits(data, pos, 9), 9);
+	if (!getBits(data, pos, 1))
+		return signExtend(getBits(data, pos, 12), 12);
+	return (int64_t)getBits(data, pos, 64);
+}
+
+static void putXor(uint8_t* data, uint32_t* pos, HistoryXor* state, uint32_t value)
+{
+	uint32_t diff = value ^ state->last;
+	state->last = value;
+
+	if (!diff)
+	{
+		putBits(data, pos, 0, 1);
+		return;
+	}
+	putBits(data, pos, 1, 1);
+
+	uint32_t leading = clz32(diff);
+	uint32_t trailing = ctz32(diff);
+
+	// Reuse the previous window if the changed bits fit inside it
+	if (state->leading != HISTORY_NO_WINDOW &&
+		leading >= state->leading && trailing >= state->trailing)
+	{
+		putBits(data, pos, 0, 1);
+		putBits(data, pos, diff >> state->trailing, 32 - state->leading - state->trailing);
+		return;
+	}
+
+	uint32_t length = 32 - leading - trailing;
+	putBits(data, pos, 1, 1);
+	putBits(data, pos, leading, 5);
+	putBits(data, pos, length - 1, 5);
+	putBits(data, pos, diff >> trailing, length);
+
+	state->leading = leading;
+	state->trailing = trailing;
+}
+
+static uint32_t getXor(const uint8_t* data, uint32_t* pos, HistoryXor* state)
+{
+	if (!getBits(data, pos, 1))
+		return state->last;
+
+	if (getBits(data, pos, 1))
+	{
+		state->leading = (uint8_t)getBits(data, pos, 5);
+		uint32_t length = (uint32_t)getBits(data, pos, 5) + 1;
+		state->trailing = (uint8_t)(32 - state->leading - length);
+	}
+
+	uint32_t length = 32 - state->leading - state->trailing;
+	state->last ^= (uint32_t)getBits(data, pos, length) << state->trailing;
+	return state->last;
+}
+
+
+static uint64_t headerSize()
+{
+	uint64_t size = sizeof(HistoryHeader) + (uint64_t)HISTORY_BLOCK_COUNT * sizeof(HistoryIndex);
+	return (size + HISTORY_BLOCK_SIZE - 1) / HISTORY_BLOCK_SIZE * HISTORY_BLOCK_SIZE;
+}
+
+bool openHistory(History* history, const char* path)
+{
+	memset(history, 0, sizeof(*history));
+
+	uint64_t size = headerSize() + (uint64_t)HISTORY_BLOCK_COUNT * HISTORY_BLOCK_SIZE;
+	if (!_mapHistory(history, path, size))
+		return false;
+
+	history->header = (HistoryHeader*)history->base;
+	history->index = (HistoryIndex*)(history->header + 1);
+	history->blocks = history->base + headerSize();
+
+	// Files from another layout start over
+	HistoryHeader* header = history->header;
+	if (memcmp(header->magic, HISTORY_MAGIC, 4) != 0 ||
+		header->version != HISTORY_VERSION ||
+		header->blockSize != HISTORY_BLOCK_SIZE ||
+		header->blockCount != HISTORY_BLOCK_COUNT)
+	{
+		memset(history->base, 0, headerSize());
+		header->version = HISTORY_VERSION;
+		header->blockSize = HISTORY_BLOCK_SIZE;
+		header->blockCount = HISTORY_BLOCK_COUNT;
+		header->head = HISTORY_BLOCK_COUNT - 1;
+		memcpy(header->magic, HISTORY_MAGIC, 4);
+	}
+
+	for (uint32_t i = 0; i < HISTORY_STREAMS; i++)
+		history->streams[i].block = -1;
+
+	return true;
+}
+
+void closeHistory(History* history)
+{
+	if (history->base)
+		_unmapHistory(history);
+	memset(history, 0, sizeof(*history));
+}
+
+static HistoryStream* findStream(History* history, uint32_t key)
+{
+	HistoryStream* oldest = &history->streams[0];
+	for (uint32_t i = 0; i < HISTORY_STREAMS; i++)
+	{
+		HistoryStream* stream = &history->streams[i];
+		if (stream->used && stream->key == key)
+			return stream;
+
+		if (!stream->used)
+			oldest = stream;
+		else if (oldest->used && stream->lastTime < oldest->lastTime)
+			oldest = stream;
+	}
+
+	// Replaced streams finish their block, the next sample starts a new one
+	memset(oldest, 0, sizeof(*oldest));
+	oldest->used = true;
+	oldest->key = key;
+	oldest->block = -1;
+	return oldest;
+}
+
+static void startBlock(History* history, HistoryStream* stream, const HistorySample* sample)
+{
+	HistoryHeader* header = history->header;
+	uint64_t block = (header->head + 1) % HISTORY_BLOCK_COUNT;
+	HistoryIndex* index = &history->index[block];
+
+	// Readers see an empty block while it is reset
+	publish64(&index->seq, 0);
+	publish32(&index->count, 0);
+
+	// A stream still writing into the overwritten block has to move on
+	for (uint32_t i = 0; i < HISTORY_STREAMS; i++)
+		if (history->streams[i].block == (int64_t)block)
+			history->streams[i].block = -1;
+
+	memset(history->blocks + block * HISTORY_BLOCK_SIZE, 0, HISTORY_BLOCK_SIZE);
+	index->key = sample->key;
+	index->firstTime = sample->time;
+	index->lastTime = sample->time;
+
+	header->seq++;
+	publish64(&index->seq, header->seq);
+	publish64(&header->head, block);
+
+	stream->block = block;
+	stream->bits = 0;
+}
+
+bool appendHistory(History* history, const HistorySample* sample)
+{
+	if (!history->base)
+		return false;
+
+	HistoryStream* stream = findStream(history, sample->key);
+
+	uint32_t charge = sample->charge | (sample->isCharging ? HISTORY_CHARGING_BIT : 0);
+	uint32_t values[3] = { charge, sample->capacity, sample->wear };
+
+	if (stream->block < 0 || stream->bits + HISTORY_MAX_SAMPLE_BITS > HISTORY_BLOCK_SIZE * 8)
+	{
+		startBlock(history, stream, sample);
+		uint8_t* data = history->blocks + stream->block * HISTORY_BLOCK_SIZE;
+
+		// First sample of a block is stored whole
+		putBits(data, &stream->bits, sample->time, 64);
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			putBits(data, &stream->bits, values[i], 32);
+			stream->values[i].last = values[i];
+			stream->values[i].leading = HISTORY_NO_WINDOW;
+			stream->values[i].trailing = 0;
+		}
+		stream->lastDelta = 0;
+	}
+	else
+	{
+		uint8_t* data = history->blocks + stream->block * HISTORY_BLOCK_SIZE;
+
+		int64_t delta = (int64_t)(sample->time - stream->lastTime);
+		putDelta(data, &stream->bits, delta - stream->lastDelta);
+		stream->lastDelta = delta;
+
+		for (uint32_t i = 0; i < 3; i++)
+			putXor(data, &stream->bits, &stream->values[i], values[i]);
+	}
+	stream->lastTime = sample->time;
+
+	HistoryIndex* index = &history->index[stream->block];
+	index->lastTime = sample->time;
+	publish32(&index->count, index->count + 1);
+	return true;
+}
+
+static uint64_t scanBlock(const uint8_t* data, uint32_t count, uint32_t key,
+	uint64_t from, uint64_t to, HistoryVisitor visitor, void* user, bool* stop)
+{
+	uint64_t visited = 0;
+	uint32_t pos = 0;
+
+	HistorySample sample = { .key = key };
+	HistoryXor values[3];
+	int64_t delta = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (i == 0)
+		{
+			sample.time = getBits(data, &pos, 64);
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				values[v].last = (uint32_t)getBits(data, &pos, 32);
+				values[v].leading = HISTORY_NO_WINDOW;
+				values[v].trailing = 0;
+			}
+		}
+		else
+		{
+			delta += getDelta(data, &pos);
+			sample.time += delta;
+			for (uint32_t v = 0; v < 3; v++)
+				getXor(data, &pos, &values[v]);
+		}
+
+		if (sample.time < from)
+			continue;
+		if (sample.time > to)
+			break;
+
+		sample.charge = values[0].last & ~HISTORY_CHARGING_BIT;
+		sample.isCharging = (values[0].last & HISTORY_CHARGING_BIT) != 0;
+		sample.capacity = values[1].last;
+		sample.wear = values[2].last;
+
+		visited++;
+		if (!visitor(&sample, user))
+		{
+			*stop = true;
+			break;
+		}
+	}
+	return visited;
+}
+
+uint64_t scanHistory(const History* history, uint32_t key, uint64_t from, uint64_t to,
+	HistoryVisitor visitor, void* user)
+{
+	if (!history->base)
+		return 0;
+
+	uint64_t visited = 0;
+	bool stop = false;
+	uint8_t copy[HISTORY_BLOCK_SIZE];
+
+	// Oldest block first, blocks are started in ring order
+	uint64_t head = acquire64(&history->header->head);
+	for (uint64_t i = 1; i <= HISTORY_BLOCK_COUNT && !stop; i++)
+	{
+		uint64_t block = (head + i) % HISTORY_BLOCK_COUNT;
+		HistoryIndex* index = &history->index[block];
+
+		uint64_t seq = acquire64(&index->seq);
+		if (!seq)
+			continue;
+
+		uint32_t count = acquire32(&index->count);
+		uint32_t blockKey = index->key;
+		if (!count || (key && blockKey != key) ||
+			index->lastTime < from || index->firstTime > to)
+			continue;
+
+		// Only the copy is decoded, and only if the block was not reset meanwhile
+		memcpy(copy, history->blocks + block * HISTORY_BLOCK_SIZE, HISTORY_BLOCK_SIZE);
+		fenceAcquire();
+		if (acquire64(&index->seq) != seq)
+			continue;
+
+		visited += scanBlock(copy, count, blockKey, from, to, visitor, user, &stop);
+	}
+	return visited;
+}
+
+uint32_t historyKey(uint32_t tag, const char* path)
+{
+	// FNV-1a over the path, then the tag
+	uint32_t hash = 2166136261u;
+	for (const char* c = path; c && *c; c++)
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
+	for (uint32_t i = 0; i < 4; i++)
+		hash = (hash ^ ((tag >> (i * 8)) & 0xFF)) * 16777619u;
+
+	// 0 means every battery to scanHistory
+	return hash ? hash : 1;
+}
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bytes per ring block, every block decodes on its own
+#define HISTORY_BLOCK_SIZE 4096
+// Blocks in a new history file, 8 MiB holds months of 1 Hz samples
+#define HISTORY_BLOCK_COUNT 2048
+// Batteries appended to at once, the least recently appended is dropped after
+#define HISTORY_STREAMS 8
+
+typedef struct HistorySample
+{
+	/**
+	* \brief Battery key, see historyKey
+	*/
+	uint32_t key;
+	/**
+	* \brief Milliseconds since the Unix epoch
+	*/
+	uint64_t time;
+
+	uint32_t charge;
+	uint32_t capacity;
+	uint32_t wear;
+	uint8_t isCharging;
+} HistorySample;
+
+typedef struct HistoryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t blockSize;
+	uint32_t blockCount;
+	/**
+	* \brief Block most recently started
+	*/
+	uint64_t head;
+	/**
+	* \brief Sequence number of the block most recently started
+	*/
+	uint64_t seq;
+} HistoryHeader;
+
+typedef struct HistoryIndex
+{
+	/**
+	* \brief Increases with every block started, 0 while the block is empty or being reset
+	*/
+	uint64_t seq;
+	uint64_t firstTime;
+	uint64_t lastTime;
+	uint32_t key;
+	/**
+	* \brief Samples published in the block
+	*/
+	uint32_t count;
+} HistoryIndex;
+
+typedef struct HistoryXor
+{
+	uint32_t last;
+	uint8_t leading;
+	uint8_t trailing;
+} HistoryXor;
+
+typedef struct HistoryStream
+{
+	uint32_t key;
+	bool used;
+	/**
+	* \brief Block being appended to, -1 before the first sample
+	*/
+	int64_t block;
+	/**
+	* \brief Next free bit in the block
+	*/
+	uint32_t bits;
+
+	uint64_t lastTime;
+	int64_t lastDelta;
+	HistoryXor values[3];
+} HistoryStream;
+
+typedef struct History
+{
+	/**
+	* \brief OS file and mapping handles
+	*/
+	intptr_t file;
+	void* mapping;
+
+	uint8_t* base;
+	uint64_t size;
+	HistoryHeader* header;
+	HistoryIndex* index;
+	uint8_t* blocks;
+
+	/**
+	* \brief Encoder state per battery, only the writer uses it
+	*/
+	HistoryStream streams[HISTORY_STREAMS];
+} History;
+
+/**
+* \brief Called for every sample of a scan in time order per block
+* \param sample The decoded sample
+* \param user The pointer passed to scanHistory
+* \return false to stop the scan
+*/
+typedef bool (*HistoryVisitor)(const HistorySample* sample, void* user);
+
+/**
+* \brief Maps a history file, creating or resetting it if it does not match the build
+* \param history The history to open
+* \param path The file to map
+* \warning Must be closed with closeHistory
+*/
+bool openHistory(History* history, const char* path);
+
+/**
+* \brief Flushes and unmaps the history file
+* \param history The history to close
+*/
+void closeHistory(History* history);
+
+/**
+* \brief Appends a sample without locking or allocating, overwriting the oldest block once the ring is full.
+Samples are published to readers once the append returns
+* \param history The history to append to
+* \param sample The sample to append
+*/
+bool appendHistory(History* history, const HistorySample* sample);
+
+/**
+* \brief Streams every sample of a battery in [from, to], one block at a time.
+Blocks are copied before they are decoded, so a concurrent writer can not tear a read
+* \param history The history to read
+* \param key The battery to read, 0 for every battery
+* \param from The first time in milliseconds to read
+* \param to The last time in milliseconds to read
+* \param visitor Called for every sample
+* \param user Passed to the visitor
+* \return The number of samples visited
+*/
+uint64_t scanHistory(const History* history, uint32_t key, uint64_t from, uint64_t to,
+	HistoryVisitor visitor, void* user);
+
+/**
+* \brief Makes a battery key from its tag and device path, so batteries sharing a tag stay apart
+* \param tag The battery tag
+* \param path The battery device path
+*/
+uint32_t historyKey(uint32_t tag, const char* path);
+
+/**
+* \brief Internal function to map a file of the given size
+*/
+bool _mapHistory(History* history, const char* path, uint64_t size);
+/**
+* \brief Internal function to flush and unmap the file
+*/
+void _unmapHistory(History* history);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
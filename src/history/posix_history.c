@@ -0,0 +1,45 @@
+#include "history.h"
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+bool _mapHistory(History* history, const char* path, uint64_t size)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+
+	// Sparse until written, so a new file costs nothing up front
+	struct stat info;
+	if (fstat(fd, &info) != 0 || ((uint64_t)info.st_size != size && ftruncate(fd, size) != 0))
+	{
+		close(fd);
+		return false;
+	}
+
+	void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	history->file = fd;
+	history->mapping = NULL;
+	history->base = base;
+	history->size = size;
+	return true;
+}
+
+void _unmapHistory(History* history)
+{
+	msync(history->base, history->size, MS_ASYNC);
+	munmap(history->base, history->size);
+	close((int)history->file);
+}
+
+#endif
\ No newline at end of file
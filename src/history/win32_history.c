@@ -0,0 +1,49 @@
+#include "history.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+bool _mapHistory(History* history, const char* path, uint64_t size)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	// Mapping past the end grows the file
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+		(DWORD)(size >> 32), (DWORD)size, NULL);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void* base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!base)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	history->file = (intptr_t)file;
+	history->mapping = mapping;
+	history->base = base;
+	history->size = size;
+	return true;
+}
+
+void _unmapHistory(History* history)
+{
+	FlushViewOfFile(history->base, 0);
+	UnmapViewOfFile(history->base);
+	CloseHandle(history->mapping);
+	CloseHandle((HANDLE)history->file);
+}
+
+#endif
\ No newline at end of file
@@ -1,406 +1,567 @@
-#define WIN32_LEAN_AND_MEAN
-#define NO_STRICT
-#define NOMINMAX
-#include <Windows.h>
-#include <ioapiset.h>
-#include <winioctl.h>
-#include <Poclass.h>
-#include <setupapi.h>
-#include <Devguid.h>
-
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "softdraw/softdraw.h"
-
-#define ARRAY(type) typedef struct {type* data; uint64_t length; } type##_array;
+#include "battery/battery.h"
+#include "battery/poller.h"
+#include "battery/trace.h"
+#include "taskbar/taskbar.h"
+#include "history/history.h"
+#include "daemon/daemon.h"
+#include "export/export.h"
+#include "bench/bench.h"
 
 #define MODINC(var, mod) (var) = ((var) + 1) % (mod)
 #define MODDEC(var, mod) (var) = ((var) + (mod) - 1) % (mod)
 
-typedef struct BatteryInfo
-{
-	HANDLE handle;
-	uint32_t tag;
+// Period batteries without a pending wait are polled at
+#define BATTERY_POLL_MS 1000
 
-	uint32_t wear;
-	uint32_t capacity;
-	uint32_t charge;
-	uint8_t isCharging;
-} BatteryInfo;
+// Ring file samples are appended to, in the working directory
+#define HISTORY_PATH "BatteryHistory.bin"
 
-ARRAY(BatteryInfo);
+// Where --daemon serves battery frames to local clients
+#ifdef _WIN32
+#define DAEMON_PATH "\\\\.\\pipe\\BatteryInfo"
+#else
+#define DAEMON_PATH "BatteryInfo.sock"
+#endif
 
+// Without a window there are no device notifications, the daemon re-enumerates at this period
+#define DAEMON_RESCAN_MS 10000
 
-static void winErr(const char* label)
-{
-	DWORD err = GetLastError();
-	if (err)
-	{
-		char* buf = NULL;
-		FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, 
-			NULL, err, 0, &buf, 0, NULL);
+// Premultiplied and all but invisible, pixels with no alpha at all would let clicks through to the taskbar
+#define BACKGROUND_COLOR 0x01000000
 
-		printf("\"%s\" ERROR:(%u) %s\n", label, err, buf);
 
-		LocalFree(buf);
+static void recordHistory(History* history, BatteryInfo_array* batteries)
+{
+	struct timespec now;
+	timespec_get(&now, TIME_UTC);
+
+	for (uint32_t i = 0; i < batteries->length; i++)
+	{
+		BatteryInfo* battery = &batteries->data[i];
+		if (!battery->tag)
+			continue;
+
+		HistorySample sample = {
+			.key = historyKey(battery->tag, battery->path),
+			.time = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000,
+			.charge = battery->charge,
+			.capacity = battery->capacity,
+			.wear = battery->wear,
+			.isCharging = battery->isCharging,
+		};
+		appendHistory(history, &sample);
 	}
 }
 
-static HANDLE openDevice(const char* name)
+// Where every change goes, the poller thread is the only writer of both
+typedef struct BatteryOutputs
 {
-	return CreateFileA(name,
-		GENERIC_READ | GENERIC_WRITE,
-		FILE_SHARE_READ | FILE_SHARE_WRITE,
-		NULL, OPEN_EXISTING, 0, NULL);
-}
-
+	History* history;
+	BatteryExport* shared;
+} BatteryOutputs;
 
-static uint32_t getBatteryTag(HANDLE hDev)
+// Runs on the poller thread
+static void onBatteriesChanged(BatteryInfo_array* batteries, void* userData)
 {
-	uint32_t wait = 0;
-	uint32_t tag = 0;
-	uint32_t numBytes = 0;
-
-	DeviceIoControl(hDev, IOCTL_BATTERY_QUERY_TAG,
-		&wait, sizeof(wait),
-		&tag, sizeof(tag),
-		&numBytes, NULL);
-
-	return tag;
+	BatteryOutputs* outputs = userData;
+	recordHistory(outputs->history, batteries);
+	publishExport(outputs->shared, batteries);
 }
 
-static BATTERY_INFORMATION getBatteryInfo(HANDLE hDev, uint32_t tag)
-{
-
-	BATTERY_QUERY_INFORMATION batteryQInfo = { 0 };
-	batteryQInfo.InformationLevel = BatteryInformation;
-	batteryQInfo.BatteryTag = tag;
-
-	BATTERY_INFORMATION batteryInfo = { 0 };
-
-	uint32_t numBytes = 0;
-	BOOL foundDev = DeviceIoControl(hDev, IOCTL_BATTERY_QUERY_INFORMATION,
-		&batteryQInfo, sizeof(batteryQInfo),
-		&batteryInfo, sizeof(batteryInfo),
-		&numBytes, NULL);
 
-	return batteryInfo;
-}
-
-static BATTERY_STATUS getBatteryStatus(HANDLE hDev, uint32_t tag)
+typedef struct SystemChanges
 {
-	BATTERY_WAIT_STATUS wait = { 0 };
-	wait.BatteryTag = tag;
-
-	BATTERY_STATUS batteryStatus = { 0 };
-
-	uint32_t numBytes = 0;
-	BOOL foundDev = DeviceIoControl(hDev, IOCTL_BATTERY_QUERY_STATUS,
-		&wait, sizeof(wait),
-		&batteryStatus, sizeof(batteryStatus),
-		&numBytes, NULL);
+	bool devices;
+	bool taskbar;
+} SystemChanges;
 
-	return batteryStatus;
+static void onSystemChange(sft_window* win, sft_sysChange change)
+{
+	// userData points at the main loop's change flags
+	SystemChanges* changes = win->userData;
+	if (!changes)
+		return;
+
+	if (change == sft_sysChange_devices)
+		changes->devices = true;
+	else
+		// Display, setting and shell changes can all move the tray
+		changes->taskbar = true;
 }
 
 
-static BatteryInfo initBattery(const char* name)
+typedef struct DrawState
 {
-	BatteryInfo battery = { 0 };
-	battery.handle = openDevice(name);
-
-	battery.tag = getBatteryTag(battery.handle);
+	sft_ui ui;
+	// Label placed for the mode, only its changed cells are redrawn
+	sft_widgetId value;
+	sft_widgetId switchUp;
+	sft_widgetId switchDown;
+	sft_widgetId close;
+	uint8_t drawMode;
+	bool valid;
+#ifdef _DEBUG
+	// Presents since the window manager probe last printed, summed and the slowest
+	uint64_t presents;
+	uint64_t presentNs;
+	uint64_t maxPresentNs;
+#endif
+} DrawState;
+
+static sft_widgetId addGlyphButton(sft_ui* ui, sft_widgetId parent, sft_rect rect, char glyph, int32_t glyphY, sft_color color)
+{
+	sft_widgetId id = sft_ui_add(ui, parent, sft_widget_button, rect);
+	sft_widget* button = sft_ui_get(ui, id);
+	if (button)
+	{
+		button->glyph = glyph;
+		button->glyphY = glyphY;
+		button->fontSize = 3;
+		button->color = color;
+	}
+	return id;
+}
 
-	BATTERY_INFORMATION batteryInfo = getBatteryInfo(
-		battery.handle, battery.tag);
-	battery.capacity = batteryInfo.FullChargedCapacity;
+// The value on the left, the mode switch and close button on the right
+static void buildUi(DrawState* state, sft_rect winRect)
+{
+	sft_ui* ui = &state->ui;
+	sft_ui_init(ui, winRect.w, winRect.h);
 
-	battery.wear = batteryInfo.DesignedCapacity;
-	battery.wear -= battery.capacity;
+	state->value = sft_ui_add(ui, 0, sft_widget_label, (sft_rect){ 0, 8, winRect.w - 48, 24 });
+	sft_ui_get(ui, state->value)->label.background = BACKGROUND_COLOR;
 
-	BATTERY_STATUS batteryStatus = getBatteryStatus(
-		battery.handle, battery.tag);
-	battery.charge = batteryStatus.Capacity;
-	battery.isCharging = (batteryStatus.PowerState & BATTERY_POWER_ON_LINE) != 0;
+	sft_widgetId switches = sft_ui_add(ui, 0, sft_widget_container, (sft_rect){ winRect.w - 48, 4, 24, 28 });
+	// The arrows are drawn a little outside their halves to sit close together and share a stem.
+	// Later widgets paint over earlier ones, the brighter up arrow is added last to stay on top
+	state->switchDown = addGlyphButton(ui, switches, (sft_rect){ 0, 14, 24, 14 }, sft_key_Down, -11, 0xFF7F7F7F);
+	state->switchUp = addGlyphButton(ui, switches, (sft_rect){ 0, 0, 24, 14 }, sft_key_Up, -1, 0xFFBFBFBF);
 
-	return battery;
+	state->close = addGlyphButton(ui, 0, (sft_rect){ winRect.w - 24, 8, 24, 24 }, 'X', 0, 0xFFFF0000);
 }
 
+// Longest duration formatDuration writes, "99h+" or "9:59", with the terminator
+#define DURATION_SIZE 5
 
-static void releaseBattery(BatteryInfo* battery)
+// Formats minutes as h:mm, whole hours past 10 hours where minutes mean nothing
+static void formatDuration(char buf[DURATION_SIZE], float minutes)
 {
-	CloseHandle(battery->handle);
-	memset(battery, 0, sizeof(*battery));
+	// NaN when there is no estimate. The band runs to INFINITY once the rate may reach 0, so it is capped
+	if (!(minutes >= 0))
+		snprintf(buf, DURATION_SIZE, "?");
+	else if (minutes < 10 * 60 - 0.5f)
+	{
+		// The branches bound every field, the modulos only tell the compiler so
+		uint16_t rounded = (uint16_t)(minutes + 0.5f);
+		snprintf(buf, DURATION_SIZE, "%u:%02u", (uint8_t)(rounded / 60 % 10), (uint8_t)(rounded % 60));
+	}
+	else if (minutes < 99 * 60 + 30)
+		snprintf(buf, DURATION_SIZE, "%uh", (uint8_t)((uint16_t)(minutes / 60 + 0.5f) % 100));
+	else
+		snprintf(buf, DURATION_SIZE, "99h+");
 }
 
-
-static uint32_t getBatteryCount()
+static void draw(sft_window* win, DrawState* state, const BatterySnapshot* snapshot, uint8_t drawMode)
 {
-	HDEVINFO devInfo = SetupDiGetClassDevsA(&GUID_DEVCLASS_BATTERY,
-		NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+	// Kept up to date by the poller thread, over every battery
+	uint64_t totalCapacity = snapshot->totals.capacity;
+	uint64_t totalCharge = snapshot->totals.charge;
+	bool isCharging = snapshot->totals.charging != 0;
 
-	uint32_t i = 0;
-	for (; ; i++)
+	// Only a new mode clears everything, otherwise changed text cells are redrawn
+	if (!state->valid || state->drawMode != drawMode)
 	{
-		SP_DEVICE_INTERFACE_DATA did = { 0 };
-		did.cbSize = sizeof(did);
-
-		if (SetupDiEnumDeviceInterfaces(devInfo, NULL,
-			&GUID_DEVCLASS_BATTERY, i, &did))
+		sft_window_fill(win, BACKGROUND_COLOR);
+		sft_ui_invalidate(&state->ui);
+		state->drawMode = drawMode;
+		state->valid = true;
+
+		// Two line modes needed slightly more space, the lines overlap a little
+		sft_widget* value = sft_ui_get(&state->ui, state->value);
+		if (drawMode == 1 || drawMode == 3)
 		{
-			uint32_t devInfoSize = 0;
-			SetupDiGetDeviceInterfaceDetailA(devInfo, &did, NULL, NULL,
-				&devInfoSize, NULL);
-
-			if (GetLastError() == ERROR_NO_MORE_ITEMS)
-				break;
+			value->rect.x = 8;
+			value->rect.y = 4;
+			value->label.fontSize = 2;
+			value->label.lineHeight = 14;
 		}
 		else
-			break;
-	}
+		{
+			value->rect.x = 0;
+			value->rect.y = 8;
+			value->label.fontSize = 3;
+			value->label.lineHeight = 24;
+		}
+		sft_ui_relayout(&state->ui);
 
-	SetupDiDestroyDeviceInfoList(devInfo);
+		sft_ui_draw(win, &state->ui);
+	}
 
-	return i;
-}
+	sft_color color = isCharging ? 0xFF00FF00 : 0xFFFFFFFF;
+	// Lines split by '\n', only the cells that changed are redrawn
+	char text[32];
 
-static BatteryInfo_array getBatteries()
-{
-	BatteryInfo_array batteries = { 0 };
-	batteries.length = getBatteryCount();
-	batteries.data = malloc(sizeof(*batteries.data) * batteries.length);
+	switch (drawMode)
+	{
+	case 0:
+	{
+		// "%6.2f%%" without printf, hundredths of a percent rounded to nearest with exact ties to even
+		uint32_t hundredths = 0;
+		if (totalCapacity)
+		{
+			uint64_t scaled = totalCharge * 10000;
+			hundredths = (uint32_t)(scaled / totalCapacity);
+			uint64_t twice = scaled % totalCapacity * 2;
+			if (twice > totalCapacity || (twice == totalCapacity && (hundredths & 1)))
+				hundredths++;
+		}
+		uint32_t len = sft_strfFixed(text, hundredths, 2, 6);
+		text[len] = '%';
+		text[len + 1] = '\0';
+		break;
+	}
 
-	HDEVINFO devInfo = SetupDiGetClassDevsA(&GUID_DEVCLASS_BATTERY,
-		NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+	case 1:
+	{
+		uint32_t len = sft_strfUint(text, (uint32_t)sft_min(totalCharge, UINT32_MAX), 10);
+		text[len++] = '\n';
+		sft_strfUint(text + len, (uint32_t)sft_min(totalCapacity, UINT32_MAX), 10);
+		break;
+	}
 
-	for (uint32_t i = 0; batteries.length; i++)
+	case 2:
 	{
-		SP_DEVICE_INTERFACE_DATA did = { 0 };
-		did.cbSize = sizeof(did);
+		uint32_t len = sft_strfUint(text, totalCapacity ? (uint32_t)(totalCharge * 100 / totalCapacity) : 0, 6);
+		text[len] = '%';
+		text[len + 1] = '\0';
+		break;
+	}
 
-		if (SetupDiEnumDeviceInterfaces(devInfo, NULL,
-			&GUID_DEVCLASS_BATTERY, i, &did))
+	case 3:
+	{
+		// Time to empty or full on top, the one sigma band under it
+		BatteryEstimate estimate = estimateBatteries(&snapshot->batteries);
+		if (estimate.valid)
 		{
-			uint32_t devInfoSize = 0;
-			SetupDiGetDeviceInterfaceDetailA(devInfo, &did, NULL, NULL,
-				&devInfoSize, NULL);
+			char minutes[DURATION_SIZE], low[DURATION_SIZE], high[DURATION_SIZE];
+			formatDuration(minutes, estimate.minutes);
+			formatDuration(low, estimate.low);
+			formatDuration(high, estimate.high);
 
-			SP_INTERFACE_DEVICE_DETAIL_DATA_A* iddd = malloc(devInfoSize);
-			if (iddd)
-			{
-				iddd->cbSize = sizeof(*iddd);
-				SetupDiGetDeviceInterfaceDetailA(devInfo, &did, iddd,
-					devInfoSize, &devInfoSize, NULL);
-
-				batteries.data[i] = initBattery(iddd->DevicePath);
-
-				free(iddd);
-			}
+			snprintf(text, sizeof(text), "%5s %s\n%5s-%s", minutes, estimate.charging ? "full" : "left", low, high);
 		}
 		else
-			break;
+			snprintf(text, sizeof(text), "%5s", "--:--");
+		break;
 	}
 
-	SetupDiDestroyDeviceInfoList(devInfo);
+	case 4:
+		text[0] = '\0';
+		break;
+	}
+
+	sft_ui_setText(win, &state->ui, state->value, text, color);
+
+	sft_window_display(win);
 
-	return batteries;
+#ifdef _DEBUG
+	state->presents++;
+	state->presentNs += win->presentNs;
+	state->maxPresentNs = sft_max(state->maxPresentNs, win->presentNs);
+#endif
 }
 
 
-static bool updateBatteries(BatteryInfo_array* batteries)
+// Windowless loop for --daemon, batteries are polled on the schedule and every change is published
+static int runDaemon(const BatteryProvider* provider, uint32_t pollMs, BatteryInfo_array* batteries,
+	History* history, BatteryExport* shared)
 {
-	bool change = false;
-
-	for (uint32_t i = 0; i < batteries->length; i++)
+	Daemon daemon;
+	if (!openDaemon(&daemon, DAEMON_PATH))
 	{
-		uint32_t tag = getBatteryTag(batteries->data[i].handle);
-		if (batteries->data[i].tag != tag)
-			change = true;
-		batteries->data[i].tag = tag;
+		fprintf(stderr, "Could not listen on %s\n", DAEMON_PATH);
+		return 1;
+	}
+	publishDaemon(&daemon, batteries);
 
-		BATTERY_INFORMATION batteryInfo = getBatteryInfo(
-			batteries->data[i].handle, batteries->data[i].tag);
-		BATTERY_STATUS batteryStatus = getBatteryStatus(
-			batteries->data[i].handle, batteries->data[i].tag);
+#ifdef _DEBUG
+	BatteryQueryRate queryRate = { .lastTime = sft_timer_coarse() };
+#endif
 
-		bool isCharging = (batteryStatus.PowerState & BATTERY_POWER_ON_LINE) != 0;
+	sft_schedule schedule = { 0 };
+	int32_t pollTask = sft_schedule_add(&schedule, sft_toNANOSEC(pollMs), sft_timer_now());
+	int32_t rescanTask = sft_schedule_add(&schedule, sft_toNANOSEC(DAEMON_RESCAN_MS), sft_timer_now());
 
-		if (batteries->data[i].charge != batteryStatus.Capacity || 
-			batteries->data[i].isCharging != isCharging)
-			change = true;
+	while (!daemonStopped())
+	{
+		// Clients are serviced until the next poll or rescan is due
+		serviceDaemon(&daemon, sft_schedule_msUntil(&schedule, sft_timer_now()));
 
-		batteries->data[i].isCharging = isCharging;
-		batteries->data[i].charge = batteryStatus.Capacity;
+		uint32_t due = sft_schedule_due(&schedule, sft_timer_now());
+		bool changed = false;
 
-		batteries->data[i].capacity = batteryInfo.FullChargedCapacity;
+		if ((due >> rescanTask) & 1)
+			changed |= rescanBatteries(batteries, provider);
 
-		batteries->data[i].wear = batteryInfo.DesignedCapacity;
-		batteries->data[i].wear -= batteries->data[i].capacity;
+		if ((due >> pollTask) & 1)
+		{
+			changed |= updateBatteries(batteries, NULL);
+			feedBatteryEstimators(batteries, sft_toMILLISEC(sft_timer_now()));
+		}
+
+		if (changed)
+		{
+			recordHistory(history, batteries);
+			publishExport(shared, batteries);
+			publishDaemon(&daemon, batteries);
+		}
+
+#ifdef _DEBUG
+		if (sampleBatteryQueryRate(&queryRate, sft_timer_coarse()))
+			printf("Daemon: %u clients, %llu frames sent, %llu coalesced, %.2f queries/s\n", daemon.clientCount,
+				(unsigned long long)daemon.sent, (unsigned long long)daemon.coalesced, queryRate.perSec);
+#endif
 	}
 
-	return change;
+	closeDaemon(&daemon);
+	return 0;
 }
 
 
-static uint32_t getSystrayPos()
+static void closeTraces()
 {
-	// Get taskbar window handle, then get tray window handle
-	HWND taskHwnd = FindWindowA("Shell_TrayWnd", NULL);
-	HWND trayHwnd = FindWindowExA(taskHwnd, NULL, "TrayNotifyWnd", NULL);
-
-	RECT rect;
-	GetWindowRect(trayHwnd, &rect);
-	return rect.left;
+	stopBatteryRecording();
+	closeBatteryReplay();
 }
 
-
-static void draw(sft_window* win, sft_rect switchRect, sft_rect closeRect, BatteryInfo_array batteries, uint8_t drawMode)
+int main(int argc, char** argv)
 {
-	uint32_t totalCapacity = 0;
-	uint32_t totalCharge = 0;
-	bool isCharging = false;
-
-	for (uint32_t i = 0; i < batteries.length; i++)
+	// Before the poller, the daemon or a bench can read the clock from another thread
+	sft_timer_init();
+
+	const BatteryProvider* provider = defaultBatteryProvider();
+	uint32_t pollMs = BATTERY_POLL_MS;
+
+	// --replay <trace> [speed] reads batteries from a trace, --record <trace> writes one of what was read.
+	// --bench [name] runs the benches instead of the widget
+	bool daemon = false;
+	const char* recordPath = NULL;
+	const char* replayPath = NULL;
+	float replaySpeed = 1;
+	for (int i = 1; i < argc; i++)
 	{
-		totalCapacity += batteries.data[i].capacity;
-		totalCharge += batteries.data[i].charge;
-		if (batteries.data[i].isCharging)
-			isCharging = true;
+		if (strcmp(argv[i], "--daemon") == 0)
+			daemon = true;
+		else if (strcmp(argv[i], "--bench") == 0)
+			return runBenches(i + 1 < argc && argv[i + 1][0] != '-' ? argv[i + 1] : NULL);
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+		{
+			replayPath = argv[++i];
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				replaySpeed = strtof(argv[++i], NULL);
+		}
 	}
 
-	sft_window_fill(win, 0x00000000);
-
-	switch (drawMode)
+	if (replayPath)
 	{
-	case 0:
-		sft_window_drawTextF(win, 0, closeRect.y, 3,
-			isCharging ? 0xFF00FF00 : 0xFFFFFFFF, "%6.2f%%",
-			totalCapacity ? (totalCharge * 100.f / totalCapacity) : 0);
-		break;
-
-	case 1:
-		// Needed slightly more space, draw seperately slightly overlapped
-		sft_window_drawTextF(win, 8, closeRect.y + 10, 2,
-			isCharging ? 0xFF00FF00 : 0xFFFFFFFF, "%10u",
-			totalCapacity);
-		sft_window_drawTextF(win, 8, closeRect.y - 4, 2,
-			isCharging ? 0xFF00FF00 : 0xFFFFFFFF, "%10u",
-			totalCharge);
-		break;
+		if (!openBatteryReplay(replayPath, replaySpeed))
+		{
+			fprintf(stderr, "Could not load the trace %s\n", replayPath);
+			return 1;
+		}
+		provider = &replayBatteryProvider;
 
-	case 2:
-		sft_window_drawTextF(win, 0, closeRect.y, 3,
-			isCharging ? 0xFF00FF00 : 0xFFFFFFFF, "%6u%%",
-			totalCapacity ? (totalCharge * 100 / totalCapacity) : 0);
-		break;
+		// One recorded poll per poll, speed 0 steps through them as fast as the schedule allows
+		pollMs = replaySpeed > 0 ? (uint32_t)sft_max(BATTERY_POLL_MS / replaySpeed, 1) : 1;
+	}
 
-	case 3:
-		break;
+	if (recordPath)
+	{
+		if (!startBatteryRecording(provider, recordPath))
+		{
+			fprintf(stderr, "Could not create the trace %s\n", recordPath);
+			closeTraces();
+			return 1;
+		}
+		provider = &recordingBatteryProvider;
 	}
 
-	sft_window_drawChar(win, 'X', closeRect.x, closeRect.y, 3, 0xFFFF0000);
-	
-	sft_window_drawChar(win, sft_key_Down, switchRect.x, switchRect.y + 3, 3, 0xFF7F7F7F);
-	sft_window_drawChar(win, sft_key_Up, switchRect.x, switchRect.y - 1, 3, 0xFFBFBFBF);
+	// History is optional, appends do nothing if the file can not be mapped. Replays leave it alone
+	History history = { 0 };
+	if (!replayPath)
+		openHistory(&history, HISTORY_PATH);
 
-	sft_window_display(win);
-}
+	// Other processes map the live state instead of querying the batteries themselves.
+	// Optional too, publishes do nothing if another instance already writes the segment
+	BatteryExport shared = { 0 };
+	openExport(&shared, BATTERY_EXPORT_NAME);
 
+	if (daemon)
+	{
+		BatteryInfo_array batteries = getBatteries(provider);
+		feedBatteryEstimators(&batteries, sft_toMILLISEC(sft_timer_now()));
+		recordHistory(&history, &batteries);
+		publishExport(&shared, &batteries);
+
+		int result = runDaemon(provider, pollMs, &batteries, &history, &shared);
+		releaseBatteries(&batteries);
+		closeExport(&shared);
+		closeHistory(&history);
+		closeTraces();
+		return result;
+	}
 
-int main(int argc, char** argv)
-{
-	BatteryInfo_array batteries = getBatteries();
+	// Some firmware takes tens of milliseconds per query, reads stay off the message loop
+	BatteryOutputs outputs = { &history, &shared };
+	BatteryPoller poller;
+	if (!startPoller(&poller, provider, pollMs, onBatteriesChanged, &outputs))
+	{
+		fprintf(stderr, "Could not start the battery thread\n");
+		closeExport(&shared);
+		closeHistory(&history);
+		closeTraces();
+		return 1;
+	}
 
 	sft_init();
 
+	TaskbarTracker taskbar;
+	openTaskbar(&taskbar);
+	updateTaskbar(&taskbar);
+
 	sft_rect winRect;
 	winRect.w = 24 * 9.25;
 	winRect.h = 32;
-	winRect.x = getSystrayPos() - winRect.w;
+	winRect.x = taskbar.trayRect.x - winRect.w;
 	winRect.y = sft_screenHeight() - winRect.h;
 
-	sft_rect closeRect;
-	closeRect.w = 24;
-	closeRect.h = 24;
-	closeRect.x = winRect.w - closeRect.w;
-	closeRect.y = 8;
-
-	sft_rect switchRectUp;
-	switchRectUp.w = 24;
-	switchRectUp.h = 14;
-	switchRectUp.x = closeRect.x - switchRectUp.w;
-	switchRectUp.y = 4;
-
-	sft_rect switchRectDown;
-	switchRectDown.w = 24;
-	switchRectDown.h = 14;
-	switchRectDown.x = closeRect.x - switchRectDown.w;
-	switchRectDown.y = switchRectUp.y + switchRectUp.h;
-
 	uint8_t drawMode = 0;
-	uint8_t numDrawModes = 4;
-
-	bool hoverSwitchUp = false;
-	bool hoverSwitchDown = false;
-	bool hoverClose = false;
+	DrawState drawState = { 0 };
+	buildUi(&drawState, winRect);
+	uint8_t numDrawModes = 5;
 
 
 	sft_window* win = sft_window_open("",
 		winRect.w, winRect.h, winRect.x, winRect.y,
-		sft_flag_borderless | sft_flag_noresize | sft_flag_syshide | sft_flag_topmost);
+		sft_flag_borderless | sft_flag_noresize | sft_flag_syshide | sft_flag_topmost | sft_flag_alpha | sft_flag_taskbar);
+	taskbar.window = win->handle;
+
+	// Empty until the thread's first read, which wakes the loop
+	const BatterySnapshot* snapshot = acquireSnapshot(&poller);
+	uint64_t shownGeneration = snapshot->generation;
+	uint64_t shownSamples = snapshot->samples;
+	draw(win, &drawState, snapshot, drawMode);
 
-	draw(win, switchRectUp, closeRect, batteries, drawMode);
+	SystemChanges changes = { 0 };
+	win->userData = &changes;
+	win->onSystemChange = onSystemChange;
 
+	// Only the left button and where it is are used
+	sft_input_subscribeAll(false);
+	sft_input_subscribe(sft_inputEvent_click, sft_click_Left, true);
+	sft_input_subscribe(sft_inputEvent_move, 0, true);
+
+#ifdef _DEBUG
+	WindowManagerCallRate callRate = { .lastTime = sft_timer_coarse() };
+#endif
 
 	while (sft_window_update(win))
 	{
 		sft_input_update();
 
-		winRect.x = getSystrayPos() - winRect.w;
-		winRect.y = sft_screenHeight() - winRect.h;
+		if (changes.taskbar)
+		{
+			changes.taskbar = false;
+			invalidateTaskbar(&taskbar);
+		}
+
+		// Only follow the tray when it actually moved
+		if (updateTaskbar(&taskbar))
+		{
+			winRect.x = taskbar.trayRect.x - winRect.w;
+			winRect.y = sft_screenHeight() - winRect.h;
+
+			sft_window_setPos(win, winRect.x, winRect.y);
+			windowManagerCalls++;
+			taskbar.raise = true;
+		}
 
-		sft_window_setTopmost(win, true);
-		sft_window_setPos(win, winRect.x, winRect.y);
+		// Another window in front may have covered ours
+		if (taskbar.raise)
+		{
+			taskbar.raise = false;
+			sft_window_setTopmost(win, true);
+			windowManagerCalls++;
+		}
 
 
 
-		if (hoverClose && sft_input_clickReleased(sft_click_Left))
+		sft_widgetId clicked = sft_ui_update(&drawState.ui);
+		if (clicked == drawState.close)
 			break;
-		hoverClose = sft_colPointRect(closeRect, sft_input_mousePos(win)) &&
-			sft_input_clickState(sft_click_Left);
 
-		if (hoverSwitchUp && sft_input_clickReleased(sft_click_Left))
+		if (clicked == drawState.switchUp || clicked == drawState.switchDown)
 		{
-			MODINC(drawMode, numDrawModes);
-			draw(win, switchRectUp, closeRect, batteries, drawMode);
+			if (clicked == drawState.switchUp)
+				MODINC(drawMode, numDrawModes);
+			else
+				MODDEC(drawMode, numDrawModes);
+
+			// The estimate moves with every sample, not just with the charge
+			watchPollerSamples(&poller, drawMode == 3);
+			draw(win, &drawState, snapshot, drawMode);
 		}
-		hoverSwitchUp = sft_colPointRect(switchRectUp, sft_input_mousePos(win)) &&
-			sft_input_clickState(sft_click_Left);
 
-		if (hoverSwitchDown && sft_input_clickReleased(sft_click_Left))
+
+
+		if (changes.devices)
 		{
-			MODDEC(drawMode, numDrawModes);
-			draw(win, switchRectUp, closeRect, batteries, drawMode);
+			changes.devices = false;
+			rescanPoller(&poller);
 		}
-		hoverSwitchDown = sft_colPointRect(switchRectDown, sft_input_mousePos(win)) &&
-			sft_input_clickState(sft_click_Left);
-
 
+		snapshot = acquireSnapshot(&poller);
+		if (snapshot->generation != shownGeneration ||
+			(drawMode == 3 && snapshot->samples != shownSamples))
+		{
+			shownGeneration = snapshot->generation;
+			shownSamples = snapshot->samples;
+			draw(win, &drawState, snapshot, drawMode);
+		}
 
-		if (updateBatteries(&batteries))
-			draw(win, switchRectUp, closeRect, batteries, drawMode);
+#ifdef _DEBUG
+		if (sampleWindowManagerCallRate(&callRate, sft_timer_coarse()))
+		{
+			printf("Window manager calls: %.2f/min\n", callRate.perMin);
+			printf("Present: %llu frames, %.3fms mean, %.3fms max\n", (unsigned long long)drawState.presents,
+				drawState.presents ? drawState.presentNs / 1000000.0 / drawState.presents : 0, drawState.maxPresentNs / 1000000.0);
+			drawState.presents = drawState.presentNs = drawState.maxPresentNs = 0;
+		}
+#endif
 
-		sft_sleep(50);
+		// Only messages and new snapshots wake the loop
+		void* events[] = { pollerEvent(&poller) };
+		sft_window_wait(win, events, 1, UINT32_MAX);
 	}
 
 
-	for (uint32_t i = 0; i < batteries.length; i++)
-		releaseBattery(&batteries.data[i]);
-	free(batteries.data);
+	stopPoller(&poller);
+	closeExport(&shared);
+	closeHistory(&history);
+	closeTraces();
+	closeTaskbar(&taskbar);
 
+	sft_ui_free(&drawState.ui);
 	sft_window_close(win);
 	sft_shutdown();
 
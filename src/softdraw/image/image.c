@@ -1,4 +1,5 @@
 #include "image.h"
+#include <string.h>
 
 sft_image* sft_image_create(uint32_t width, uint32_t height)
 {
@@ -6,6 +7,7 @@ sft_image* sft_image_create(uint32_t width, uint32_t height)
     if (image)
     {
         image->pixels = NULL;
+        image->blend = sft_blend_copy;
         sft_image_resize(image, width, height);
         return image;
     }
@@ -35,8 +37,7 @@ void sft_image_fill(sft_image* image, sft_color color)
     if (!image || !image->pixels)
         return;
 
-    for (uint64_t i = 0; i < (uint64_t)image->width * image->height; i++)
-        image->pixels[i] = color;
+    _sft_image_fillRow(image->pixels, (uint64_t)image->width * image->height, color);
 }
 
 void sft_image_delete(sft_image* image)
@@ -69,10 +70,43 @@ void sft_image_drawImage(sft_image* dest, const sft_image* src,
     _sft_image_adjustRect(&srcX, &srcY, &srcW, &srcH, src->width, src->height);
     _sft_image_adjustRect(&destX, &destY, &srcW, &srcH, dest->width, dest->height);
 
-    for (uint64_t y = 0; y < srcH; y++)
-        for (uint64_t x = 0; x < srcW; x++)
-            dest->pixels[(x + destX) + (y + destY) * dest->width] = 
-            src->pixels[(x + srcX) + (y + srcY) * src->width];
+    if (!srcW || !srcH)
+        return;
+
+    sft_color* destRow = dest->pixels + destX + (uint64_t)destY * dest->width;
+    const sft_color* srcRow = src->pixels + srcX + (uint64_t)srcY * src->width;
+
+    // Blending reads each source pixel once, only copies may overlap themselves
+    if (dest->blend == sft_blend_over && dest != src)
+    {
+        for (uint64_t y = 0; y < srcH; y++)
+        {
+            _sft_image_blendSpan(destRow, srcRow, srcW);
+            destRow += dest->width;
+            srcRow += src->width;
+        }
+        return;
+    }
+
+    // Copying down within the same image has to start from the bottom row
+    if (dest == src && destY > srcY)
+    {
+        destRow += (uint64_t)(srcH - 1) * dest->width;
+        srcRow += (uint64_t)(srcH - 1) * src->width;
+        for (uint64_t y = 0; y < srcH; y++)
+        {
+            memmove(destRow, srcRow, srcW * sizeof(sft_color));
+            destRow -= dest->width;
+            srcRow -= src->width;
+        }
+    }
+    else
+        for (uint64_t y = 0; y < srcH; y++)
+        {
+            memmove(destRow, srcRow, srcW * sizeof(sft_color));
+            destRow += dest->width;
+            srcRow += src->width;
+        }
 }
 
 void sft_image_drawRect(sft_image* dest, int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color)
@@ -81,10 +115,29 @@ void sft_image_drawRect(sft_image* dest, int32_t x, int32_t y, uint32_t w, uint3
         return;
 
     _sft_image_adjustRect(&x, &y, &w, &h, dest->width, dest->height);
+    if (!w)
+        return;
+
+    void (*drawRow)(sft_color*, uint64_t, sft_color) =
+        dest->blend == sft_blend_over ? _sft_image_blendRow : _sft_image_fillRow;
+
+    sft_color* row = dest->pixels + x + (uint64_t)y * dest->width;
+    for (uint64_t yy = 0; yy < h; yy++, row += dest->width)
+        drawRow(row, w, color);
+}
+
+void sft_image_fillRect(sft_image* dest, int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color)
+{
+    if (!dest || !dest->pixels)
+        return;
+
+    _sft_image_adjustRect(&x, &y, &w, &h, dest->width, dest->height);
+    if (!w)
+        return;
 
-    for (uint64_t yy = 0; yy < h; yy++)
-        for (uint64_t xx = 0; xx < w; xx++)
-            dest->pixels[(xx + x) + (yy + y) * dest->width] = color;
+    sft_color* row = dest->pixels + x + (uint64_t)y * dest->width;
+    for (uint64_t yy = 0; yy < h; yy++, row += dest->width)
+        _sft_image_fillRow(row, w, color);
 }
 
 void sft_image_outlineRect(sft_image* dest, int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color)
@@ -176,43 +229,151 @@ void sft_image_drawText(sft_image* dest, const char* text, int32_t x, int32_t y,
 
 void sft_image_drawTextF(sft_image* dest, int32_t x, int32_t y, uint32_t fontSize, sft_color color, const char* fmt, ...)
 {
-    va_list args1, args2;
-    va_start(args1, fmt);
-    va_copy(args2, args1);
+    // Short strings never touch the heap
+    char stack[sft_STRF_STACK];
 
-    uint64_t size = vsnprintf(NULL, 0, fmt, args1);
-
-    char* buf = malloc(size + 1);
-    if (buf)
-        vsnprintf(buf, size + 1, fmt, args2);
-
-    va_end(args1);
-    va_end(args2);
+    va_list args;
+    va_start(args, fmt);
+    char* buf = sft_vstrfBuf(stack, sizeof(stack), fmt, args);
+    va_end(args);
     
 
     if (buf)
     {
         sft_image_drawText(dest, buf, x, y, fontSize, color);
-        free(buf);
+        sft_strfFree(buf, stack);
     }
 }
 
+typedef struct
+{
+    // Source rows scaled horizontally, bit n is destination column n
+    uint64_t rows[8];
+    uint64_t lastUse;
+    uint16_t key;
+} _sft_glyph;
+
+static _sft_glyph _sft_glyphs[sft_GLYPH_CACHE_COUNT];
+static uint32_t _sft_glyphCount = 0;
+// Glyph index + 1 for every (char, fontSize), 0 when not cached
+static uint8_t _sft_glyphSlots[128 * sft_GLYPH_CACHE_MAX_SIZE];
+static uint64_t _sft_glyphClock = 0;
+static sft_glyphCacheStats _sft_glyphStats = { 0 };
+static bool _sft_glyphCacheOn = true;
+
+static const uint64_t* _sft_glyphCache_get(uint8_t ch, uint32_t fontSize)
+{
+    uint16_t key = ch * sft_GLYPH_CACHE_MAX_SIZE + fontSize - 1;
+
+    if (_sft_glyphSlots[key])
+    {
+        _sft_glyph* glyph = &_sft_glyphs[_sft_glyphSlots[key] - 1];
+        glyph->lastUse = ++_sft_glyphClock;
+        _sft_glyphStats.hits++;
+        return glyph->rows;
+    }
+    _sft_glyphStats.misses++;
+
+    uint32_t index = 0;
+    if (_sft_glyphCount < sft_GLYPH_CACHE_COUNT)
+        index = _sft_glyphCount++;
+    else
+    {
+        for (uint32_t i = 1; i < sft_GLYPH_CACHE_COUNT; i++)
+            if (_sft_glyphs[i].lastUse < _sft_glyphs[index].lastUse)
+                index = i;
+        _sft_glyphSlots[_sft_glyphs[index].key] = 0;
+        _sft_glyphStats.evictions++;
+    }
+
+    _sft_glyph* glyph = &_sft_glyphs[index];
+    glyph->key = key;
+    glyph->lastUse = ++_sft_glyphClock;
+
+    uint64_t cell = (1ull << fontSize) - 1;
+    for (uint32_t yr = 0; yr < 8; yr++)
+    {
+        uint8_t bits = (_sft_font[ch] >> (56 - yr * 8)) & 0xFF;
+
+        glyph->rows[yr] = 0;
+        for (uint32_t xr = 0; xr < 8; xr++)
+            if (sft_getBit(bits, 7 - xr))
+                glyph->rows[yr] |= cell << (xr * fontSize);
+    }
+
+    _sft_glyphSlots[key] = index + 1;
+    return glyph->rows;
+}
+
+sft_glyphCacheStats sft_image_glyphCacheStats()
+{
+    return _sft_glyphStats;
+}
+
+void sft_image_clearGlyphCache()
+{
+    memset(_sft_glyphSlots, 0, sizeof(_sft_glyphSlots));
+    memset(&_sft_glyphStats, 0, sizeof(_sft_glyphStats));
+    _sft_glyphCount = 0;
+    _sft_glyphClock = 0;
+}
+
+void sft_image_setGlyphCache(bool enabled)
+{
+    _sft_glyphCacheOn = enabled;
+}
+
 void sft_image_drawChar(sft_image* dest, char ch, int32_t x, int32_t y, uint32_t fontSize, sft_color color)
 {
-    if (!dest || ch > 127)
+    if (!dest || !dest->pixels || !fontSize ||
+        (uint8_t)ch >= sizeof(_sft_font) / sizeof(*_sft_font))
         return;
 
+    int32_t left = x;
+    int32_t top = y;
     uint32_t width = fontSize * 8;
     uint32_t height = fontSize * 8;
 
     _sft_image_adjustRect(&x, &y, &width, &height, dest->width, dest->height);
 
+    void (*drawRow)(sft_color*, uint64_t, sft_color) =
+        dest->blend == sft_blend_over ? _sft_image_blendRow : _sft_image_fillRow;
+
+    if (fontSize > sft_GLYPH_CACHE_MAX_SIZE || !_sft_glyphCacheOn)
+    {
+        for (uint32_t yp = 0; yp < height; yp++)
+            for (uint32_t xp = 0; xp < width; xp++)
+            {
+                uint32_t yr = (yp + y - top) / fontSize;
+                uint32_t xr = (xp + x - left) / fontSize;
+                if (sft_getBit(_sft_font[ch], 63 - (xr + yr * 8)))
+                    drawRow(dest->pixels + (xp + x) + (yp + y) * dest->width, 1, color);
+            }
+        return;
+    }
+
+    const uint64_t* rows = _sft_glyphCache_get(ch, fontSize);
+
+    // Columns cut off on the left are shifted out, on the right masked off
+    uint32_t skipX = x - left;
+    uint32_t skipY = y - top;
+    uint64_t visible = width >= 64 ? ~0ull : (1ull << width) - 1;
+
     for (uint32_t yp = 0; yp < height; yp++)
-        for (uint32_t xp = 0; xp < width; xp++)
+    {
+        uint64_t mask = (rows[(yp + skipY) / fontSize] >> skipX) & visible;
+        sft_color* row = dest->pixels + x + (uint64_t)(yp + y) * dest->width;
+
+        // Fill each run of set bits
+        while (mask)
         {
-            uint32_t yr = yp / fontSize;
-            uint32_t xr = xp / fontSize;
-            if (sft_getBit(_sft_font[ch], 63 - (xr + yr * 8)))
-                dest->pixels[(xp + x) + (yp + y) * dest->width] = color;
+            uint32_t start = sft_ctz64(mask);
+            uint64_t rest = ~(mask >> start);
+            uint32_t run = rest ? sft_ctz64(rest) : 64 - start;
+
+            drawRow(row + start, run, color);
+
+            mask = run + start >= 64 ? 0 : mask & (~0ull << (start + run));
         }
-}
+    }
+}
\ No newline at end of file
@@ -12,13 +12,71 @@ extern "C" {
 
 typedef uint32_t sft_color;
 
+/**
+* \brief How drawRect, drawImage and drawChar combine with the pixels already there
+*/
+typedef enum
+{
+    // Overwrite, alpha included
+    sft_blend_copy,
+    // Premultiplied source over, colors have to be premultiplied with sft_premultiply
+    sft_blend_over,
+} sft_blend;
+
 typedef struct
 {
     sft_color* pixels;
     uint32_t width;
     uint32_t height;
+    /**
+    * \brief Blend mode of draws to this image, fills and outlines always overwrite
+    */
+    sft_blend blend;
 } sft_image;
 
+/**
+* \brief Scales the color channels by the alpha, for drawing with sft_blend_over
+*/
+static inline sft_color sft_premultiply(sft_color color)
+{
+    uint32_t alpha = color >> 24;
+    sft_color out = color & 0xFF000000;
+    for (uint32_t shift = 0; shift < 24; shift += 8)
+    {
+        uint32_t t = ((color >> shift) & 0xFF) * alpha + 128;
+        out |= ((t + (t >> 8)) >> 8) << shift;
+    }
+    return out;
+}
+
+// Largest font size kept in the glyph cache, bigger text is drawn pixel by pixel
+#define sft_GLYPH_CACHE_MAX_SIZE 8
+// Glyphs kept in the cache before the least recently used is replaced
+#define sft_GLYPH_CACHE_COUNT 64
+
+typedef struct
+{
+    /**
+    * \brief Draws that found their glyph in the cache
+    */
+    uint64_t hits;
+    /**
+    * \brief Draws that had to expand their glyph
+    */
+    uint64_t misses;
+    /**
+    * \brief Glyphs replaced to make room
+    */
+    uint64_t evictions;
+} sft_glyphCacheStats;
+
+typedef enum
+{
+    sft_simd_none,
+    sft_simd_sse2,
+    sft_simd_avx2,
+} sft_simd;
+
 
 static const uint64_t _sft_font[] =
 {
@@ -201,6 +259,18 @@ void sft_image_drawImage(sft_image* dest, const sft_image* src,
 void sft_image_drawRect(sft_image* dest, 
     int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color);
 
+/**
+* \brief Overwrites pixels in rectangle with a color whatever the blend mode, for clearing
+* \param dest Destination image to draw to
+* \param x Leftmost position of rectangle
+* \param y Topmost position of rectangle
+* \param w Width of rectangle
+* \param h Height of rectangle
+* \param color Color the rectangle ends up, alpha included
+*/
+void sft_image_fillRect(sft_image* dest,
+    int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color);
+
 /**
 * \brief Outlines pixels in rectangle with a color
 * \param dest Destination image to draw to
@@ -263,6 +333,57 @@ Draws a character to an image
 void sft_image_drawChar(sft_image* dest, char ch,
     int32_t x, int32_t y, uint32_t fontSize, sft_color color);
 
+/**
+* \brief Returns the instruction set used by the fill and blend kernels
+*/
+sft_simd sft_image_simd();
+
+/**
+* \brief Limits the kernels to an instruction set, mostly to test against the scalar path
+* \param level The highest instruction set to use, lowered to what the CPU supports
+*/
+void sft_image_setSimd(sft_simd level);
+
+/**
+* \brief Internal function to fill a run of pixels with the selected kernel
+* \param dest The first pixel to fill
+* \param count The number of pixels to fill
+* \param color Color to fill with
+*/
+void _sft_image_fillRow(sft_color* dest, uint64_t count, sft_color color);
+
+/**
+* \brief Internal function to blend a premultiplied color over a run of pixels with the selected kernel
+* \param dest The first pixel to blend onto
+* \param count The number of pixels
+* \param color Premultiplied color to blend
+*/
+void _sft_image_blendRow(sft_color* dest, uint64_t count, sft_color color);
+
+/**
+* \brief Internal function to blend a run of premultiplied pixels over another with the selected kernel
+* \param dest The first pixel to blend onto
+* \param src The first pixel to blend, must not overlap dest
+* \param count The number of pixels
+*/
+void _sft_image_blendSpan(sft_color* dest, const sft_color* src, uint64_t count);
+
+/**
+* \brief Returns the hit and miss counts of the glyph cache used by sft_image_drawChar
+*/
+sft_glyphCacheStats sft_image_glyphCacheStats();
+
+/**
+* \brief Empties the glyph cache and resets its statistics
+*/
+void sft_image_clearGlyphCache();
+
+/**
+* \brief Turns the glyph cache off or on, mostly to test against the per-pixel path
+* \param enabled False draws every size pixel by pixel, like sizes past sft_GLYPH_CACHE_MAX_SIZE
+*/
+void sft_image_setGlyphCache(bool enabled);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
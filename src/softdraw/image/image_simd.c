@@ -0,0 +1,348 @@
+#include "image.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SFT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SFT_TARGET(isa)
+#else
+#include <cpuid.h>
+#define SFT_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+static void fillRow_scalar(sft_color* dest, uint64_t count, sft_color color)
+{
+    for (uint64_t i = 0; i < count; i++)
+        dest[i] = color;
+}
+
+// Source over for premultiplied colors, x / 255 rounded exactly so every kernel agrees
+static inline sft_color blendPixel(sft_color dest, sft_color src)
+{
+    uint32_t inv = 255 - (src >> 24);
+    sft_color out = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8)
+    {
+        uint32_t t = ((dest >> shift) & 0xFF) * inv + 128;
+        uint32_t value = ((src >> shift) & 0xFF) + ((t + (t >> 8)) >> 8);
+        out |= sft_min(value, 255) << shift;
+    }
+    return out;
+}
+
+static void blendRow_scalar(sft_color* dest, uint64_t count, sft_color color)
+{
+    for (uint64_t i = 0; i < count; i++)
+        dest[i] = blendPixel(dest[i], color);
+}
+
+static void blendSpan_scalar(sft_color* dest, const sft_color* src, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++)
+        dest[i] = blendPixel(dest[i], src[i]);
+}
+
+#ifdef SFT_X86
+SFT_TARGET("sse2")
+static void fillRow_sse2(sft_color* dest, uint64_t count, sft_color color)
+{
+    // Scalar until the destination is 16 byte aligned
+    while (count && ((uintptr_t)dest & 15))
+    {
+        *dest++ = color;
+        count--;
+    }
+
+    __m128i value = _mm_set1_epi32((int32_t)color);
+    for (; count >= 16; count -= 16, dest += 16)
+    {
+        _mm_store_si128((__m128i*)dest + 0, value);
+        _mm_store_si128((__m128i*)dest + 1, value);
+        _mm_store_si128((__m128i*)dest + 2, value);
+        _mm_store_si128((__m128i*)dest + 3, value);
+    }
+    for (; count >= 4; count -= 4, dest += 4)
+        _mm_store_si128((__m128i*)dest, value);
+
+    while (count--)
+        *dest++ = color;
+}
+
+SFT_TARGET("avx2")
+static void fillRow_avx2(sft_color* dest, uint64_t count, sft_color color)
+{
+    // Scalar until the destination is 32 byte aligned
+    while (count && ((uintptr_t)dest & 31))
+    {
+        *dest++ = color;
+        count--;
+    }
+
+    __m256i value = _mm256_set1_epi32((int32_t)color);
+    for (; count >= 32; count -= 32, dest += 32)
+    {
+        _mm256_store_si256((__m256i*)dest + 0, value);
+        _mm256_store_si256((__m256i*)dest + 1, value);
+        _mm256_store_si256((__m256i*)dest + 2, value);
+        _mm256_store_si256((__m256i*)dest + 3, value);
+    }
+    for (; count >= 8; count -= 8, dest += 8)
+        _mm256_store_si256((__m256i*)dest, value);
+
+    while (count--)
+        *dest++ = color;
+}
+
+// Scales 8 channels widened to 16 bits by inv / 255, rounded like blendPixel
+SFT_TARGET("sse2")
+static inline __m128i scale_sse2(__m128i channels, __m128i inv)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(channels, inv), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+SFT_TARGET("sse2")
+static void blendRow_sse2(sft_color* dest, uint64_t count, sft_color color)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i src = _mm_set1_epi32((int32_t)color);
+    __m128i inv = _mm_set1_epi16((int16_t)(255 - (color >> 24)));
+
+    for (; count >= 4; count -= 4, dest += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)dest);
+        __m128i lo = scale_sse2(_mm_unpacklo_epi8(d, zero), inv);
+        __m128i hi = scale_sse2(_mm_unpackhi_epi8(d, zero), inv);
+        _mm_storeu_si128((__m128i*)dest, _mm_adds_epu8(_mm_packus_epi16(lo, hi), src));
+    }
+
+    blendRow_scalar(dest, count, color);
+}
+
+SFT_TARGET("sse2")
+static void blendSpan_sse2(sft_color* dest, const sft_color* src, uint64_t count)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(255);
+
+    for (; count >= 4; count -= 4, dest += 4, src += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)src);
+        __m128i d = _mm_loadu_si128((const __m128i*)dest);
+
+        // Each pixel's alpha spread over its own four channels
+        __m128i slo = _mm_unpacklo_epi8(s, zero);
+        __m128i shi = _mm_unpackhi_epi8(s, zero);
+        __m128i invLo = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, 0xFF), 0xFF));
+        __m128i invHi = _mm_sub_epi16(full, _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, 0xFF), 0xFF));
+
+        __m128i lo = scale_sse2(_mm_unpacklo_epi8(d, zero), invLo);
+        __m128i hi = scale_sse2(_mm_unpackhi_epi8(d, zero), invHi);
+        _mm_storeu_si128((__m128i*)dest, _mm_adds_epu8(_mm_packus_epi16(lo, hi), s));
+    }
+
+    blendSpan_scalar(dest, src, count);
+}
+
+SFT_TARGET("avx2")
+static inline __m256i scale_avx2(__m256i channels, __m256i inv)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(channels, inv), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+SFT_TARGET("avx2")
+static void blendRow_avx2(sft_color* dest, uint64_t count, sft_color color)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i src = _mm256_set1_epi32((int32_t)color);
+    __m256i inv = _mm256_set1_epi16((int16_t)(255 - (color >> 24)));
+
+    // Unpack and pack both work within 128 bit lanes, so pixels come back in place
+    for (; count >= 8; count -= 8, dest += 8)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i*)dest);
+        __m256i lo = scale_avx2(_mm256_unpacklo_epi8(d, zero), inv);
+        __m256i hi = scale_avx2(_mm256_unpackhi_epi8(d, zero), inv);
+        _mm256_storeu_si256((__m256i*)dest, _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), src));
+    }
+
+    blendRow_scalar(dest, count, color);
+}
+
+SFT_TARGET("avx2")
+static void blendSpan_avx2(sft_color* dest, const sft_color* src, uint64_t count)
+{
+    __m256i zero = _mm256_setzero_si256();
+    __m256i full = _mm256_set1_epi16(255);
+
+    for (; count >= 8; count -= 8, dest += 8, src += 8)
+    {
+        __m256i s = _mm256_loadu_si256((const __m256i*)src);
+        __m256i d = _mm256_loadu_si256((const __m256i*)dest);
+
+        __m256i slo = _mm256_unpacklo_epi8(s, zero);
+        __m256i shi = _mm256_unpackhi_epi8(s, zero);
+        __m256i invLo = _mm256_sub_epi16(full, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(slo, 0xFF), 0xFF));
+        __m256i invHi = _mm256_sub_epi16(full, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(shi, 0xFF), 0xFF));
+
+        __m256i lo = scale_avx2(_mm256_unpacklo_epi8(d, zero), invLo);
+        __m256i hi = scale_avx2(_mm256_unpackhi_epi8(d, zero), invHi);
+        _mm256_storeu_si256((__m256i*)dest, _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), s));
+    }
+
+    blendSpan_scalar(dest, src, count);
+}
+
+static sft_simd detectSimd()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] >> 26) & 1;
+    // AVX registers also have to be saved by the OS
+    bool avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) &&
+        (_xgetbv(0) & 6) == 6;
+
+    bool avx2 = false;
+    if (avx && maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] >> 5) & 1;
+    }
+#else
+    __builtin_cpu_init();
+    bool sse2 = __builtin_cpu_supports("sse2");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    if (avx2)
+        return sft_simd_avx2;
+    if (sse2)
+        return sft_simd_sse2;
+    return sft_simd_none;
+}
+#else
+static sft_simd detectSimd()
+{
+    return sft_simd_none;
+}
+#endif
+
+static void fillRow_detect(sft_color* dest, uint64_t count, sft_color color);
+static void blendRow_detect(sft_color* dest, uint64_t count, sft_color color);
+static void blendSpan_detect(sft_color* dest, const sft_color* src, uint64_t count);
+
+static void (*_sft_fillRow)(sft_color*, uint64_t, sft_color) = fillRow_detect;
+static void (*_sft_blendRow)(sft_color*, uint64_t, sft_color) = blendRow_detect;
+static void (*_sft_blendSpan)(sft_color*, const sft_color*, uint64_t) = blendSpan_detect;
+static sft_simd _sft_simdLevel = sft_simd_none;
+static sft_simd _sft_simdSupported = sft_simd_none;
+static bool _sft_simdDetected = false;
+
+void sft_image_setSimd(sft_simd level)
+{
+    if (!_sft_simdDetected)
+    {
+        _sft_simdSupported = detectSimd();
+        _sft_simdDetected = true;
+    }
+
+    _sft_simdLevel = sft_min(level, _sft_simdSupported);
+
+    switch (_sft_simdLevel)
+    {
+#ifdef SFT_X86
+    case sft_simd_avx2:
+        _sft_fillRow = fillRow_avx2;
+        _sft_blendRow = blendRow_avx2;
+        _sft_blendSpan = blendSpan_avx2;
+        break;
+
+    case sft_simd_sse2:
+        _sft_fillRow = fillRow_sse2;
+        _sft_blendRow = blendRow_sse2;
+        _sft_blendSpan = blendSpan_sse2;
+        break;
+#endif
+
+    default:
+        _sft_fillRow = fillRow_scalar;
+        _sft_blendRow = blendRow_scalar;
+        _sft_blendSpan = blendSpan_scalar;
+    }
+}
+
+sft_simd sft_image_simd()
+{
+    if (!_sft_simdDetected)
+        sft_image_setSimd(sft_simd_avx2);
+    return _sft_simdLevel;
+}
+
+static void fillRow_detect(sft_color* dest, uint64_t count, sft_color color)
+{
+    sft_image_setSimd(sft_simd_avx2);
+    _sft_fillRow(dest, count, color);
+}
+
+void _sft_image_fillRow(sft_color* dest, uint64_t count, sft_color color)
+{
+    // Short runs are not worth the call through the kernel pointer
+    if (count < 8)
+    {
+        for (uint64_t i = 0; i < count; i++)
+            dest[i] = color;
+        return;
+    }
+
+    _sft_fillRow(dest, count, color);
+}
+
+static void blendRow_detect(sft_color* dest, uint64_t count, sft_color color)
+{
+    sft_image_setSimd(sft_simd_avx2);
+    _sft_blendRow(dest, count, color);
+}
+
+static void blendSpan_detect(sft_color* dest, const sft_color* src, uint64_t count)
+{
+    sft_image_setSimd(sft_simd_avx2);
+    _sft_blendSpan(dest, src, count);
+}
+
+void _sft_image_blendRow(sft_color* dest, uint64_t count, sft_color color)
+{
+    // Opaque is a fill and fully transparent changes nothing
+    if ((color >> 24) == 0xFF)
+    {
+        _sft_image_fillRow(dest, count, color);
+        return;
+    }
+    if (!color)
+        return;
+
+    if (count < 4)
+    {
+        blendRow_scalar(dest, count, color);
+        return;
+    }
+
+    _sft_blendRow(dest, count, color);
+}
+
+void _sft_image_blendSpan(sft_color* dest, const sft_color* src, uint64_t count)
+{
+    if (count < 4)
+    {
+        blendSpan_scalar(dest, src, count);
+        return;
+    }
+
+    _sft_blendSpan(dest, src, count);
+}
\ No newline at end of file
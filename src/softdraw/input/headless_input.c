@@ -0,0 +1,43 @@
+#include "../window/headless.h"
+
+#if defined(SFT_HEADLESS) || !defined(_WIN32)
+
+static sft_point _sft_headlessMouse = { 0 };
+
+void sft_headless_setMouse(int32_t x, int32_t y)
+{
+    _sft_headlessMouse.x = x;
+    _sft_headlessMouse.y = y;
+}
+
+void sft_headless_setKey(sft_key key, bool down)
+{
+    sft_inputEvent event = { .type = sft_inputEvent_key, .code = key, .down = down };
+    sft_input_pushEvent(event);
+}
+
+void sft_headless_setClick(sft_click button, bool down)
+{
+    sft_inputEvent event = { .type = sft_inputEvent_click, .code = button, .down = down };
+    sft_input_pushEvent(event);
+}
+
+sft_point sft_input_mousePos(const sft_window* window)
+{
+    sft_point pt = _sft_headlessMouse;
+
+    if (window)
+    {
+        pt.x -= window->left;
+        pt.y -= window->top;
+    }
+
+    return pt;
+}
+
+void _sft_input_update()
+{
+    // Everything arrives as events
+}
+
+#endif
\ No newline at end of file
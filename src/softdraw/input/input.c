@@ -1,10 +1,28 @@
 #include "input.h"
 
+#include <string.h>
+
 sft_key sft_input_keys[sft_key_Count] = { 0 };
 sft_key sft_input_clicks[sft_click_Count] = { 0 };
 
 sft_key sft_input_typed = 0;
 
+// Events waiting for the next update
+static sft_inputEvent _sft_input_queue[sft_INPUT_QUEUE];
+static uint32_t _sft_input_head = 0;
+static uint32_t _sft_input_count = 0;
+
+// State between events, a key stays down until its release arrives
+static bool _sft_input_heldKeys[sft_key_Count] = { 0 };
+static bool _sft_input_heldClicks[sft_click_Count] = { 0 };
+static bool _sft_input_moved = false;
+static sft_point _sft_input_mouse = { sft_input_outside, sft_input_outside };
+
+// Unsubscribed events, zero so everything is tracked by default
+static uint64_t _sft_input_ignoredKeys[(sft_key_Count + 63) / 64] = { 0 };
+static uint64_t _sft_input_ignoredClicks = 0;
+static bool _sft_input_ignoredMove = false;
+
 char sft_input_typedChar()
 {
 	bool shift = sft_input_keyState(sft_key_Shift);
@@ -62,6 +80,120 @@ char sft_input_typedChar()
 	return 0;
 }
 
+static void applyEvent(sft_inputEvent event)
+{
+	switch (event.type)
+	{
+	case sft_inputEvent_key:
+		_sft_input_heldKeys[event.code] = event.down;
+		// A press and release within one update still counts as pressed
+		if (event.down)
+			sft_input_keys[event.code] |= 1;
+		break;
+
+	case sft_inputEvent_click:
+		_sft_input_heldClicks[event.code] = event.down;
+		if (event.down)
+			sft_input_clicks[event.code] |= 1;
+		_sft_input_mouse.x = event.x;
+		_sft_input_mouse.y = event.y;
+		break;
+
+	case sft_inputEvent_move:
+		_sft_input_moved = true;
+		_sft_input_mouse.x = event.x;
+		_sft_input_mouse.y = event.y;
+		break;
+	}
+}
+
+void sft_input_pushEvent(sft_inputEvent event)
+{
+	if (!sft_input_subscribed(event.type, event.code))
+		return;
+
+	// Full queue applies the oldest event now rather than losing a release
+	if (_sft_input_count == sft_INPUT_QUEUE)
+	{
+		applyEvent(_sft_input_queue[_sft_input_head]);
+		_sft_input_head = (_sft_input_head + 1) % sft_INPUT_QUEUE;
+		_sft_input_count--;
+	}
+
+	_sft_input_queue[(_sft_input_head + _sft_input_count) % sft_INPUT_QUEUE] = event;
+	_sft_input_count++;
+}
+
+void sft_input_subscribe(sft_inputEventType type, uint8_t code, bool value)
+{
+	switch (type)
+	{
+	case sft_inputEvent_key:
+		if (code < sft_key_Count)
+		{
+			sft_setFlag(_sft_input_ignoredKeys[code / 64], 1ull << (code % 64), !value);
+			if (!value)
+				_sft_input_heldKeys[code] = false;
+		}
+		break;
+
+	case sft_inputEvent_click:
+		if (code < sft_click_Count)
+		{
+			sft_setFlag(_sft_input_ignoredClicks, 1ull << code, !value);
+			if (!value)
+				_sft_input_heldClicks[code] = false;
+		}
+		break;
+
+	case sft_inputEvent_move:
+		_sft_input_ignoredMove = !value;
+		break;
+	}
+}
+
+void sft_input_subscribeAll(bool value)
+{
+	for (sft_key i = 0; i < sft_key_Count; i++)
+		sft_input_subscribe(sft_inputEvent_key, i, value);
+	for (sft_click i = 0; i < sft_click_Count; i++)
+		sft_input_subscribe(sft_inputEvent_click, i, value);
+	sft_input_subscribe(sft_inputEvent_move, 0, value);
+}
+
+bool sft_input_subscribed(sft_inputEventType type, uint8_t code)
+{
+	switch (type)
+	{
+	case sft_inputEvent_key:
+		return code < sft_key_Count &&
+			!((_sft_input_ignoredKeys[code / 64] >> (code % 64)) & 1);
+
+	case sft_inputEvent_click:
+		return code < sft_click_Count && !((_sft_input_ignoredClicks >> code) & 1);
+
+	case sft_inputEvent_move:
+		return !_sft_input_ignoredMove;
+	}
+	return false;
+}
+
+void sft_input_reset()
+{
+	memset(_sft_input_heldKeys, 0, sizeof(_sft_input_heldKeys));
+	memset(_sft_input_heldClicks, 0, sizeof(_sft_input_heldClicks));
+}
+
+bool sft_input_mouseMoved()
+{
+	return _sft_input_moved;
+}
+
+sft_point sft_input_lastMouse()
+{
+	return _sft_input_mouse;
+}
+
 void sft_input_update()
 {
 	for (sft_key i = 0; i < sft_key_Count; i++)
@@ -74,6 +206,20 @@ void sft_input_update()
 		sft_input_clicks[i] &= 1;
 		sft_input_clicks[i] <<= 1;
 	}
+
+	_sft_input_moved = false;
+	while (_sft_input_count)
+	{
+		applyEvent(_sft_input_queue[_sft_input_head]);
+		_sft_input_head = (_sft_input_head + 1) % sft_INPUT_QUEUE;
+		_sft_input_count--;
+	}
+
+	for (sft_key i = 0; i < sft_key_Count; i++)
+		sft_input_keys[i] |= _sft_input_heldKeys[i];
+	for (sft_click i = 0; i < sft_click_Count; i++)
+		sft_input_clicks[i] |= _sft_input_heldClicks[i];
+
 	_sft_input_update();
 
 	for (sft_key i = sft_key_Control; i < sft_key_Count; i++)
@@ -140,4 +286,4 @@ bool sft_input_clickLast(sft_click button)
 	if (button >= sft_click_Count)
 		return false;
 	return (sft_input_clicks[button] >> 1) & 1;
-}
+}
\ No newline at end of file
@@ -148,9 +148,17 @@ char sft_input_typedChar();
 */
 void sft_input_update();
 /**
-* \brief Internal function to gets the new state of the keyboard and mouse
+* \brief Internal function to read state that arrives without events, like lock key toggles
 */
 void _sft_input_update();
+/**
+* \brief Internal function for window backends to turn an OS input message into events
+* \param msg The message id
+* \param wp The message wparam
+* \param lp The message lparam
+* \return true if the message was input
+*/
+bool _sft_input_message(uint32_t msg, uint64_t wp, int64_t lp);
 
 
 /**
@@ -214,6 +222,82 @@ bool sft_input_clickReleased(sft_click button);
 */
 bool sft_input_clickPressed(sft_click button);
 
+// Input events buffered between updates before the oldest is applied early
+#define sft_INPUT_QUEUE 256
+
+typedef enum
+{
+	sft_inputEvent_key,
+	sft_inputEvent_click,
+	sft_inputEvent_move,
+} sft_inputEventType;
+
+typedef struct
+{
+	sft_inputEventType type;
+	/**
+	* \brief The sft_key or sft_click that changed, unused for moves
+	*/
+	uint8_t code;
+	/**
+	* \brief If the key or button was pressed
+	*/
+	bool down;
+	/**
+	* \brief Mouse position relative to the window client area, for moves and clicks.
+	sft_input_outside when the mouse left the window
+	*/
+	int32_t x;
+	int32_t y;
+} sft_inputEvent;
+
+// Mouse position of a move event sent when the mouse leaves the window
+#define sft_input_outside INT32_MIN
+
+/**
+* \brief Queues an input event to be applied by the next sft_input_update.
+Backends call this from their message handlers, it can also inject synthetic input
+* \param event The event to queue, dropped if not subscribed
+*/
+void sft_input_pushEvent(sft_inputEvent event);
+
+/**
+* \brief Sets if events for a key, button or mouse movement are tracked, everything is by default
+* \param type The kind of event
+* \param code The sft_key or sft_click, unused for moves
+* \param value If the events are tracked
+*/
+void sft_input_subscribe(sft_inputEventType type, uint8_t code, bool value);
+
+/**
+* \brief Sets if every key, button and mouse movement is tracked
+* \param value If the events are tracked
+*/
+void sft_input_subscribeAll(bool value);
+
+/**
+* \brief Returns if events of a kind are tracked
+* \param type The kind of event
+* \param code The sft_key or sft_click, unused for moves
+*/
+bool sft_input_subscribed(sft_inputEventType type, uint8_t code);
+
+/**
+* \brief Releases every held key and button, for when the window loses focus
+*/
+void sft_input_reset();
+
+/**
+* \brief Returns true if the mouse moved over a window since the last update
+*/
+bool sft_input_mouseMoved();
+
+/**
+* \brief Returns the mouse position of the last move or click applied by sft_input_update,
+relative to the client area it happened over. Unlike sft_input_mousePos this asks the OS nothing
+*/
+sft_point sft_input_lastMouse();
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "input.h"
 
+#if defined(_WIN32) && !defined(SFT_HEADLESS)
+
 #define WIN32_LEAN_AND_MEAN
 #define NO_STRICT
 #define NOMINMAX
@@ -18,74 +20,150 @@ sft_point sft_input_mousePos(const sft_window* window)
     return pt;
 }
 
-void _sft_input_update()
+static sft_key keyFromVk(uint64_t vk, int64_t lp)
 {
-    // Toggles
-    sft_input_keys[sft_key_Capslock] |= (uint16_t)GetKeyState(VK_CAPITAL) & 1; // Return state instead of pressed
-    sft_input_keys[sft_key_Numlock] |= (uint16_t)GetKeyState(VK_NUMLOCK) & 1; // Return state instead of pressed
-    
-    // Letters
-    for (uint32_t i = 0; i < 26; i++)
-        sft_input_keys[sft_key_A + i] |= (uint16_t)GetAsyncKeyState('A' + i) >> 15;
+    // Letters and numbers share their virtual key codes
+    if ((vk >= 'A' && vk <= 'Z') || (vk >= '0' && vk <= '9'))
+        return (sft_key)vk;
+
+    if (vk >= VK_NUMPAD0 && vk <= VK_NUMPAD9)
+        return sft_key_Num0 + (sft_key)(vk - VK_NUMPAD0);
 
-    // Numbers
-    for (uint32_t i = 0; i < 10; i++)
-        sft_input_keys[sft_key_0 + i] |= (uint16_t)GetAsyncKeyState('0' + i) >> 15;
+    if (vk >= VK_F1 && vk <= VK_F12)
+        return sft_key_Fn1 + (sft_key)(vk - VK_F1);
+
+    switch (vk)
+    {
+    // Toggles
+    case VK_CAPITAL: return sft_key_Capslock;
+    case VK_NUMLOCK: return sft_key_Numlock;
 
     // Numberpad
-    for (uint32_t i = 0; i < 10; i++)
-        sft_input_keys[sft_key_Num0 + i] |= (uint16_t)GetAsyncKeyState(VK_NUMPAD0 + i) >> 15;
-    
-    sft_input_keys[sft_key_NumDiv] |= (uint16_t)GetAsyncKeyState(VK_DIVIDE) >> 15;
-    sft_input_keys[sft_key_NumMult] |= (uint16_t)GetAsyncKeyState(VK_MULTIPLY) >> 15;
-    sft_input_keys[sft_key_NumSub] |= (uint16_t)GetAsyncKeyState(VK_SUBTRACT) >> 15;
-    sft_input_keys[sft_key_NumAdd] |= (uint16_t)GetAsyncKeyState(VK_ADD) >> 15;
-    sft_input_keys[sft_key_NumEnter] |= (uint16_t)GetAsyncKeyState(VK_RETURN) >> 15;
-    sft_input_keys[sft_key_NumPeriod] |= (uint16_t)GetAsyncKeyState(VK_DECIMAL) >> 15;
-
-    // Function keys
-    for (uint32_t i = 0; i < 12; i++)
-        sft_input_keys[sft_key_Fn1 + i] |= (uint16_t)GetAsyncKeyState(VK_F1 + i) >> 15;
+    case VK_DIVIDE: return sft_key_NumDiv;
+    case VK_MULTIPLY: return sft_key_NumMult;
+    case VK_SUBTRACT: return sft_key_NumSub;
+    case VK_ADD: return sft_key_NumAdd;
+    case VK_DECIMAL: return sft_key_NumPeriod;
 
     // Modifiers and control keys
-    sft_input_keys[sft_key_Control] |= (uint16_t)GetAsyncKeyState(VK_CONTROL) >> 15;
-    sft_input_keys[sft_key_Shift] |= (uint16_t)GetAsyncKeyState(VK_SHIFT) >> 15;
-    sft_input_keys[sft_key_Alt] |= (uint16_t)GetAsyncKeyState(VK_MENU) >> 15;
-    sft_input_keys[sft_key_System] |= (uint16_t)GetAsyncKeyState(VK_LWIN) >> 15 | (uint16_t)GetAsyncKeyState(VK_RWIN) >> 15;
-    sft_input_keys[sft_key_Escape] |= (uint16_t)GetAsyncKeyState(VK_ESCAPE) >> 15;
-    sft_input_keys[sft_key_BackSp] |= (uint16_t)GetAsyncKeyState(VK_BACK) >> 15;
-    sft_input_keys[sft_key_Tab] |= (uint16_t)GetAsyncKeyState(VK_TAB) >> 15;
-    sft_input_keys[sft_key_Enter] |= (uint16_t)GetAsyncKeyState(VK_RETURN) >> 15;
-    sft_input_keys[sft_key_Delete] |= (uint16_t)GetAsyncKeyState(VK_DELETE) >> 15;
-    sft_input_keys[sft_key_End] |= (uint16_t)GetAsyncKeyState(VK_END) >> 15;
-    sft_input_keys[sft_key_Home] |= (uint16_t)GetAsyncKeyState(VK_HOME) >> 15;
-    sft_input_keys[sft_key_Insert] |= (uint16_t)GetAsyncKeyState(VK_INSERT) >> 15;
-    sft_input_keys[sft_key_PrintScr] |= (uint16_t)GetAsyncKeyState(VK_SNAPSHOT) >> 15;
-    sft_input_keys[sft_key_PageUp] |= (uint16_t)GetAsyncKeyState(VK_PRIOR) >> 15;
-    sft_input_keys[sft_key_PageDown] |= (uint16_t)GetAsyncKeyState(VK_NEXT) >> 15;
-    sft_input_keys[sft_key_Up] |= (uint16_t)GetAsyncKeyState(VK_UP) >> 15;
-    sft_input_keys[sft_key_Down] |= (uint16_t)GetAsyncKeyState(VK_DOWN) >> 15;
-    sft_input_keys[sft_key_Left] |= (uint16_t)GetAsyncKeyState(VK_LEFT) >> 15;
-    sft_input_keys[sft_key_Right] |= (uint16_t)GetAsyncKeyState(VK_RIGHT) >> 15;
+    case VK_CONTROL: return sft_key_Control;
+    case VK_SHIFT: return sft_key_Shift;
+    case VK_MENU: return sft_key_Alt;
+    case VK_LWIN:
+    case VK_RWIN: return sft_key_System;
+    case VK_ESCAPE: return sft_key_Escape;
+    case VK_BACK: return sft_key_BackSp;
+    case VK_TAB: return sft_key_Tab;
+    // The numberpad enter is the extended one
+    case VK_RETURN: return (lp >> 24) & 1 ? sft_key_NumEnter : sft_key_Enter;
+    case VK_DELETE: return sft_key_Delete;
+    case VK_END: return sft_key_End;
+    case VK_HOME: return sft_key_Home;
+    case VK_INSERT: return sft_key_Insert;
+    case VK_SNAPSHOT: return sft_key_PrintScr;
+    case VK_PRIOR: return sft_key_PageUp;
+    case VK_NEXT: return sft_key_PageDown;
+    case VK_UP: return sft_key_Up;
+    case VK_DOWN: return sft_key_Down;
+    case VK_LEFT: return sft_key_Left;
+    case VK_RIGHT: return sft_key_Right;
 
     // Symbols
-    sft_input_keys[sft_key_Space] |= (uint16_t)GetAsyncKeyState(VK_SPACE) >> 15;
-    sft_input_keys[sft_key_Apostr] |= (uint16_t)GetAsyncKeyState(VK_OEM_7) >> 15;
-    sft_input_keys[sft_key_Comma] |= (uint16_t)GetAsyncKeyState(VK_OEM_COMMA) >> 15;
-    sft_input_keys[sft_key_Minus] |= (uint16_t)GetAsyncKeyState(VK_OEM_MINUS) >> 15;
-    sft_input_keys[sft_key_Period] |= (uint16_t)GetAsyncKeyState(VK_OEM_PERIOD) >> 15;
-    sft_input_keys[sft_key_FSlash] |= (uint16_t)GetAsyncKeyState(VK_OEM_2) >> 15;
-    sft_input_keys[sft_key_Equal] |= (uint16_t)GetAsyncKeyState(VK_OEM_PLUS) >> 15;
-    sft_input_keys[sft_key_Semicolon] |= (uint16_t)GetAsyncKeyState(VK_OEM_1) >> 15;
-    sft_input_keys[sft_key_LBracket] |= (uint16_t)GetAsyncKeyState(VK_OEM_4) >> 15;
-    sft_input_keys[sft_key_BSlash] |= (uint16_t)GetAsyncKeyState(VK_OEM_5) >> 15;
-    sft_input_keys[sft_key_RBracket] |= (uint16_t)GetAsyncKeyState(VK_OEM_6) >> 15;
-    sft_input_keys[sft_key_Grave] |= (uint16_t)GetAsyncKeyState(VK_OEM_3) >> 15;
-
-    // Mouse clicks
-    sft_input_clicks[sft_click_Left] |= (uint16_t)GetAsyncKeyState(VK_LBUTTON) >> 15;
-    sft_input_clicks[sft_click_Right] |= (uint16_t)GetAsyncKeyState(VK_RBUTTON) >> 15;
-    sft_input_clicks[sft_click_Middle] |= (uint16_t)GetAsyncKeyState(VK_MBUTTON) >> 15;
-    sft_input_clicks[sft_click_Extra1] |= (uint16_t)GetAsyncKeyState(VK_XBUTTON1) >> 15;
-    sft_input_clicks[sft_click_Extra2] |= (uint16_t)GetAsyncKeyState(VK_XBUTTON2) >> 15;
+    case VK_SPACE: return sft_key_Space;
+    case VK_OEM_7: return sft_key_Apostr;
+    case VK_OEM_COMMA: return sft_key_Comma;
+    case VK_OEM_MINUS: return sft_key_Minus;
+    case VK_OEM_PERIOD: return sft_key_Period;
+    case VK_OEM_2: return sft_key_FSlash;
+    case VK_OEM_PLUS: return sft_key_Equal;
+    case VK_OEM_1: return sft_key_Semicolon;
+    case VK_OEM_4: return sft_key_LBracket;
+    case VK_OEM_5: return sft_key_BSlash;
+    case VK_OEM_6: return sft_key_RBracket;
+    case VK_OEM_3: return sft_key_Grave;
+    }
+
+    return sft_key_Null;
 }
+
+bool _sft_input_message(uint32_t msg, uint64_t wp, int64_t lp)
+{
+    sft_inputEvent event = { 0 };
+
+    switch (msg)
+    {
+    case WM_KEYDOWN:
+    case WM_SYSKEYDOWN:
+    case WM_KEYUP:
+    case WM_SYSKEYUP:
+        event.type = sft_inputEvent_key;
+        event.code = keyFromVk(wp, lp);
+        event.down = msg == WM_KEYDOWN || msg == WM_SYSKEYDOWN;
+        if (event.code == sft_key_Null)
+            return false;
+        break;
+
+    case WM_LBUTTONDOWN:
+    case WM_LBUTTONUP:
+        event.type = sft_inputEvent_click;
+        event.code = sft_click_Left;
+        event.down = msg == WM_LBUTTONDOWN;
+        break;
+
+    case WM_RBUTTONDOWN:
+    case WM_RBUTTONUP:
+        event.type = sft_inputEvent_click;
+        event.code = sft_click_Right;
+        event.down = msg == WM_RBUTTONDOWN;
+        break;
+
+    case WM_MBUTTONDOWN:
+    case WM_MBUTTONUP:
+        event.type = sft_inputEvent_click;
+        event.code = sft_click_Middle;
+        event.down = msg == WM_MBUTTONDOWN;
+        break;
+
+    case WM_XBUTTONDOWN:
+    case WM_XBUTTONUP:
+        event.type = sft_inputEvent_click;
+        event.code = HIWORD(wp) == XBUTTON1 ? sft_click_Extra1 : sft_click_Extra2;
+        event.down = msg == WM_XBUTTONDOWN;
+        break;
+
+    case WM_MOUSEMOVE:
+        event.type = sft_inputEvent_move;
+        break;
+
+    case WM_MOUSELEAVE:
+        event.type = sft_inputEvent_move;
+        event.x = sft_input_outside;
+        event.y = sft_input_outside;
+        sft_input_pushEvent(event);
+        return true;
+
+    default:
+        return false;
+    }
+
+    // Button and move messages all carry the client position
+    if (event.type != sft_inputEvent_key)
+    {
+        event.x = (int16_t)LOWORD(lp);
+        event.y = (int16_t)HIWORD(lp);
+    }
+
+    sft_input_pushEvent(event);
+    return true;
+}
+
+void _sft_input_update()
+{
+    // Toggles have no event, only the lock state is read and only if asked for
+    if (sft_input_subscribed(sft_inputEvent_key, sft_key_Capslock))
+        sft_input_keys[sft_key_Capslock] = (sft_input_keys[sft_key_Capslock] & ~1) | ((uint16_t)GetKeyState(VK_CAPITAL) & 1);
+    if (sft_input_subscribed(sft_inputEvent_key, sft_key_Numlock))
+        sft_input_keys[sft_key_Numlock] = (sft_input_keys[sft_key_Numlock] & ~1) | ((uint16_t)GetKeyState(VK_NUMLOCK) & 1);
+}
+
+#endif
\ No newline at end of file
@@ -7,6 +7,8 @@ extern "C" {
 #include "image/image.h"
 #include "input/input.h"
 #include "timer/timer.h"
+#include "widget/label.h"
+#include "widget/widget.h"
 #include "util.h"
 
     /**
@@ -14,6 +16,7 @@ extern "C" {
     */
     void sft_init()
     {
+        sft_timer_init();
         sft_window_init();
         sft_input_update();
     }
@@ -0,0 +1,51 @@
+#include "timer.h"
+
+#ifndef _WIN32
+
+#include <time.h>
+#include <errno.h>
+
+// clock_gettime already counts in nanoseconds
+void sft_timer_init()
+{
+}
+
+uint64_t sft_timer_now()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+uint64_t sft_timer_coarse()
+{
+    struct timespec time;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &time);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &time);
+#endif
+
+    return (uint64_t)time.tv_sec * 1000000000ull + time.tv_nsec;
+}
+
+void sft_sleep(uint32_t ms)
+{
+    struct timespec time = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000l };
+
+    // Resume after signals until the full time has passed
+    while (nanosleep(&time, &time) == -1 && errno == EINTR)
+        ;
+}
+
+void sft_sleepUntil(uint64_t deadline)
+{
+    struct timespec time = { .tv_sec = deadline / 1000000000ull, .tv_nsec = deadline % 1000000000ull };
+
+    // Absolute, so signals and scheduling delays never push the wake later
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) == EINTR)
+        ;
+}
+
+#endif
\ No newline at end of file
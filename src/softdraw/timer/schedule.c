@@ -0,0 +1,89 @@
+#include "timer.h"
+
+#include <string.h>
+
+int32_t sft_schedule_add(sft_schedule* schedule, uint64_t period, uint64_t now)
+{
+    if (!schedule || !period || schedule->count >= sft_SCHEDULE_TASKS)
+        return -1;
+
+    sft_task* task = &schedule->tasks[schedule->count];
+    memset(task, 0, sizeof(*task));
+    task->period = period;
+    task->deadline = now + period;
+
+    return schedule->count++;
+}
+
+uint64_t sft_schedule_next(const sft_schedule* schedule)
+{
+    uint64_t next = UINT64_MAX;
+    if (!schedule)
+        return next;
+
+    for (uint32_t i = 0; i < schedule->count; i++)
+        if (schedule->tasks[i].deadline < next)
+            next = schedule->tasks[i].deadline;
+    return next;
+}
+
+uint32_t sft_schedule_msUntil(const sft_schedule* schedule, uint64_t now)
+{
+    uint64_t next = sft_schedule_next(schedule);
+    if (next <= now)
+        return 0;
+
+    uint64_t ms = sft_toMILLISEC(next - now + 999999);
+    return ms > UINT32_MAX - 1 ? UINT32_MAX - 1 : (uint32_t)ms;
+}
+
+static uint32_t latenessBucket(uint64_t late)
+{
+    uint64_t us = late / 1000;
+
+    uint32_t bucket = 0;
+    while (us && bucket < sft_SCHEDULE_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint32_t sft_schedule_due(sft_schedule* schedule, uint64_t now)
+{
+    if (!schedule)
+        return 0;
+
+    uint32_t due = 0;
+    for (uint32_t i = 0; i < schedule->count; i++)
+    {
+        sft_task* task = &schedule->tasks[i];
+        if (task->deadline > now)
+            continue;
+
+        uint64_t late = now - task->deadline;
+        task->runs++;
+        task->lateness[latenessBucket(late)]++;
+        if (late > task->maxLate)
+            task->maxLate = late;
+
+        // Whole periods keep the phase, a task that fell behind skips ahead instead of bursting
+        uint64_t periods = late / task->period;
+        task->missed += periods;
+        task->deadline += (periods + 1) * task->period;
+
+        due |= 1u << i;
+    }
+    return due;
+}
+
+uint32_t sft_schedule_wait(sft_schedule* schedule)
+{
+    uint64_t next = sft_schedule_next(schedule);
+    if (next == UINT64_MAX)
+        return 0;
+
+    sft_sleepUntil(next);
+    return sft_schedule_due(schedule, sft_timer_now());
+}
\ No newline at end of file
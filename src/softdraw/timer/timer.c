@@ -1,5 +1,11 @@
 #include "timer.h"
 
+uint64_t sft_timer_mulDiv(uint64_t value, uint64_t mul, uint64_t div)
+{
+    // Whole multiples of div first, so only the remainder is ever multiplied
+    return (value / div) * mul + (value % div) * mul / div;
+}
+
 uint64_t sft_timer_nsDiff(uint64_t last)
 {
     return sft_timer_now() - last;
@@ -21,7 +27,9 @@ void sft_timer_msWait(uint64_t* last, uint64_t val)
 {
     uint64_t diff = sft_timer_nsDiff(*last);
 
-    sft_sleep(sft_toMILLISEC(diff));
+    // Only the remainder of the period is left to sleep
+    if (sft_toMILLISEC(diff) < val)
+        sft_sleep(val - sft_toMILLISEC(diff));
     *last = sft_timer_now();
 }
 
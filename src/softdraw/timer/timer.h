@@ -9,14 +9,34 @@ extern "C" {
 // 1,000 Milliseconds = 1 Second
 // 1,000,000 Nanoseconds = 1 Millisecond
 
-#define sft_toMILLISEC(ns) (ns / 1'000'000ull) 
-#define sft_toNANOSEC(ms)  (ms * 1'000'000ull) 
+#define sft_toMILLISEC(ns) ((ns) / 1'000'000ull)
+#define sft_toNANOSEC(ms)  ((ms) * 1'000'000ull)
+
+/**
+* \brief Reads the tick rate sft_timer_now converts with, the first call has to come before other threads use the timer
+*/
+void sft_timer_init();
 
 /**
 * \brief Returns the tick count in nanoseconds (1,000,000 milliseconds)
 */
 uint64_t sft_timer_now();
 
+/**
+* \brief Returns a cheaper tick count in nanoseconds, only as precise as the scheduler tick (1 to 16 milliseconds).
+For rate sampling and other callers that do not need sft_timer_now
+*/
+uint64_t sft_timer_coarse();
+
+/**
+* \brief Returns value * mul / div without overflowing the intermediate product,
+as long as (div - 1) * mul fits in 64 bits
+* \param value The value to scale, usually a tick count
+* \param mul The multiplier, usually the target units per second
+* \param div The divisor, usually the source ticks per second
+*/
+uint64_t sft_timer_mulDiv(uint64_t value, uint64_t mul, uint64_t div);
+
 /**
 * \brief Returns now - last
 * \param last The last tick count
@@ -50,6 +70,91 @@ bool sft_timer_msDelta(uint64_t* last, uint64_t val);
 */
 void sft_sleep(uint32_t ms);
 
+/**
+* \brief Sleeps until an absolute tick count, on a high resolution timer where available
+* \param deadline The sft_timer_now tick count in nanoseconds to wake at
+*/
+void sft_sleepUntil(uint64_t deadline);
+
+// Periodic tasks per schedule
+#define sft_SCHEDULE_TASKS 8
+// Lateness histogram buckets, bucket 0 is under a microsecond,
+// bucket i is [2^(i-1), 2^i) microseconds and the last also counts everything later
+#define sft_SCHEDULE_BUCKETS 24
+
+typedef struct
+{
+    /**
+    * \brief Nanoseconds between runs
+    */
+    uint64_t period;
+    /**
+    * \brief Tick count in nanoseconds of the next run
+    */
+    uint64_t deadline;
+
+    /**
+    * \brief Times the task was due
+    */
+    uint64_t runs;
+    /**
+    * \brief Periods skipped because the task was more than a period late
+    */
+    uint64_t missed;
+    /**
+    * \brief Latest the task has been seen due, in nanoseconds
+    */
+    uint64_t maxLate;
+    /**
+    * \brief Histogram of how late the task was seen due
+    */
+    uint64_t lateness[sft_SCHEDULE_BUCKETS];
+} sft_task;
+
+typedef struct
+{
+    sft_task tasks[sft_SCHEDULE_TASKS];
+    uint32_t count;
+} sft_schedule;
+
+/**
+* \brief Adds a periodic task, first due one period from now
+* \param schedule The schedule to add to
+* \param period Nanoseconds between runs
+* \param now The current tick count in nanoseconds
+* \return The task index, used as its bit in sft_schedule_due, or -1 if the schedule is full
+*/
+int32_t sft_schedule_add(sft_schedule* schedule, uint64_t period, uint64_t now);
+
+/**
+* \brief Returns the earliest deadline of every task, UINT64_MAX if there are none
+* \param schedule The schedule to check
+*/
+uint64_t sft_schedule_next(const sft_schedule* schedule);
+
+/**
+* \brief Returns the milliseconds until the next deadline rounded up, to use as a wait timeout
+* \param schedule The schedule to check
+* \param now The current tick count in nanoseconds
+*/
+uint32_t sft_schedule_msUntil(const sft_schedule* schedule, uint64_t now);
+
+/**
+* \brief Records the lateness of every due task and moves its deadline on by whole periods,
+so the schedule never drifts with the time spent working
+* \param schedule The schedule to check
+* \param now The current tick count in nanoseconds
+* \return A bit per due task
+*/
+uint32_t sft_schedule_due(sft_schedule* schedule, uint64_t now);
+
+/**
+* \brief Sleeps until the next deadline and returns the due tasks
+* \param schedule The schedule to wait on
+* \return A bit per due task
+*/
+uint32_t sft_schedule_wait(sft_schedule* schedule);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -1,22 +1,73 @@
 #include "timer.h"
 
+#ifdef _WIN32
+
 #define WIN32_LEAN_AND_MEAN
 #define NO_STRICT
 #define NOMINMAX
 #include <Windows.h>
 #include <profileapi.h>
 
+// The performance counter frequency is fixed at boot, only written by the first sft_timer_init
+static uint64_t _sft_timer_freq = 0;
+
+void sft_timer_init()
+{
+    if (!_sft_timer_freq)
+        QueryPerformanceFrequency(&_sft_timer_freq);
+}
+
 uint64_t sft_timer_now()
 {
     uint64_t time;
-    uint64_t freq;
-    QueryPerformanceFrequency(&freq);
     QueryPerformanceCounter(&time);
 
-    return (sft_toNANOSEC(time * 1000) / freq);
+    return sft_timer_mulDiv(time, 1000000000ull, _sft_timer_freq);
+}
+
+uint64_t sft_timer_coarse()
+{
+    return sft_toNANOSEC(GetTickCount64());
 }
 
 void sft_sleep(uint32_t ms)
 {
     Sleep(ms);
-}
\ No newline at end of file
+}
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// Kept open for every sleep, high resolution timers need Windows 10 1803
+static HANDLE _sft_timer_waitable = NULL;
+
+void sft_sleepUntil(uint64_t deadline)
+{
+    uint64_t now = sft_timer_now();
+    if (deadline <= now)
+        return;
+
+    if (!_sft_timer_waitable)
+    {
+        _sft_timer_waitable = CreateWaitableTimerExW(NULL, NULL,
+            CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!_sft_timer_waitable)
+            _sft_timer_waitable = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+    }
+
+    if (!_sft_timer_waitable)
+    {
+        Sleep((DWORD)sft_toMILLISEC(deadline - now + 999999));
+        return;
+    }
+
+    // Waitable timers take absolute times on the system clock, so wait relative
+    // to the performance counter deadline in negative 100 nanosecond units
+    LARGE_INTEGER due;
+    due.QuadPart = -(int64_t)((deadline - now + 99) / 100);
+    if (SetWaitableTimer(_sft_timer_waitable, &due, 0, NULL, NULL, FALSE))
+        WaitForSingleObject(_sft_timer_waitable, INFINITE);
+}
+
+#endif
\ No newline at end of file
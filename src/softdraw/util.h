@@ -8,6 +8,11 @@ extern "C" {
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #define sft_min(a, b) ((a) < (b) ? (a) : (b))
 #define sft_max(a, b) ((a) > (b) ? (a) : (b))
@@ -68,6 +73,29 @@ static inline void basicList_free(void* list)
 }
 
 
+/**
+* \brief Returns the index of the lowest set bit, val must not be zero
+*/
+static inline uint32_t sft_ctz64(uint64_t val)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+	_BitScanForward64(&index, val);
+#else
+	if (!_BitScanForward(&index, (uint32_t)val))
+	{
+		_BitScanForward(&index, (uint32_t)(val >> 32));
+		index += 32;
+	}
+#endif
+	return index;
+#else
+	return __builtin_ctzll(val);
+#endif
+}
+
+
 typedef struct
 {
     uint32_t w;
@@ -99,23 +127,148 @@ static bool sft_colRectRect(sft_rect rect1, sft_rect rect2)
 		rect1.y < rect2.y + rect2.h && rect1.y + rect1.h > rect2.y;
 }
 
-static char* sft_strf(const char* fmt, ...)
+static sft_rect sft_unionRect(sft_rect rect1, sft_rect rect2)
 {
-	va_list args1, args2;
-	va_start(args1, fmt);
-	va_copy(args2, args1);
+	if (!rect1.w || !rect1.h)
+		return rect2;
+	if (!rect2.w || !rect2.h)
+		return rect1;
 
-	uint64_t size = vsnprintf(NULL, 0, fmt, args1);
+	sft_rect rect;
+	rect.x = sft_min(rect1.x, rect2.x);
+	rect.y = sft_min(rect1.y, rect2.y);
+	rect.w = sft_max(rect1.x + (int64_t)rect1.w, rect2.x + (int64_t)rect2.w) - rect.x;
+	rect.h = sft_max(rect1.y + (int64_t)rect1.h, rect2.y + (int64_t)rect2.h) - rect.y;
+	return rect;
+}
 
-	char* buf = malloc(size + 1);
-	if (buf)
-		vsnprintf(buf, size + 1, fmt, args2);
+// Stack buffer the formatting helpers try before falling back to the heap
+#define sft_STRF_STACK 256
 
-	va_end(args1);
-	va_end(args2);
+/**
+* \brief Formats into buf, only allocating when the result does not fit
+* \param buf Caller buffer, usually on the stack
+* \param size Bytes in buf
+* \return buf, a heap string if buf was too small or NULL if that failed. Release with sft_strfFree
+*/
+static char* sft_vstrfBuf(char* buf, uint64_t size, const char* fmt, va_list args)
+{
+	va_list retry;
+	va_copy(retry, args);
+
+	int len = vsnprintf(buf, size, fmt, args);
+	if (len < 0)
+		buf = NULL;
+	else if ((uint64_t)len >= size)
+	{
+		// Only oversized strings pay for a second pass
+		buf = malloc((uint64_t)len + 1);
+		if (buf)
+			vsnprintf(buf, (uint64_t)len + 1, fmt, retry);
+	}
+
+	va_end(retry);
 	return buf;
 }
 
+static char* sft_strfBuf(char* buf, uint64_t size, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	char* str = sft_vstrfBuf(buf, size, fmt, args);
+	va_end(args);
+	return str;
+}
+
+/**
+* \brief Frees a string from sft_strfBuf if it is not the caller buffer
+*/
+static void sft_strfFree(char* str, const char* buf)
+{
+	if (str != buf)
+		free(str);
+}
+
+static char* sft_strf(const char* fmt, ...)
+{
+	char stack[sft_STRF_STACK];
+
+	va_list args;
+	va_start(args, fmt);
+	char* str = sft_vstrfBuf(stack, sizeof(stack), fmt, args);
+	va_end(args);
+
+	// The caller owns the result, copy it off the stack
+	if (str == stack)
+	{
+		uint64_t len = strlen(stack);
+		str = malloc(len + 1);
+		if (str)
+			memcpy(str, stack, len + 1);
+	}
+	return str;
+}
+
+/**
+* \brief Writes value right aligned in width columns without going through printf, like "%*u"
+* \param buf Receives the text, needs width + 1 and at least 11 bytes
+* \param value The number
+* \param width Minimum columns, padded with spaces
+* \return The length written, buf is null terminated
+*/
+static uint32_t sft_strfUint(char* buf, uint32_t value, uint32_t width)
+{
+	char digits[10];
+	uint32_t count = 0;
+	do
+	{
+		digits[count++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	uint32_t len = 0;
+	while (len + count < width)
+		buf[len++] = ' ';
+	while (count)
+		buf[len++] = digits[--count];
+
+	buf[len] = '\0';
+	return len;
+}
+
+/**
+* \brief Writes a fixed point number right aligned without going through printf, like "%*.*f"
+* \param buf Receives the text, needs width + 1 and at least 12 + decimals bytes
+* \param scaled The number times 10^decimals, already rounded
+* \param decimals Digits after the point, below 10
+* \param width Minimum columns, padded with spaces
+* \return The length written, buf is null terminated
+*/
+static uint32_t sft_strfFixed(char* buf, uint32_t scaled, uint32_t decimals, uint32_t width)
+{
+	char digits[10];
+	uint32_t count = 0;
+	// At least one digit before the point
+	do
+	{
+		digits[count++] = '0' + scaled % 10;
+		scaled /= 10;
+	} while (scaled || count <= decimals);
+
+	uint32_t len = 0;
+	while (len + count + (decimals ? 1 : 0) < width)
+		buf[len++] = ' ';
+	while (count)
+	{
+		if (count == decimals)
+			buf[len++] = '.';
+		buf[len++] = digits[--count];
+	}
+
+	buf[len] = '\0';
+	return len;
+}
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
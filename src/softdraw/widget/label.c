@@ -0,0 +1,180 @@
+#include "label.h"
+
+#include <string.h>
+
+static sft_rect cellRect(int32_t x, int32_t y, uint32_t fontSize, uint32_t lineHeight, uint32_t line, uint32_t column)
+{
+    sft_rect rect;
+    rect.x = x + column * fontSize * 8;
+    rect.y = y + line * lineHeight;
+    rect.w = fontSize * 8;
+    rect.h = fontSize * 8;
+    return rect;
+}
+
+void sft_label_init(sft_label* label, int32_t x, int32_t y, uint32_t fontSize, sft_color background)
+{
+    if (!label)
+        return;
+
+    memset(label, 0, sizeof(*label));
+    label->x = x;
+    label->y = y;
+    label->fontSize = fontSize;
+    label->lineHeight = fontSize * 8;
+    label->background = background;
+}
+
+void sft_label_invalidate(sft_label* label)
+{
+    if (!label)
+        return;
+
+    memset(label->_lines, 0, sizeof(label->_lines));
+    label->_drawn = false;
+}
+
+// Clears every cell at the placement the label was last drawn at
+static sft_rect clearDrawn(sft_window* window, sft_label* label)
+{
+    sft_rect area = { 0 };
+
+    for (uint32_t i = 0; i < sft_LABEL_LINES; i++)
+        for (uint32_t j = 0; label->_lines[i][j]; j++)
+        {
+            sft_rect cell = cellRect(label->_x, label->_y, label->_fontSize, label->_lineHeight, i, j);
+            sft_window_fillRect(window, cell.x, cell.y, cell.w, cell.h, label->background);
+            area = sft_unionRect(area, cell);
+        }
+
+    memset(label->_lines, 0, sizeof(label->_lines));
+    return area;
+}
+
+sft_rect sft_label_set(sft_window* window, sft_label* label, const char* text, sft_color color)
+{
+    sft_rect area = { 0 };
+    if (!window || !label || !text)
+        return area;
+
+    // Split into fixed cells, missing lines and columns stay '\0'
+    char lines[sft_LABEL_LINES][sft_LABEL_COLUMNS + 1];
+    memset(lines, 0, sizeof(lines));
+
+    uint32_t line = 0;
+    uint32_t column = 0;
+    for (const char* ch = text; *ch && line < sft_LABEL_LINES; ch++)
+    {
+        if (*ch == '\n')
+        {
+            line++;
+            column = 0;
+        }
+        else if (column < sft_LABEL_COLUMNS)
+            lines[line][column++] = *ch;
+    }
+
+    if (label->_drawn && (label->_x != label->x || label->_y != label->y ||
+        label->_fontSize != label->fontSize || label->_lineHeight != label->lineHeight))
+    {
+        area = clearDrawn(window, label);
+        label->_drawn = false;
+    }
+
+    bool full = !label->_drawn || label->_color != color;
+
+    uint32_t any = 0;
+    for (uint32_t i = 0; i < sft_LABEL_LINES; i++)
+    {
+        uint32_t mask = 0;
+        for (uint32_t j = 0; j < sft_LABEL_COLUMNS; j++)
+            if (label->_lines[i][j] != lines[i][j] || (lines[i][j] && full))
+                mask |= 1u << j;
+
+        label->dirty[i] = mask;
+        any |= mask;
+    }
+
+    // Overlapping lines share pixels, a cleared cell has to be redrawn in every line of its column
+    if (label->lineHeight < label->fontSize * 8)
+        for (uint32_t i = 0; i < sft_LABEL_LINES; i++)
+            for (uint32_t j = 0; j < sft_LABEL_COLUMNS; j++)
+                if (((any >> j) & 1) && (label->_lines[i][j] || lines[i][j]))
+                    label->dirty[i] |= 1u << j;
+
+    // Every clear comes before any glyph, so overlapping lines are not cut by a later clear
+    for (uint32_t i = 0; i < sft_LABEL_LINES; i++)
+        for (uint32_t mask = label->dirty[i]; mask; mask &= mask - 1)
+        {
+            sft_rect cell = cellRect(label->x, label->y, label->fontSize, label->lineHeight, i, sft_ctz64(mask));
+            sft_window_fillRect(window, cell.x, cell.y, cell.w, cell.h, label->background);
+            area = sft_unionRect(area, cell);
+        }
+
+    for (uint32_t i = 0; i < sft_LABEL_LINES; i++)
+        for (uint32_t mask = label->dirty[i]; mask; mask &= mask - 1)
+        {
+            uint32_t j = sft_ctz64(mask);
+            if (lines[i][j])
+            {
+                sft_rect cell = cellRect(label->x, label->y, label->fontSize, label->lineHeight, i, j);
+                sft_window_drawChar(window, lines[i][j], cell.x, cell.y, label->fontSize, color);
+            }
+        }
+
+    memcpy(label->_lines, lines, sizeof(lines));
+    label->_color = color;
+    label->_x = label->x;
+    label->_y = label->y;
+    label->_fontSize = label->fontSize;
+    label->_lineHeight = label->lineHeight;
+    label->_drawn = true;
+    return area;
+}
+
+sft_rect sft_label_setF(sft_window* window, sft_label* label, sft_color color, const char* fmt, ...)
+{
+    char stack[sft_STRF_STACK];
+
+    va_list args;
+    va_start(args, fmt);
+    char* buf = sft_vstrfBuf(stack, sizeof(stack), fmt, args);
+    va_end(args);
+
+    sft_rect area = { 0 };
+    if (buf)
+    {
+        area = sft_label_set(window, label, buf, color);
+        sft_strfFree(buf, stack);
+    }
+    return area;
+}
+
+uint32_t sft_label_damage(const sft_label* label, sft_rect* rects, uint32_t max)
+{
+    if (!label || !rects || !max)
+        return 0;
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < sft_LABEL_LINES; i++)
+    {
+        uint32_t mask = label->dirty[i];
+        while (mask)
+        {
+            // Runs of set bits become one rect, columns never reach bit 31
+            uint32_t start = sft_ctz64(mask);
+            uint32_t len = sft_ctz64((uint32_t)~(mask >> start));
+            mask &= ~(((1u << len) - 1) << start);
+
+            sft_rect run = cellRect(label->_x, label->_y, label->_fontSize, label->_lineHeight, i, start);
+            run.w *= len;
+
+            if (count < max)
+                rects[count++] = run;
+            else
+                rects[max - 1] = sft_unionRect(rects[max - 1], run);
+        }
+    }
+
+    return count;
+}
\ No newline at end of file
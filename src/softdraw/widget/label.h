@@ -0,0 +1,99 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../window/window.h"
+
+// Lines and columns a label remembers, text past them is cut off
+#define sft_LABEL_LINES 4
+#define sft_LABEL_COLUMNS 31
+
+/**
+* \brief Retained text that only redraws the 8 * fontSize cells that changed
+*/
+typedef struct sft_label
+{
+    /**
+    * \brief Position and font size, changes take effect on the next sft_label_set
+    */
+    int32_t x;
+    int32_t y;
+    uint32_t fontSize;
+    /**
+    * \brief Pixels between the tops of lines, lines overlap when below 8 * fontSize
+    */
+    uint32_t lineHeight;
+    /**
+    * \brief Color changed cells are cleared to
+    */
+    sft_color background;
+
+    /**
+    * \brief Cells redrawn by the last sft_label_set per line, bit n is column n
+    */
+    uint32_t dirty[sft_LABEL_LINES];
+
+    /**
+    * \brief Internal text, color and placement currently on screen
+    */
+    char _lines[sft_LABEL_LINES][sft_LABEL_COLUMNS + 1];
+    sft_color _color;
+    int32_t _x;
+    int32_t _y;
+    uint32_t _fontSize;
+    uint32_t _lineHeight;
+    bool _drawn;
+} sft_label;
+
+/**
+* \brief Sets up a label with nothing on screen yet
+* \param label The label to set up
+* \param x The leftmost position
+* \param y The topmost position
+* \param fontSize The font size
+* \param background Color changed cells are cleared to
+*/
+void sft_label_init(sft_label* label, int32_t x, int32_t y, uint32_t fontSize, sft_color background);
+
+/**
+* \brief Forgets what is on screen so the next sft_label_set draws every cell, for after the window was cleared
+* \param label The label to invalidate
+*/
+void sft_label_invalidate(sft_label* label);
+
+/**
+* \brief Clears and redraws only the cells that differ from what the label last drew.
+A new color redraws every cell, a new position or font size clears the old text first
+* \param window The window to draw to
+* \param label The label to update
+* \param text The new text, lines split by '\n'
+* \param color The color of the text
+* \return The area drawn to, empty if nothing changed
+*/
+sft_rect sft_label_set(sft_window* window, sft_label* label, const char* text, sft_color color);
+
+/**
+* \brief sft_label_set with formatted text, formatted on the stack
+* \param window The window to draw to
+* \param label The label to update
+* \param color The color of the text
+* \param fmt formatted string
+*/
+sft_rect sft_label_setF(sft_window* window, sft_label* label, sft_color color, const char* fmt, ...);
+
+/**
+* \brief Lists the runs of cells the last sft_label_set redrew, one rect per run per line
+* \param label The label to read
+* \param rects [out] The damaged areas, runs past max are merged into the last one
+* \param max Room in rects
+* \return The number of rects written
+*/
+uint32_t sft_label_damage(const sft_label* label, sft_rect* rects, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
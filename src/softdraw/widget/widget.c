@@ -0,0 +1,343 @@
+#include "widget.h"
+#include "../input/input.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void sft_ui_init(sft_ui* ui, uint32_t width, uint32_t height)
+{
+    if (!ui)
+        return;
+
+    memset(ui, 0, sizeof(*ui));
+    ui->hovered = sft_widget_none;
+    ui->pressed = sft_widget_none;
+
+    sft_rect root = { 0, 0, width, height };
+    sft_ui_add(ui, sft_widget_none, sft_widget_container, root);
+}
+
+void sft_ui_free(sft_ui* ui)
+{
+    if (!ui)
+        return;
+
+    free(ui->widgets);
+    free(ui->_cellStart);
+    free(ui->_cellItems);
+    memset(ui, 0, sizeof(*ui));
+}
+
+sft_widgetId sft_ui_add(sft_ui* ui, sft_widgetId parent, sft_widgetType type, sft_rect rect)
+{
+    if (!ui || parent >= (sft_widgetId)ui->count)
+        return sft_widget_none;
+    // Only the root has no parent
+    if (parent == sft_widget_none && ui->count)
+        return sft_widget_none;
+
+    if (ui->count >= ui->_max)
+    {
+        uint32_t max = ui->_max ? ui->_max * 2 : 16;
+        void* ptr = realloc(ui->widgets, sizeof(*ui->widgets) * max);
+        if (!ptr)
+            return sft_widget_none;
+
+        ui->widgets = ptr;
+        ui->_max = max;
+    }
+
+    sft_widgetId id = ui->count++;
+    sft_widget* widget = &ui->widgets[id];
+    memset(widget, 0, sizeof(*widget));
+    widget->type = type;
+    widget->parent = parent;
+    widget->firstChild = sft_widget_none;
+    widget->lastChild = sft_widget_none;
+    widget->next = sft_widget_none;
+    widget->rect = rect;
+    widget->fontSize = 1;
+    widget->_dirty = true;
+    sft_label_init(&widget->label, 0, 0, 1, 0x00000000);
+
+    if (parent != sft_widget_none)
+    {
+        sft_widget* container = &ui->widgets[parent];
+        if (container->lastChild != sft_widget_none)
+            ui->widgets[container->lastChild].next = id;
+        else
+            container->firstChild = id;
+        container->lastChild = id;
+    }
+
+    ui->_layoutDirty = true;
+    return id;
+}
+
+sft_widget* sft_ui_get(sft_ui* ui, sft_widgetId id)
+{
+    if (!ui || id < 0 || id >= (sft_widgetId)ui->count)
+        return NULL;
+    return &ui->widgets[id];
+}
+
+void sft_ui_relayout(sft_ui* ui)
+{
+    if (ui)
+        ui->_layoutDirty = true;
+}
+
+static bool hitTested(const sft_widget* widget)
+{
+    return widget->type == sft_widget_button || widget->onEvent;
+}
+
+// Grid cells a widget covers, edges are inclusive like sft_colPointRect
+static bool cellRange(const sft_ui* ui, sft_rect bounds, uint32_t* c0, uint32_t* r0, uint32_t* c1, uint32_t* r1)
+{
+    sft_rect root = ui->widgets[0].bounds;
+    int64_t x0 = (int64_t)bounds.x - root.x;
+    int64_t y0 = (int64_t)bounds.y - root.y;
+    int64_t x1 = x0 + bounds.w;
+    int64_t y1 = y0 + bounds.h;
+    if (x1 < 0 || y1 < 0 || x0 > root.w || y0 > root.h)
+        return false;
+
+    *c0 = (uint32_t)sft_max(x0, 0) / sft_UI_CELL;
+    *r0 = (uint32_t)sft_max(y0, 0) / sft_UI_CELL;
+    *c1 = (uint32_t)sft_min(x1, (int64_t)root.w) / sft_UI_CELL;
+    *r1 = (uint32_t)sft_min(y1, (int64_t)root.h) / sft_UI_CELL;
+    return true;
+}
+
+static void buildGrid(sft_ui* ui)
+{
+    sft_rect root = ui->widgets[0].bounds;
+    uint32_t cols = root.w / sft_UI_CELL + 1;
+    uint32_t rows = root.h / sft_UI_CELL + 1;
+    uint64_t cells = (uint64_t)cols * rows;
+
+    if (cols != ui->_cols || rows != ui->_rows)
+    {
+        void* ptr = realloc(ui->_cellStart, sizeof(*ui->_cellStart) * (cells + 1));
+        if (!ptr)
+        {
+            ui->_cols = ui->_rows = 0;
+            return;
+        }
+        ui->_cellStart = ptr;
+        ui->_cols = cols;
+        ui->_rows = rows;
+    }
+    memset(ui->_cellStart, 0, sizeof(*ui->_cellStart) * (cells + 1));
+
+    // Count per cell, then turn the counts into where each cell ends
+    uint32_t c0, r0, c1, r1;
+    for (uint32_t i = 0; i < ui->count; i++)
+        if (hitTested(&ui->widgets[i]) && cellRange(ui, ui->widgets[i].bounds, &c0, &r0, &c1, &r1))
+            for (uint32_t r = r0; r <= r1; r++)
+                for (uint32_t c = c0; c <= c1; c++)
+                    ui->_cellStart[r * cols + c]++;
+
+    uint32_t total = 0;
+    for (uint64_t i = 0; i < cells; i++)
+    {
+        total += ui->_cellStart[i];
+        ui->_cellStart[i] = total;
+    }
+    ui->_cellStart[cells] = total;
+
+    if (total > ui->_maxItems)
+    {
+        void* ptr = realloc(ui->_cellItems, sizeof(*ui->_cellItems) * total);
+        if (!ptr)
+        {
+            memset(ui->_cellStart, 0, sizeof(*ui->_cellStart) * (cells + 1));
+            return;
+        }
+        ui->_cellItems = ptr;
+        ui->_maxItems = total;
+    }
+
+    // Filling backwards from the ends leaves each cell in id order and the ends as starts
+    for (uint32_t i = ui->count; i-- > 0;)
+        if (hitTested(&ui->widgets[i]) && cellRange(ui, ui->widgets[i].bounds, &c0, &r0, &c1, &r1))
+            for (uint32_t r = r0; r <= r1; r++)
+                for (uint32_t c = c0; c <= c1; c++)
+                    ui->_cellItems[--ui->_cellStart[r * cols + c]] = (sft_widgetId)i;
+}
+
+void sft_ui_layout(sft_ui* ui)
+{
+    if (!ui || !ui->count || !ui->_layoutDirty)
+        return;
+
+    // Parents come before their children, one pass in id order places everything
+    ui->widgets[0].bounds = ui->widgets[0].rect;
+    for (uint32_t i = 0; i < ui->count; i++)
+    {
+        sft_widget* widget = &ui->widgets[i];
+        if (i)
+        {
+            sft_rect parent = ui->widgets[widget->parent].bounds;
+            sft_rect bounds = { parent.x + widget->rect.x, parent.y + widget->rect.y, widget->rect.w, widget->rect.h };
+            if (bounds.x != widget->bounds.x || bounds.y != widget->bounds.y ||
+                bounds.w != widget->bounds.w || bounds.h != widget->bounds.h)
+                widget->_dirty = true;
+            widget->bounds = bounds;
+            widget->label.x = bounds.x;
+            widget->label.y = bounds.y;
+        }
+
+        if (widget->type != sft_widget_container || widget->layout == sft_layout_none)
+            continue;
+
+        int32_t offset = widget->padding;
+        for (sft_widgetId child = widget->firstChild; child != sft_widget_none; child = ui->widgets[child].next)
+        {
+            sft_rect* rect = &ui->widgets[child].rect;
+            if (widget->layout == sft_layout_row)
+            {
+                rect->x = offset;
+                rect->y = widget->padding;
+                offset += rect->w + widget->spacing;
+            }
+            else
+            {
+                rect->x = widget->padding;
+                rect->y = offset;
+                offset += rect->h + widget->spacing;
+            }
+        }
+    }
+
+    buildGrid(ui);
+    ui->_layoutDirty = false;
+}
+
+sft_widgetId sft_ui_hitTest(sft_ui* ui, sft_point pos)
+{
+    if (!ui || !ui->count)
+        return sft_widget_none;
+    sft_ui_layout(ui);
+
+    sft_rect root = ui->widgets[0].bounds;
+    int64_t x = (int64_t)pos.x - root.x;
+    int64_t y = (int64_t)pos.y - root.y;
+    if (x < 0 || y < 0 || x > root.w || y > root.h || !ui->_cols)
+        return sft_widget_none;
+
+    uint32_t cell = (uint32_t)(y / sft_UI_CELL) * ui->_cols + (uint32_t)(x / sft_UI_CELL);
+    // Later ids are on top
+    for (uint32_t i = ui->_cellStart[cell + 1]; i-- > ui->_cellStart[cell];)
+    {
+        sft_widgetId id = ui->_cellItems[i];
+        if (sft_colPointRect(ui->widgets[id].bounds, pos))
+            return id;
+    }
+    return sft_widget_none;
+}
+
+static void sendEvent(sft_ui* ui, sft_widgetId id, sft_widgetEvent event)
+{
+    if (ui->widgets[id].onEvent)
+        ui->widgets[id].onEvent(ui, id, event);
+}
+
+sft_widgetId sft_ui_dispatch(sft_ui* ui, sft_point mouse, bool down)
+{
+    if (!ui)
+        return sft_widget_none;
+
+    sft_widgetId hit = sft_ui_hitTest(ui, mouse);
+    sft_widgetId clicked = sft_widget_none;
+
+    if (hit != ui->hovered)
+    {
+        sft_widgetId left = ui->hovered;
+        ui->hovered = hit;
+        if (left != sft_widget_none)
+        {
+            ui->widgets[left].hovered = false;
+            sendEvent(ui, left, sft_widgetEvent_leave);
+        }
+        if (hit != sft_widget_none)
+        {
+            ui->widgets[hit].hovered = true;
+            sendEvent(ui, hit, sft_widgetEvent_enter);
+        }
+    }
+
+    if (down && !ui->_down)
+    {
+        ui->pressed = hit;
+        if (hit != sft_widget_none)
+        {
+            ui->widgets[hit].pressed = true;
+            sendEvent(ui, hit, sft_widgetEvent_press);
+        }
+    }
+    else if (!down && ui->_down && ui->pressed != sft_widget_none)
+    {
+        sft_widgetId released = ui->pressed;
+        ui->pressed = sft_widget_none;
+        ui->widgets[released].pressed = false;
+        sendEvent(ui, released, sft_widgetEvent_release);
+
+        if (hit == released)
+        {
+            clicked = released;
+            sendEvent(ui, released, sft_widgetEvent_click);
+        }
+    }
+
+    ui->_down = down;
+    return clicked;
+}
+
+sft_widgetId sft_ui_update(sft_ui* ui)
+{
+    return sft_ui_dispatch(ui, sft_input_lastMouse(), sft_input_clickState(sft_click_Left));
+}
+
+void sft_ui_invalidate(sft_ui* ui)
+{
+    if (!ui)
+        return;
+
+    for (uint32_t i = 0; i < ui->count; i++)
+    {
+        ui->widgets[i]._dirty = true;
+        sft_label_invalidate(&ui->widgets[i].label);
+    }
+}
+
+void sft_ui_draw(sft_window* window, sft_ui* ui)
+{
+    if (!window || !ui)
+        return;
+    sft_ui_layout(ui);
+
+    for (uint32_t i = 0; i < ui->count; i++)
+    {
+        sft_widget* widget = &ui->widgets[i];
+        if (!widget->_dirty)
+            continue;
+
+        if (widget->type == sft_widget_button && widget->glyph)
+            sft_window_drawChar(window, widget->glyph, widget->bounds.x + widget->glyphX,
+                widget->bounds.y + widget->glyphY, widget->fontSize, widget->color);
+        widget->_dirty = false;
+    }
+}
+
+sft_rect sft_ui_setText(sft_window* window, sft_ui* ui, sft_widgetId id, const char* text, sft_color color)
+{
+    sft_rect area = { 0 };
+    sft_widget* widget = sft_ui_get(ui, id);
+    if (!window || !widget || widget->type != sft_widget_label)
+        return area;
+
+    sft_ui_layout(ui);
+    return sft_label_set(window, &widget->label, text, color);
+}
\ No newline at end of file
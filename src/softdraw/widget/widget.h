@@ -0,0 +1,230 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../window/window.h"
+#include "label.h"
+
+// Index of a widget in its sft_ui, the root container is 0
+typedef int32_t sft_widgetId;
+#define sft_widget_none -1
+
+// Side of the square grid cells hit tests look up, in pixels
+#define sft_UI_CELL 32
+
+typedef enum
+{
+    sft_widget_container,
+    sft_widget_button,
+    sft_widget_label
+} sft_widgetType;
+
+/**
+* \brief How a container places its children
+*/
+typedef enum
+{
+    // Children keep their rect as an offset from the container
+    sft_layout_none,
+    // Left to right, then top to bottom
+    sft_layout_row,
+    sft_layout_column
+} sft_layout;
+
+typedef enum
+{
+    sft_widgetEvent_enter,
+    sft_widgetEvent_leave,
+    sft_widgetEvent_press,
+    // The press ended, wherever the mouse is
+    sft_widgetEvent_release,
+    // The press ended over the widget it started on
+    sft_widgetEvent_click
+} sft_widgetEvent;
+
+struct sft_ui;
+
+/**
+* \brief Called for every event a widget gets, widgets with one are hit tested like buttons
+*/
+typedef void (*sft_widgetCallback)(struct sft_ui* ui, sft_widgetId id, sft_widgetEvent event);
+
+typedef struct sft_widget
+{
+    sft_widgetType type;
+
+    /**
+    * \brief Tree links, children come after their parent so later ids are drawn and hit on top
+    */
+    sft_widgetId parent;
+    sft_widgetId firstChild;
+    sft_widgetId lastChild;
+    sft_widgetId next;
+
+    /**
+    * \brief Position relative to the parent and size. Row and column layouts overwrite the position
+    */
+    sft_rect rect;
+    /**
+    * \brief Absolute area after sft_ui_layout
+    */
+    sft_rect bounds;
+
+    /**
+    * \brief Container layout, padding is kept around the children and spacing between them
+    */
+    sft_layout layout;
+    uint32_t padding;
+    uint32_t spacing;
+
+    /**
+    * \brief Button glyph, drawn at glyphX, glyphY from the top left of bounds
+    */
+    char glyph;
+    int32_t glyphX;
+    int32_t glyphY;
+    uint32_t fontSize;
+    sft_color color;
+
+    /**
+    * \brief Label text, the position follows bounds
+    */
+    sft_label label;
+
+    sft_widgetCallback onEvent;
+    void* userData;
+
+    bool hovered;
+    bool pressed;
+    bool _dirty;
+} sft_widget;
+
+typedef struct sft_ui
+{
+    /**
+    * \brief Widgets by id, pointers into it are only valid until the next sft_ui_add
+    */
+    sft_widget* widgets;
+    uint32_t count;
+    uint32_t _max;
+
+    /**
+    * \brief The widget under the mouse and the one a press started on, sft_widget_none if there is none
+    */
+    sft_widgetId hovered;
+    sft_widgetId pressed;
+
+    void* userData;
+
+    /**
+    * \brief Internal uniform grid over the root, cell i lists the hit tested widgets in
+    _cellItems[_cellStart[i]] to _cellItems[_cellStart[i + 1]] in id order
+    */
+    uint32_t _cols;
+    uint32_t _rows;
+    uint32_t* _cellStart;
+    sft_widgetId* _cellItems;
+    uint32_t _maxItems;
+
+    bool _down;
+    bool _layoutDirty;
+} sft_ui;
+
+/**
+* \brief Sets up an ui with only the root container
+* \param ui The ui to set up
+* \param width The root width
+* \param height The root height
+*/
+void sft_ui_init(sft_ui* ui, uint32_t width, uint32_t height);
+
+/**
+* \brief Frees every widget and the grid
+* \param ui The ui to free
+*/
+void sft_ui_free(sft_ui* ui);
+
+/**
+* \brief Appends a widget as the last child of parent
+* \param ui The ui to add to
+* \param parent The container to add to
+* \param type The widget type
+* \param rect Position relative to the parent and size
+* \return The new widget, sft_widget_none when out of memory
+*/
+sft_widgetId sft_ui_add(sft_ui* ui, sft_widgetId parent, sft_widgetType type, sft_rect rect);
+
+/**
+* \brief Returns a widget to change, call sft_ui_relayout after moving or resizing it
+* \param ui The ui the widget is in
+* \param id The widget
+*/
+sft_widget* sft_ui_get(sft_ui* ui, sft_widgetId id);
+
+/**
+* \brief Marks the layout and grid as out of date, they are rebuilt on the next sft_ui_layout
+* \param ui The ui to mark
+*/
+void sft_ui_relayout(sft_ui* ui);
+
+/**
+* \brief Places every widget and rebuilds the hit test grid if anything changed
+* \param ui The ui to lay out
+*/
+void sft_ui_layout(sft_ui* ui);
+
+/**
+* \brief Finds the topmost button or widget with a callback containing pos
+* \param ui The ui to search
+* \param pos The position relative to the root
+* \return The widget hit, sft_widget_none if there is none
+*/
+sft_widgetId sft_ui_hitTest(sft_ui* ui, sft_point pos);
+
+/**
+* \brief Sends enter, leave, press, release and click events for a mouse position and button state
+* \param ui The ui to update
+* \param mouse The mouse position relative to the root
+* \param down If the button is held
+* \return The widget clicked, sft_widget_none if there is none
+*/
+sft_widgetId sft_ui_dispatch(sft_ui* ui, sft_point mouse, bool down);
+
+/**
+* \brief sft_ui_dispatch with the left button and the mouse position cached by sft_input_update
+* \param ui The ui to update
+* \return The widget clicked, sft_widget_none if there is none
+*/
+sft_widgetId sft_ui_update(sft_ui* ui);
+
+/**
+* \brief Marks every widget to be drawn again, for after the window was cleared
+* \param ui The ui to invalidate
+*/
+void sft_ui_invalidate(sft_ui* ui);
+
+/**
+* \brief Draws the buttons that changed since the last draw
+* \param window The window to draw to
+* \param ui The ui to draw
+*/
+void sft_ui_draw(sft_window* window, sft_ui* ui);
+
+/**
+* \brief Sets the text of a label widget, only the changed cells are drawn
+* \param window The window to draw to
+* \param ui The ui the label is in
+* \param id The label widget
+* \param text The new text, lines split by '\n'
+* \param color The color of the text
+* \return The area drawn to, empty if nothing changed
+*/
+sft_rect sft_ui_setText(sft_window* window, sft_ui* ui, sft_widgetId id, const char* text, sft_color color);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
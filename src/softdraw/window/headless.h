@@ -0,0 +1,98 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "window.h"
+#include "../input/input.h"
+
+// Events queued per window before the oldest is dropped
+#define sft_HEADLESS_QUEUE 64
+
+typedef enum
+{
+    sft_headless_close,
+    sft_headless_move,
+    sft_headless_resize,
+    sft_headless_sysChange,
+} sft_headlessEventType;
+
+typedef struct
+{
+    sft_headlessEventType type;
+    /**
+    * \brief New position for sft_headless_move
+    */
+    int32_t left;
+    int32_t top;
+    /**
+    * \brief New size for sft_headless_resize
+    */
+    uint32_t width;
+    uint32_t height;
+    /**
+    * \brief What changed for sft_headless_sysChange
+    */
+    sft_sysChange change;
+} sft_headlessEvent;
+
+/**
+* \brief Queues an event to be handled by the next sft_window_update
+* \param window The window to send the event to
+* \param event The event to queue
+*/
+void sft_headless_pushEvent(sft_window* window, sft_headlessEvent event);
+
+/**
+* \brief Writes every presented frame to a PPM file
+* \param window The window to dump
+* \param pathFmt printf format taking the frame number, NULL to stop dumping
+*/
+void sft_headless_setDump(sft_window* window, const char* pathFmt);
+
+/**
+* \brief Returns what has been presented so far, as a window manager would show it
+* \param window The window to get the surface of
+*/
+const sft_image* sft_headless_surface(const sft_window* window);
+
+/**
+* \brief Returns the number of frames presented
+* \param window The window to count frames of
+*/
+uint64_t sft_headless_frameCount(const sft_window* window);
+
+/**
+* \brief Sets the size returned by sft_screenWidth and sft_screenHeight
+* \param width The screen width
+* \param height The screen height
+*/
+void sft_headless_setScreen(uint32_t width, uint32_t height);
+
+/**
+* \brief Sets the mouse position returned by sft_input_mousePos (screen coordinates)
+* \param x The mouse x position
+* \param y The mouse y position
+*/
+void sft_headless_setMouse(int32_t x, int32_t y);
+
+/**
+* \brief Queues a key press or release for the next sft_input_update
+* \param key The key to set
+* \param down If the key is held
+*/
+void sft_headless_setKey(sft_key key, bool down);
+
+/**
+* \brief Queues a mouse button press or release for the next sft_input_update
+* \param button The button to set
+* \param down If the button is held
+*/
+void sft_headless_setClick(sft_click button, bool down);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
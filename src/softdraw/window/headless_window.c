@@ -0,0 +1,357 @@
+#include "headless.h"
+
+#if defined(SFT_HEADLESS) || !defined(_WIN32)
+
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <poll.h>
+#endif
+
+typedef struct
+{
+    sft_headlessEvent events[sft_HEADLESS_QUEUE];
+    uint32_t head;
+    uint32_t count;
+
+    sft_image* surface;
+    uint64_t frames;
+    char* dumpFmt;
+
+    bool visible;
+} _sft_headless;
+
+static uint32_t _sft_screenWidth = 1920;
+static uint32_t _sft_screenHeight = 1080;
+
+static void writePPM(const sft_image* image, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+        return;
+
+    fprintf(file, "P6\n%u %u\n255\n", image->width, image->height);
+
+    uint8_t* row = malloc((uint64_t)image->width * 3);
+    if (row)
+    {
+        for (uint32_t y = 0; y < image->height; y++)
+        {
+            // Pixels are stored as 0xAARRGGBB
+            const sft_color* src = image->pixels + (uint64_t)y * image->width;
+            for (uint32_t x = 0; x < image->width; x++)
+            {
+                row[x * 3 + 0] = (src[x] >> 16) & 0xFF;
+                row[x * 3 + 1] = (src[x] >> 8) & 0xFF;
+                row[x * 3 + 2] = src[x] & 0xFF;
+            }
+            fwrite(row, 3, image->width, file);
+        }
+        free(row);
+    }
+
+    fclose(file);
+}
+
+void sft_headless_pushEvent(sft_window* window, sft_headlessEvent event)
+{
+    if (!window || !window->handle)
+        return;
+
+    _sft_headless* headless = window->handle;
+
+    // Full queue drops the oldest event
+    if (headless->count == sft_HEADLESS_QUEUE)
+    {
+        headless->head = (headless->head + 1) % sft_HEADLESS_QUEUE;
+        headless->count--;
+    }
+
+    headless->events[(headless->head + headless->count) % sft_HEADLESS_QUEUE] = event;
+    headless->count++;
+}
+
+void sft_headless_setDump(sft_window* window, const char* pathFmt)
+{
+    if (!window || !window->handle)
+        return;
+
+    _sft_headless* headless = window->handle;
+
+    free(headless->dumpFmt);
+    headless->dumpFmt = NULL;
+
+    if (pathFmt)
+    {
+        uint64_t len = strlen(pathFmt);
+        headless->dumpFmt = malloc(len + 1);
+        if (headless->dumpFmt)
+            memcpy(headless->dumpFmt, pathFmt, len + 1);
+    }
+}
+
+const sft_image* sft_headless_surface(const sft_window* window)
+{
+    if (!window || !window->handle)
+        return NULL;
+
+    return ((_sft_headless*)window->handle)->surface;
+}
+
+uint64_t sft_headless_frameCount(const sft_window* window)
+{
+    if (!window || !window->handle)
+        return 0;
+
+    return ((_sft_headless*)window->handle)->frames;
+}
+
+void sft_headless_setScreen(uint32_t width, uint32_t height)
+{
+    _sft_screenWidth = width;
+    _sft_screenHeight = height;
+}
+
+bool _sft_window_open(sft_window* window, const char* title, uint32_t width, uint32_t height, int32_t left, int32_t top, sft_flags flags)
+{
+    if (!window)
+        return false;
+
+    _sft_headless* headless = malloc(sizeof(_sft_headless));
+    if (!headless)
+        return false;
+
+    memset(headless, 0, sizeof(*headless));
+    headless->surface = sft_image_create(window->width, window->height);
+    headless->visible = !(flags & sft_flag_hidden);
+
+    window->handle = headless;
+    return true;
+}
+
+bool _sft_window_hasFocus(const sft_window* window)
+{
+    return window && window->handle;
+}
+
+void _sft_window_update(sft_window* window)
+{
+    if (!window || !window->handle)
+        return;
+
+    _sft_headless* headless = window->handle;
+
+    while (headless->count)
+    {
+        sft_headlessEvent event = headless->events[headless->head];
+        headless->head = (headless->head + 1) % sft_HEADLESS_QUEUE;
+        headless->count--;
+
+        switch (event.type)
+        {
+        case sft_headless_close:
+            if (window->onClose)
+                window->onClose(window);
+            else
+                sft_window_defOnClose(window);
+            break;
+
+        case sft_headless_move:
+            if (window->onMove)
+                window->onMove(window, event.left, event.top);
+            else
+                sft_window_defOnMove(window, event.left, event.top);
+            break;
+
+        case sft_headless_resize:
+            if (window->onResize)
+                window->onResize(window, event.width, event.height);
+            else
+                sft_window_defOnResize(window, event.width, event.height);
+            break;
+
+        case sft_headless_sysChange:
+            if (window->onSystemChange)
+                window->onSystemChange(window, event.change);
+            else
+                sft_window_defOnSystemChange(window, event.change);
+            break;
+        }
+    }
+}
+
+int32_t _sft_window_wait(sft_window* window, void* const* events, uint32_t count, uint32_t ms)
+{
+    if (!window || !window->handle)
+        return -1;
+
+    // Queued events count as messages
+    if (((_sft_headless*)window->handle)->count)
+        return -1;
+
+#ifdef _WIN32
+    if (!count)
+    {
+        Sleep(ms);
+        return -1;
+    }
+
+    if (count > MAXIMUM_WAIT_OBJECTS)
+        count = MAXIMUM_WAIT_OBJECTS;
+
+    DWORD result = WaitForMultipleObjects(count, (const HANDLE*)events, FALSE, ms);
+    if (result < WAIT_OBJECT_0 + count)
+        return result - WAIT_OBJECT_0;
+    return -1;
+#else
+    // Events are file descriptors cast to pointers
+    struct pollfd fds[64];
+    if (count > 64)
+        count = 64;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        fds[i].fd = (int)(intptr_t)events[i];
+        fds[i].events = POLLIN | POLLPRI;
+        fds[i].revents = 0;
+    }
+
+    if (poll(fds, count, (int)ms) > 0)
+        for (uint32_t i = 0; i < count; i++)
+            if (fds[i].revents)
+                return i;
+    return -1;
+#endif
+}
+
+void _sft_window_display(sft_window* window, sft_rect rect)
+{
+    if (!window || !window->handle)
+        return;
+
+    _sft_headless* headless = window->handle;
+
+    // A resized surface has nothing valid left, copy the whole frame
+    if (headless->surface->width != window->frameBuf->width ||
+        headless->surface->height != window->frameBuf->height)
+    {
+        sft_image_resize(headless->surface, window->frameBuf->width, window->frameBuf->height);
+        rect.x = 0;
+        rect.y = 0;
+        rect.w = window->frameBuf->width;
+        rect.h = window->frameBuf->height;
+    }
+
+    sft_image_drawImage(headless->surface, window->frameBuf,
+        rect.x, rect.y, rect.w, rect.h, rect.x, rect.y);
+
+    if (headless->dumpFmt)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), headless->dumpFmt, (unsigned long long)headless->frames);
+        writePPM(headless->surface, path);
+    }
+
+    headless->frames++;
+}
+
+void _sft_window_resizeFrame(sft_window* window, uint32_t width, uint32_t height)
+{
+    if (!window || !window->frameBuf)
+        return;
+
+    sft_image_resize(window->frameBuf, width, height);
+}
+
+void _sft_window_deleteFrame(sft_window* window)
+{
+    if (!window || !window->frameBuf)
+        return;
+
+    free(window->frameBuf->pixels);
+    window->frameBuf->pixels = NULL;
+}
+
+void _sft_window_setTitle(sft_window* window)
+{
+}
+
+void _sft_window_setSize(sft_window* window, uint64_t width, uint64_t height)
+{
+}
+
+void _sft_window_setPos(sft_window* window, uint64_t left, uint64_t top)
+{
+}
+
+void _sft_window_setTopmost(sft_window* window, bool value)
+{
+}
+
+void _sft_window_focus(sft_window* window)
+{
+}
+
+void _sft_window_setVisible(sft_window* window, bool value)
+{
+    if (window && window->handle)
+        ((_sft_headless*)window->handle)->visible = value;
+}
+
+void _sft_window_close(sft_window* window)
+{
+    if (!window || !window->handle)
+        return;
+
+    _sft_headless* headless = window->handle;
+    sft_image_delete(headless->surface);
+    free(headless->dumpFmt);
+    free(headless);
+    window->handle = NULL;
+}
+
+void sft_window_setFlag(sft_window* window, sft_flags enable, sft_flags disable)
+{
+    if (!window)
+        return;
+
+    sft_setFlag(window->flags, enable, true);
+    sft_setFlag(window->flags, disable, false);
+
+    _sft_window_setVisible(window, !(window->flags & sft_flag_hidden));
+}
+
+void sft_window_init()
+{
+}
+
+void sft_window_shutdown()
+{
+}
+
+uint32_t sft_screenWidth()
+{
+    return _sft_screenWidth;
+}
+
+uint32_t sft_screenHeight()
+{
+    return _sft_screenHeight;
+}
+
+void sft_screenshot(sft_image* image)
+{
+    if (!image)
+        return;
+
+    // There is no desktop to capture
+    sft_image_resize(image, _sft_screenWidth, _sft_screenHeight);
+    sft_image_fill(image, 0xFF000000);
+}
+
+#endif
\ No newline at end of file
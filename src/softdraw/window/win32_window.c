@@ -1,7 +1,45 @@
 #include "window.h"
+#include "../input/input.h"
+
+#if defined(_WIN32) && !defined(SFT_HEADLESS)
 
 #include <dwmapi.h>
+#include <dbt.h>
+#include <shellapi.h>
 #pragma comment(lib, "Dwmapi.lib")
+#pragma comment(lib, "Shell32.lib")
+
+// Appbar notifications, the window registers without reserving any space
+#define SFT_WM_APPBAR (WM_APP + 1)
+
+typedef struct
+{
+    // Memory DC the framebuffer DIB section stays selected into
+    HDC dc;
+    HBITMAP bitmap;
+    HGDIOBJ oldBitmap;
+    HDC windowDc;
+} _sft_win32Frame;
+
+// Broadcast by the shell when the taskbar is created
+static UINT taskbarCreatedMsg = 0;
+// Only one window is under the mouse at a time, WM_MOUSELEAVE is asked for once per visit
+static bool _sft_win32_trackingMouse = false;
+
+// Registers as an appbar without reserving any space, to be told when the taskbar moves
+static void registerAppbar(sft_window* window)
+{
+    APPBARDATA appbar = { .cbSize = sizeof(appbar), .hWnd = window->handle, .uCallbackMessage = SFT_WM_APPBAR };
+    SHAppBarMessage(ABM_NEW, &appbar);
+}
+
+static void systemChange(sft_window* window, sft_sysChange change)
+{
+    if (window->onSystemChange)
+        window->onSystemChange(window, change);
+    else
+        sft_window_defOnSystemChange(window, change);
+}
 
 LRESULT __stdcall wndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
 {
@@ -9,6 +47,15 @@ LRESULT __stdcall wndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
     if (!window)
         return DefWindowProcA(hwnd, msg, wp, lp);
 
+    if (taskbarCreatedMsg && msg == taskbarCreatedMsg)
+    {
+        // The new shell starts without the appbars of the old one
+        if (window->flags & sft_flag_taskbar)
+            registerAppbar(window);
+        systemChange(window, sft_sysChange_taskbar);
+        return 0;
+    }
+
     switch (msg)
     {
     case WM_CLOSE:
@@ -32,6 +79,73 @@ LRESULT __stdcall wndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
             sft_window_defOnMove(window, LOWORD(lp), HIWORD(lp));
         return 0;
 
+    case WM_LBUTTONDOWN:
+    case WM_RBUTTONDOWN:
+    case WM_MBUTTONDOWN:
+    case WM_XBUTTONDOWN:
+        // Keep getting the release if the mouse leaves the window
+        SetCapture(hwnd);
+        _sft_input_message(msg, wp, lp);
+        return msg == WM_XBUTTONDOWN;
+
+    case WM_LBUTTONUP:
+    case WM_RBUTTONUP:
+    case WM_MBUTTONUP:
+    case WM_XBUTTONUP:
+        if (!(wp & (MK_LBUTTON | MK_RBUTTON | MK_MBUTTON | MK_XBUTTON1 | MK_XBUTTON2)))
+            ReleaseCapture();
+        _sft_input_message(msg, wp, lp);
+        return msg == WM_XBUTTONUP;
+
+    case WM_MOUSEMOVE:
+        if (!_sft_win32_trackingMouse)
+        {
+            TRACKMOUSEEVENT track = { .cbSize = sizeof(track), .dwFlags = TME_LEAVE, .hwndTrack = hwnd };
+            _sft_win32_trackingMouse = TrackMouseEvent(&track);
+        }
+        _sft_input_message(msg, wp, lp);
+        return 0;
+
+    case WM_MOUSELEAVE:
+        _sft_win32_trackingMouse = false;
+        _sft_input_message(msg, wp, lp);
+        return 0;
+
+    case WM_KEYDOWN:
+    case WM_KEYUP:
+        _sft_input_message(msg, wp, lp);
+        return 0;
+
+    case WM_SYSKEYDOWN:
+    case WM_SYSKEYUP:
+        // Alt+F4 and menu keys still need the default handling
+        _sft_input_message(msg, wp, lp);
+        return DefWindowProcA(hwnd, msg, wp, lp);
+
+    case WM_KILLFOCUS:
+        // Releases happening in another window never arrive here
+        sft_input_reset();
+        return 0;
+
+    case WM_DEVICECHANGE:
+        // Broadcast to every top level window, no registration needed
+        if (wp == DBT_DEVNODES_CHANGED)
+            systemChange(window, sft_sysChange_devices);
+        return TRUE;
+
+    case WM_DISPLAYCHANGE:
+        systemChange(window, sft_sysChange_display);
+        return 0;
+
+    case WM_SETTINGCHANGE:
+        systemChange(window, sft_sysChange_settings);
+        return 0;
+
+    case SFT_WM_APPBAR:
+        if (wp == ABN_POSCHANGED)
+            systemChange(window, sft_sysChange_taskbar);
+        return 0;
+
     default:
         return DefWindowProcA(hwnd, msg, wp, lp);
     }
@@ -91,28 +205,37 @@ bool _sft_window_open(sft_window* window, const char* title, uint32_t width, uin
         DwmSetWindowAttribute(window->handle,
             DWMWA_USE_IMMERSIVE_DARK_MODE, &value, sizeof(value));
 
-        // Transparent framebuffer
-        BOOL opaque;
-        DWORD color;
-        HRGN region = CreateRectRgn(0, 0, -1, -1);
-        DWM_BLURBEHIND bb;
-
-        DwmGetColorizationColor(&color, &opaque);
-        memset(&bb, 0, sizeof(bb));
-        bb.dwFlags = DWM_BB_ENABLE | DWM_BB_BLURREGION;
-        bb.hRgnBlur = region;
-        bb.fEnable = true;
-
-        DwmEnableBlurBehindWindow(window->handle, &bb);
-        DeleteObject(region);
-
-        // Window transparency
-        SetLayeredWindowAttributes(window->handle,
-            0, 255, LWA_ALPHA);
+        // Per pixel alpha windows are presented with UpdateLayeredWindow,
+        // which cannot be mixed with SetLayeredWindowAttributes
+        if (!(flags & sft_flag_alpha))
+        {
+            // Transparent framebuffer
+            BOOL opaque;
+            DWORD color;
+            HRGN region = CreateRectRgn(0, 0, -1, -1);
+            DWM_BLURBEHIND bb;
+
+            DwmGetColorizationColor(&color, &opaque);
+            memset(&bb, 0, sizeof(bb));
+            bb.dwFlags = DWM_BB_ENABLE | DWM_BB_BLURREGION;
+            bb.hRgnBlur = region;
+            bb.fEnable = true;
+
+            DwmEnableBlurBehindWindow(window->handle, &bb);
+            DeleteObject(region);
+
+            // Window transparency
+            SetLayeredWindowAttributes(window->handle,
+                0, 255, LWA_ALPHA);
+        }
 
         // Give window procedure the window pointer
         SetWindowLongPtrA(window->handle, GWLP_USERDATA, (LONG_PTR)window);
 
+        // Every appbar is sent a message for each taskbar change, only windows that ask are one
+        if (flags & sft_flag_taskbar)
+            registerAppbar(window);
+
         // Fix for borderless windows taking up the full screen
         sft_window_setSize(window, width, height);
 
@@ -131,36 +254,144 @@ void _sft_window_update(sft_window* window)
     if (!window)
         return;
 
+    // Every message of the thread is drained, one left for an IME or hidden window would end the next wait at once
     MSG msg;
-    while (PeekMessageA(&msg, window->handle, 0, 0, PM_REMOVE))
+    while (PeekMessageA(&msg, NULL, 0, 0, PM_REMOVE))
     {
         TranslateMessage(&msg);
         DispatchMessageA(&msg);
     }
 }
 
-void _sft_window_display(sft_window* window)
+int32_t _sft_window_wait(sft_window* window, void* const* events, uint32_t count, uint32_t ms)
 {
     if (!window)
+        return -1;
+
+    // One slot is reserved by the message queue
+    if (count > MAXIMUM_WAIT_OBJECTS - 1)
+        count = MAXIMUM_WAIT_OBJECTS - 1;
+
+    DWORD result = MsgWaitForMultipleObjectsEx(count, (const HANDLE*)events, ms,
+        QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+    if (result < WAIT_OBJECT_0 + count)
+        return result - WAIT_OBJECT_0;
+    return -1;
+}
+
+void _sft_window_display(sft_window* window, sft_rect rect)
+{
+    if (!window || !window->_frame)
+        return;
+
+    _sft_win32Frame* frame = window->_frame;
+
+    if (window->flags & sft_flag_alpha)
+    {
+        // The compositor keeps the whole surface, only the damage is read again
+        SIZE size = { window->frameBuf->width, window->frameBuf->height };
+        POINT origin = { 0, 0 };
+        RECT dirty = { rect.x, rect.y, rect.x + rect.w, rect.y + rect.h };
+        BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+
+        UPDATELAYEREDWINDOWINFO info;
+        memset(&info, 0, sizeof(info));
+        info.cbSize = sizeof(info);
+        info.psize = &size;
+        info.hdcSrc = frame->dc;
+        info.pptSrc = &origin;
+        info.pblend = &blend;
+        info.dwFlags = ULW_ALPHA;
+        info.prcDirty = &dirty;
+
+        UpdateLayeredWindowIndirect(window->handle, &info);
+        return;
+    }
+
+    // The class has CS_OWNDC, so the window DC can be kept for its lifetime
+    if (!frame->windowDc)
+        frame->windowDc = GetDC(window->handle);
+
+    // Framebuffer and client area are the same size, a 1:1 copy of the damage
+    BitBlt(frame->windowDc, rect.x, rect.y, rect.w, rect.h,
+        frame->dc, rect.x, rect.y, SRCCOPY);
+}
+
+void _sft_window_resizeFrame(sft_window* window, uint32_t width, uint32_t height)
+{
+    if (!window || !window->frameBuf)
+        return;
+
+    sft_image* image = window->frameBuf;
+    if (image->pixels && image->width == width && image->height == height)
         return;
 
-    HDC hdc = GetDC(window->handle);
+    if (width == 0 || height == 0)
+        return;
+
+    _sft_win32Frame* frame = window->_frame;
+    if (!frame)
+    {
+        frame = malloc(sizeof(*frame));
+        if (!frame)
+            return;
+
+        memset(frame, 0, sizeof(*frame));
+        frame->dc = CreateCompatibleDC(NULL);
+        window->_frame = frame;
+    }
 
     BITMAPINFO info;
     memset(&info, 0, sizeof(info));
     info.bmiHeader.biBitCount = sizeof(sft_color) * 8;
-    info.bmiHeader.biWidth = window->frameBuf->width;
-    info.bmiHeader.biHeight = 0-window->frameBuf->height;
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = 0-height;
     info.bmiHeader.biPlanes = 1;
     info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    info.bmiHeader.biSizeImage = 0;
     info.bmiHeader.biCompression = BI_RGB;
 
-    StretchDIBits(hdc, 0, 0, window->width, window->height,
-        0, 0, window->frameBuf->width, window->frameBuf->height,
-        window->frameBuf->pixels, &info, DIB_RGB_COLORS, SRCCOPY);
+    // Pixels are drawn straight into GDI owned memory
+    void* pixels = NULL;
+    HBITMAP bitmap = CreateDIBSection(frame->dc, &info, DIB_RGB_COLORS, &pixels, NULL, 0);
 
-    ReleaseDC(window->handle, hdc);
+    // The old frame and its size stay, drawing clips to it until a resize succeeds
+    if (!bitmap)
+        return;
+
+    // Swap the bitmap in the same DC
+    HGDIOBJ old = SelectObject(frame->dc, bitmap);
+    if (frame->bitmap)
+        DeleteObject(frame->bitmap);
+    else
+        frame->oldBitmap = old;
+    frame->bitmap = bitmap;
+
+    image->pixels = pixels;
+    image->width = width;
+    image->height = height;
+}
+
+void _sft_window_deleteFrame(sft_window* window)
+{
+    if (!window)
+        return;
+
+    _sft_win32Frame* frame = window->_frame;
+    if (frame)
+    {
+        if (frame->bitmap)
+        {
+            SelectObject(frame->dc, frame->oldBitmap);
+            DeleteObject(frame->bitmap);
+        }
+        DeleteDC(frame->dc);
+        free(frame);
+        window->_frame = NULL;
+    }
+
+    if (window->frameBuf)
+        window->frameBuf->pixels = NULL;
 }
 
 void _sft_window_setTitle(sft_window* window)
@@ -210,6 +441,12 @@ void _sft_window_close(sft_window* window)
     if (!window)
         return;
 
+    if (window->flags & sft_flag_taskbar)
+    {
+        APPBARDATA appbar = { .cbSize = sizeof(appbar), .hWnd = window->handle };
+        SHAppBarMessage(ABM_REMOVE, &appbar);
+    }
+
     DestroyWindow(window->handle);
 }
 
@@ -257,9 +494,12 @@ void sft_window_init()
     wc.hInstance = GetModuleHandleA(NULL);
     wc.lpszClassName = "softdraw";
     wc.lpfnWndProc = wndProc;
+    wc.style = CS_OWNDC;
     wc.hCursor = LoadCursorA(NULL, MAKEINTRESOURCEA(32512));
     RegisterClassA(&wc);
 
+    taskbarCreatedMsg = RegisterWindowMessageA("TaskbarCreated");
+
     SetProcessDPIAware();
 }
 
@@ -314,3 +554,6 @@ void sft_screenshot(sft_image* image)
 
     return image;
 }
+
+
+#endif
\ No newline at end of file
@@ -10,7 +10,7 @@ void sft_window_defOnResize(sft_window* window, uint32_t width, uint32_t height)
 {
     window->width = width;
     window->height = height;
-    sft_image_resize(window->frameBuf, window->width, window->height);
+    _sft_window_resizeFrame(window, window->width, window->height);
 }
 
 void sft_window_defOnMove(sft_window* window, int32_t left, int32_t top)
@@ -19,19 +19,92 @@ void sft_window_defOnMove(sft_window* window, int32_t left, int32_t top)
     window->top = top;
 }
 
+void sft_window_defOnSystemChange(sft_window* window, sft_sysChange change)
+{
+    // Nothing is cached by default
+}
+
+static void presentDamage(sft_window* window)
+{
+    sft_rect rect = { 0 };
+    for (uint32_t i = 0; i < window->_damageCount; i++)
+        rect = sft_unionRect(rect, window->_damage[i]);
+
+    uint64_t start = sft_timer_now();
+    _sft_window_display(window, rect);
+    window->presentNs = sft_timer_nsDiff(start);
+
+    window->_damageCount = 0;
+    window->framePixels = window->pixelsTouched;
+    window->pixelsTouched = 0;
+}
+
 void sft_window_display(sft_window* window)
 {
-    if (!window)
+    if (!window || !window->_damageCount)
         return;
 
     if (window->fpsLimit > 0)
     {
         if (sft_timer_msPassed(&window->_lastFrame, 1000 / window->fpsLimit))
-            _sft_window_display(window);
+            presentDamage(window);
     }
     else
-        _sft_window_display(window);
+        presentDamage(window);
+
+}
+
+void sft_window_damage(sft_window* window, int32_t x, int32_t y, uint32_t w, uint32_t h)
+{
+    if (!window)
+        return;
+
+    _sft_image_adjustRect(&x, &y, &w, &h, window->width, window->height);
+    if (!w || !h)
+        return;
 
+    window->pixelsTouched += (uint64_t)w * h;
+
+    sft_rect rect = { .x = x, .y = y, .w = w, .h = h };
+
+    // Already covered, or out of slots, grow an existing area instead
+    for (uint32_t i = 0; i < window->_damageCount; i++)
+        if (sft_colRectRect(window->_damage[i], rect) ||
+            (window->_damageCount == sft_MAX_DAMAGE && i == window->_damageCount - 1))
+        {
+            window->_damage[i] = sft_unionRect(window->_damage[i], rect);
+            return;
+        }
+
+    window->_damage[window->_damageCount++] = rect;
+}
+
+static void damageText(sft_window* window, const char* text, int32_t x, int32_t y, uint32_t fontSize)
+{
+    uint32_t rows = 1;
+    uint32_t cols = 0;
+    uint32_t maxCols = 0;
+
+    for (uint32_t i = 0; text[i]; i++)
+    {
+        switch (text[i])
+        {
+        case '\n':
+            rows++;
+            cols = 0;
+            break;
+
+        case '\t':
+            cols += 4 - cols % 4;
+            break;
+
+        default:
+            cols++;
+        }
+        maxCols = sft_max(maxCols, cols);
+    }
+
+    sft_window_damage(window, x, y, maxCols * fontSize * 8, rows * fontSize * 8);
 }
 
 void sft_window_setSize(sft_window* window, uint64_t width, uint64_t height)
@@ -42,7 +115,7 @@ void sft_window_setSize(sft_window* window, uint64_t width, uint64_t height)
         window->width = width;
         window->height = height;
 
-        sft_image_resize(window->frameBuf, width, height);
+        _sft_window_resizeFrame(window, width, height);
     }
 }
 
@@ -118,7 +191,13 @@ sft_window* sft_window_open(const char* title, uint32_t width, uint32_t height,
 
         if (_sft_window_open(window, title, width, height, left, top, flags))
         {
-            window->frameBuf = sft_image_create(window->width, window->height);
+            window->frameBuf = malloc(sizeof(sft_image));
+            if (window->frameBuf)
+            {
+                memset(window->frameBuf, 0, sizeof(*window->frameBuf));
+                window->frameBuf->blend = (flags & sft_flag_alpha) ? sft_blend_over : sft_blend_copy;
+                _sft_window_resizeFrame(window, window->width, window->height);
+            }
         }
         else
         {
@@ -139,6 +218,17 @@ bool sft_window_update(sft_window* window)
     return ~window->flags & sft_flag_closed;
 }
 
+int32_t sft_window_wait(sft_window* window, void* const* events, uint32_t count, uint32_t ms)
+{
+    if (!window)
+        return -1;
+
+    if (!events)
+        count = 0;
+
+    return _sft_window_wait(window, events, count, ms);
+}
+
 bool sft_window_hasFocus(const sft_window* window)
 {
     return _sft_window_hasFocus(window);
@@ -174,7 +264,8 @@ void sft_window_close(sft_window* window)
     _sft_window_close(window);
 
     free(window->title);
-    sft_image_delete(window->frameBuf);
+    _sft_window_deleteFrame(window);
+    free(window->frameBuf);
     free(window);
 }
 
@@ -185,6 +276,7 @@ void sft_window_drawImage(sft_window* dest, const sft_image* src, int32_t srcX,
 
     sft_image_drawImage(dest->frameBuf, src, 
         srcX, srcY, srcW, srcH, destX, destY);
+    sft_window_damage(dest, destX, destY, srcW, srcH);
 }
 
 void sft_window_drawRect(sft_window* dest, int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color)
@@ -193,6 +285,16 @@ void sft_window_drawRect(sft_window* dest, int32_t x, int32_t y, uint32_t w, uin
         return;
 
     sft_image_drawRect(dest->frameBuf, x, y, w, h, color);
+    sft_window_damage(dest, x, y, w, h);
+}
+
+void sft_window_fillRect(sft_window* dest, int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color)
+{
+    if (!dest)
+        return;
+
+    sft_image_fillRect(dest->frameBuf, x, y, w, h, color);
+    sft_window_damage(dest, x, y, w, h);
 }
 
 void sft_window_outlineRect(sft_window* dest, int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color)
@@ -201,6 +303,7 @@ void sft_window_outlineRect(sft_window* dest, int32_t x, int32_t y, uint32_t w,
         return;
 
     sft_image_outlineRect(dest->frameBuf, x, y, w, h, color);
+    sft_window_damage(dest, x, y, w, h);
 }
 
 void sft_window_fill(sft_window* window, sft_color color)
@@ -209,6 +312,7 @@ void sft_window_fill(sft_window* window, sft_color color)
         return;
 
     sft_image_fill(window->frameBuf, color);
+    sft_window_damage(window, 0, 0, window->width, window->height);
 }
 
 void sft_window_drawText(sft_window* window, const char* text, int32_t x, int32_t y, uint32_t fontSize, sft_color color)
@@ -216,7 +320,11 @@ void sft_window_drawText(sft_window* window, const char* text, int32_t x, int32_
     if (!window)
         return;
 
+    if (!text)
+        return;
+
     sft_image_drawText(window->frameBuf, text, x, y, fontSize, color);
+    damageText(window, text, x, y, fontSize);
 }
 
 void sft_window_drawTextF(sft_window* window, int32_t x, int32_t y, uint32_t fontSize, sft_color color, const char* fmt, ...)
@@ -224,24 +332,20 @@ void sft_window_drawTextF(sft_window* window, int32_t x, int32_t y, uint32_t fon
     if (!window)
         return;
 
-    va_list args1, args2;
-    va_start(args1, fmt);
-    va_copy(args2, args1);
-
-    uint64_t size = vsnprintf(NULL, 0, fmt, args1);
+    // Short strings never touch the heap
+    char stack[sft_STRF_STACK];
 
-    char* buf = malloc(size + 1);
-    if (buf)
-        vsnprintf(buf, size + 1, fmt, args2);
-
-    va_end(args1);
-    va_end(args2);
+    va_list args;
+    va_start(args, fmt);
+    char* buf = sft_vstrfBuf(stack, sizeof(stack), fmt, args);
+    va_end(args);
 
 
     if (buf)
     {
         sft_image_drawText(window->frameBuf, buf, x, y, fontSize, color);
-        free(buf);
+        damageText(window, buf, x, y, fontSize);
+        sft_strfFree(buf, stack);
     }
 }
 
@@ -251,4 +355,5 @@ void sft_window_drawChar(sft_window* window, char ch, int32_t x, int32_t y, uint
         return;
 
     sft_image_drawChar(window->frameBuf, ch, x, y, fontSize, color);
-}
+    sft_window_damage(window, x, y, fontSize * 8, fontSize * 8);
+}
\ No newline at end of file
@@ -12,6 +12,9 @@ extern "C" {
 
 #define enumBit 1 << 
 
+// Damaged areas tracked per frame before they are merged together
+#define sft_MAX_DAMAGE 16
+
 typedef uint64_t sft_flags;
 enum
 {
@@ -30,16 +33,44 @@ enum
     sft_flag_syshide    = enumBit 8,
 
     sft_flag_darkmode   = enumBit 9,
+    // Framebuffer holds premultiplied alpha, drawn with sft_blend_over and presented per pixel
+    sft_flag_alpha      = enumBit 10,
+    // Reports taskbar moves as sft_sysChange_taskbar, only read when the window opens
+    sft_flag_taskbar    = enumBit 11,
 
     sft_flag_default = 0,
 };
 
+typedef enum
+{
+    /**
+    * \brief Devices were added to or removed from the system
+    */
+    sft_sysChange_devices,
+    /**
+    * \brief Screen resolution or monitor layout changed
+    */
+    sft_sysChange_display,
+    /**
+    * \brief A system setting changed, like the work area
+    */
+    sft_sysChange_settings,
+    /**
+    * \brief The taskbar moved, resized or was recreated after the shell restarted
+    */
+    sft_sysChange_taskbar,
+} sft_sysChange;
+
 typedef struct sft_window
 {
     /**
     * \brief OS window handle
     */
     void* handle;
+    /**
+    * \brief Internal OS state behind the framebuffer pixels
+    */
+    void* _frame;
 
     /**
     * \brief Window title
@@ -82,6 +113,27 @@ typedef struct sft_window
     */
     uint64_t _lastFrame;
 
+    /**
+    * \brief Internal areas drawn to since the last display
+    */
+    sft_rect _damage[sft_MAX_DAMAGE];
+    /**
+    * \brief Internal number of damaged areas
+    */
+    uint32_t _damageCount;
+    /**
+    * \brief Pixels drawn to since the last display
+    */
+    uint64_t pixelsTouched;
+    /**
+    * \brief Pixels drawn to in the last displayed frame
+    */
+    uint64_t framePixels;
+    /**
+    * \brief Nanoseconds the last display spent presenting
+    */
+    uint64_t presentNs;
+
     /**
     * \brief A pointer to use in window event callbacks
     */
@@ -99,6 +151,10 @@ typedef struct sft_window
     * \brief Function pointer to custom event callback
     */
     void (*onResize)(struct sft_window* window, uint32_t width, uint32_t height);
+    /**
+    * \brief Function pointer to custom event callback
+    */
+    void (*onSystemChange)(struct sft_window* window, sft_sysChange change);
 } sft_window;
 
 /**
@@ -234,15 +290,58 @@ bool sft_window_update(sft_window* window);
 void _sft_window_update(sft_window* window);
 
 /**
-* \brief Draws the internal framebuffer to the window
+* \brief Blocks until the window gets a message, an event is signaled or the timeout passes
+* \param window The window to wait on
+* \param events [optional] OS event handles to wait on alongside the window
+* \param count The number of events
+* \param ms Timeout in milliseconds
+* \return The index of the signaled event, or -1 for a window message or timeout
+*/
+int32_t sft_window_wait(sft_window* window, void* const* events, uint32_t count, uint32_t ms);
+/**
+* \brief Internal function to wait for window messages or events
+* \param window The window to wait on
+* \param events OS event handles to wait on alongside the window
+* \param count The number of events
+* \param ms Timeout in milliseconds
+*/
+int32_t _sft_window_wait(sft_window* window, void* const* events, uint32_t count, uint32_t ms);
+
+/**
+* \brief Draws the damaged part of the internal framebuffer to the window
 * \param window The window to display
 */
 void sft_window_display(sft_window* window);
 /**
-* \brief Internal function to draw the framebuffer to the window
+* \brief Internal function to draw part of the framebuffer to the window
 * \param window the window to display
+* \param rect The area of the framebuffer to present
 */
-void _sft_window_display(sft_window* window);
+void _sft_window_display(sft_window* window, sft_rect rect);
+
+/**
+* \brief Internal function to (re)allocate the framebuffer pixels where the OS can present them from
+* \param window The window to resize the framebuffer of
+* \param width The new framebuffer width
+* \param height The new framebuffer height
+*/
+void _sft_window_resizeFrame(sft_window* window, uint32_t width, uint32_t height);
+/**
+* \brief Internal function to free the framebuffer pixels
+* \param window The window to free the framebuffer of
+*/
+void _sft_window_deleteFrame(sft_window* window);
+
+/**
+* \brief Marks an area to be presented by the next display.
+Every sft_window_draw function does this already
+* \param window The window that was drawn to
+* \param x Leftmost position of the area
+* \param y Topmost position of the area
+* \param w Width of the area
+* \param h Height of the area
+*/
+void sft_window_damage(sft_window* window, int32_t x, int32_t y, uint32_t w, uint32_t h);
 
 /**
 * \brief Changes the window title
@@ -287,6 +386,12 @@ void sft_window_defOnResize(sft_window* window, uint32_t width, uint32_t height)
 * \param top The new topmost position of the window
 */
 void sft_window_defOnMove(sft_window* window, int32_t left, int32_t top);
+/**
+* \brief Default callback to window.onSystemChange is NULL
+* \param window The window that was notified
+* \param change What changed in the system
+*/
+void sft_window_defOnSystemChange(sft_window* window, sft_sysChange change);
 
 /**
 * \brief Setting up globals and OS specific functions
@@ -325,6 +430,18 @@ void sft_window_drawImage(sft_window* dest, const sft_image* src,
 void sft_window_drawRect(sft_window* dest,
     int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color);
 
+/**
+* \brief Overwrites pixels in rectangle with a color, without blending on sft_flag_alpha windows
+* \param dest Destination window to draw to
+* \param x Leftmost position of rectangle
+* \param y Topmost position of rectangle
+* \param w Width of rectangle
+* \param h Height of rectangle
+* \param color Color the rectangle ends up, alpha included
+*/
+void sft_window_fillRect(sft_window* dest,
+    int32_t x, int32_t y, uint32_t w, uint32_t h, sft_color color);
+
 /**
 * \brief Outlines pixels in rectangle with a color
 * \param dest Destination window to draw to
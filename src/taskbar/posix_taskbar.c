@@ -0,0 +1,33 @@
+#include "taskbar.h"
+#include "../softdraw/window/window.h"
+
+#ifndef _WIN32
+
+#include <string.h>
+
+void openTaskbar(TaskbarTracker* tracker)
+{
+	memset(tracker, 0, sizeof(*tracker));
+}
+
+bool updateTaskbar(TaskbarTracker* tracker)
+{
+	if (tracker->valid)
+		return false;
+
+	// No tray, its left edge is the bottom right corner of the screen
+	sft_rect rect = { .x = sft_screenWidth(), .y = sft_screenHeight() };
+	tracker->valid = true;
+
+	if (memcmp(&rect, &tracker->trayRect, sizeof(rect)) == 0)
+		return false;
+
+	tracker->trayRect = rect;
+	return true;
+}
+
+void closeTaskbar(TaskbarTracker* tracker)
+{
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "taskbar.h"
+
+#include <string.h>
+
+uint64_t windowManagerCalls = 0;
+
+bool sampleWindowManagerCallRate(WindowManagerCallRate* rate, uint64_t now)
+{
+	uint64_t elapsed = now - rate->lastTime;
+	if (elapsed < 60000000000ull)
+		return false;
+
+	rate->perMin = (windowManagerCalls - rate->lastCalls) * 60000000000.f / elapsed;
+	rate->lastCalls = windowManagerCalls;
+	rate->lastTime = now;
+	return true;
+}
+
+void invalidateTaskbar(TaskbarTracker* tracker)
+{
+	tracker->valid = false;
+}
\ No newline at end of file
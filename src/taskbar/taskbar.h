@@ -0,0 +1,111 @@
+#pragma once
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../softdraw/util.h"
+
+typedef struct TaskbarTracker
+{
+	/**
+	* \brief Cached taskbar window handle, NULL if there is no shell
+	*/
+	void* taskbarHandle;
+	/**
+	* \brief Cached tray window handle
+	*/
+	void* trayHandle;
+	/**
+	* \brief Tray area in screen coordinates
+	*/
+	sft_rect trayRect;
+	/**
+	* \brief Cleared when a notification says the cached handles or rect may be stale
+	*/
+	bool valid;
+	/**
+	* \brief Window kept in front of the others, set by the caller once it is open
+	*/
+	void* window;
+	/**
+	* \brief Set when another window came to the foreground and is now above window, or above
+	anything while window is NULL. Cleared by the caller
+	*/
+	bool raise;
+
+	/**
+	* \brief Hook reporting tray location changes
+	*/
+	void* moveHook;
+	/**
+	* \brief Hook reporting foreground window changes
+	*/
+	void* foregroundHook;
+	/**
+	* \brief Thread that owns the hooked tray
+	*/
+	uint32_t hookedThread;
+} TaskbarTracker;
+
+typedef struct WindowManagerCallRate
+{
+	/**
+	* \brief Call count when the rate was last sampled
+	*/
+	uint64_t lastCalls;
+	/**
+	* \brief Tick count in nanoseconds when the rate was last sampled
+	*/
+	uint64_t lastTime;
+	/**
+	* \brief Calls per minute over the last sample period
+	*/
+	float perMin;
+} WindowManagerCallRate;
+
+/**
+* \brief Window manager calls (window lookups, rect queries, repositions) made so far,
+callers add their own repositions
+*/
+extern uint64_t windowManagerCalls;
+
+/**
+* \brief Updates rate->perMin once a minute has passed since the last sample
+* \param rate The previous sample, zero initialized before the first call
+* \param now The current tick count in nanoseconds
+* \return true if perMin was updated
+*/
+bool sampleWindowManagerCallRate(WindowManagerCallRate* rate, uint64_t now);
+
+/**
+* \brief Starts tracking the taskbar, the first updateTaskbar looks it up
+* \param tracker The tracker to open
+* \warning Must be closed with closeTaskbar
+*/
+void openTaskbar(TaskbarTracker* tracker);
+
+/**
+* \brief Forgets the cached taskbar, call on shell, display and setting change notifications
+* \param tracker The tracker to invalidate
+*/
+void invalidateTaskbar(TaskbarTracker* tracker);
+
+/**
+* \brief Looks the taskbar up again if it was invalidated
+* \param tracker The tracker to update
+* \return true if trayRect changed
+*/
+bool updateTaskbar(TaskbarTracker* tracker);
+
+/**
+* \brief Removes the hooks set by updateTaskbar
+* \param tracker The tracker to close
+*/
+void closeTaskbar(TaskbarTracker* tracker);
+
+#ifdef __cplusplus
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "taskbar.h"
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NO_STRICT
+#define NOMINMAX
+#include <Windows.h>
+
+#include <string.h>
+
+// WinEvent callbacks have no user pointer, only one tracker is hooked at a time
+static TaskbarTracker* hookedTracker = NULL;
+
+static void __stdcall onWinEvent(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+	LONG idObject, LONG idChild, DWORD thread, DWORD time)
+{
+	TaskbarTracker* tracker = hookedTracker;
+	if (!tracker)
+		return;
+
+	if (event == EVENT_SYSTEM_FOREGROUND)
+	{
+		// Most foreground changes leave the topmost band alone, only a window now above ours needs it raised
+		windowManagerCalls++;
+		if (!tracker->window || GetWindow(tracker->window, GW_HWNDPREV))
+			tracker->raise = true;
+	}
+	// Location changes are reported for every object on the tray thread
+	else if (idObject == OBJID_WINDOW && idChild == CHILDID_SELF &&
+		(hwnd == tracker->trayHandle || hwnd == tracker->taskbarHandle))
+		tracker->valid = false;
+}
+
+static void unhook(TaskbarTracker* tracker)
+{
+	if (tracker->moveHook)
+		UnhookWinEvent(tracker->moveHook);
+	tracker->moveHook = NULL;
+	tracker->hookedThread = 0;
+}
+
+void openTaskbar(TaskbarTracker* tracker)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	hookedTracker = tracker;
+
+	tracker->foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+		NULL, onWinEvent, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+}
+
+bool updateTaskbar(TaskbarTracker* tracker)
+{
+	if (tracker->valid)
+		return false;
+
+	// Get taskbar window handle, then get tray window handle
+	tracker->taskbarHandle = FindWindowA("Shell_TrayWnd", NULL);
+	tracker->trayHandle = FindWindowExA(tracker->taskbarHandle, NULL, "TrayNotifyWnd", NULL);
+	windowManagerCalls += 2;
+
+	sft_rect rect = { .x = GetSystemMetrics(SM_CXSCREEN), .y = GetSystemMetrics(SM_CYSCREEN) };
+	if (tracker->trayHandle)
+	{
+		RECT trayRect;
+		windowManagerCalls++;
+		if (GetWindowRect(tracker->trayHandle, &trayRect))
+		{
+			rect.x = trayRect.left;
+			rect.y = trayRect.top;
+			rect.w = trayRect.right - trayRect.left;
+			rect.h = trayRect.bottom - trayRect.top;
+		}
+
+		// The hook follows the tray thread, which changes when the shell restarts
+		DWORD process = 0;
+		DWORD thread = GetWindowThreadProcessId(tracker->trayHandle, &process);
+		if (thread != tracker->hookedThread)
+		{
+			unhook(tracker);
+			tracker->moveHook = SetWinEventHook(EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE,
+				NULL, onWinEvent, process, thread, WINEVENT_OUTOFCONTEXT);
+			if (tracker->moveHook)
+				tracker->hookedThread = thread;
+		}
+	}
+	else
+		// No shell, TaskbarCreated invalidates once it is back
+		unhook(tracker);
+
+	tracker->valid = true;
+
+	if (memcmp(&rect, &tracker->trayRect, sizeof(rect)) == 0)
+		return false;
+
+	tracker->trayRect = rect;
+	return true;
+}
+
+void closeTaskbar(TaskbarTracker* tracker)
+{
+	unhook(tracker);
+	if (tracker->foregroundHook)
+		UnhookWinEvent(tracker->foregroundHook);
+	tracker->foregroundHook = NULL;
+
+	if (hookedTracker == tracker)
+		hookedTracker = NULL;
+}
+
+#endif
\ No newline at end of file